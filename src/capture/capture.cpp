@@ -10,7 +10,9 @@
 #include "capture/capture_api_virtual.h"
 #include "capture/capture_api_rgbeasy.h"
 #include "capture/capture_api_video4linux.h"
+#include "capture/capture_api_video_file.h"
 #include "capture/capture.h"
+#include "record/batch.h"
 
 static capture_api_s *API = nullptr;
 
@@ -23,7 +25,12 @@ capture_api_s& kc_capture_api(void)
 
 void kc_initialize_capture(void)
 {
-    API =
+    // In batch mode, frames come from a video file rather than a capture device.
+    if (kbatch_is_enabled())
+    {
+        API = new capture_api_video_file_s(kbatch_input_file_name());
+    }
+    else API =
     #ifdef CAPTURE_API_VIRTUAL
         new capture_api_virtual_s;
     #elif CAPTURE_API_RGBEASY
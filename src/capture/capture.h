@@ -38,6 +38,10 @@ enum class capture_event_e
     invalid_signal,
     unrecoverable_error,
 
+    // The capture source has no more frames to give; e.g. the end of a video
+    // file has been reached.
+    end_of_input,
+
     // Total enumerator count; should remain the last item on the list.
     num_enumerators
 };
@@ -11,6 +11,7 @@
 #include <cmath>
 #include "common/globals.h"
 #include "common/propagate/app_events.h"
+#include "common/telemetry/telemetry.h"
 #include "capture/capture_api_rgbeasy.h"
 #include "capture/capture.h"
 #include "capture/alias.h"
@@ -70,6 +71,8 @@ namespace rgbeasy_callbacks_n
     {
         const auto thisPtr = reinterpret_cast<capture_api_rgbeasy_s*>(_thisPtr);
 
+        ktelemetry_set_thread_name("Capture");
+
         // If the hardware is sending us a new frame while we're still unfinished
         // with processing the previous frame. In that case, we'll need to skip
         // this new frame.
@@ -114,8 +117,12 @@ namespace rgbeasy_callbacks_n
         FRAME_BUFFER.pixelFormat = CAPTURE_PIXEL_FORMAT;
 
         // Copy the frame's data into our local buffer so we can work on it.
-        memcpy(FRAME_BUFFER.pixels.ptr(), (u8*)frameData,
-               FRAME_BUFFER.pixels.up_to(FRAME_BUFFER.r.w * FRAME_BUFFER.r.h * (FRAME_BUFFER.r.bpp / 8)));
+        {
+            TELEMETRY_TIME_SCOPE("Capture copy");
+
+            memcpy(FRAME_BUFFER.pixels.ptr(), (u8*)frameData,
+                   FRAME_BUFFER.pixels.up_to(FRAME_BUFFER.r.w * FRAME_BUFFER.r.h * (FRAME_BUFFER.r.bpp / 8)));
+        }
 
         thisPtr->push_capture_event(capture_event_e::new_frame);
 
@@ -26,6 +26,7 @@
 #include <cstring>
 #include <chrono>
 #include <poll.h>
+#include "common/telemetry/telemetry.h"
 #include "capture/capture_api_video4linux.h"
 
 #define INCLUDE_VISION
@@ -71,11 +72,13 @@ static struct capture_back_buffer_s
         return this->pages[idx];
     }
 
+    // Frame-sized allocations are page-aligned, as required of user pointer
+    // buffers by some V4L2 drivers, and backed by huge pages where available.
     void allocate(void)
     {
         for (auto &page: this->pages)
         {
-            page.alloc(MAX_FRAME_SIZE);
+            page.alloc(MAX_FRAME_SIZE, "Capture back buffer");
         }
     }
 
@@ -496,6 +499,8 @@ bool capture_api_video4linux_s::enqueue_capture_buffers(void)
 // The thread will be terminated externally when the program exits.
 static void capture_function(capture_api_video4linux_s *const thisPtr)
 {
+    ktelemetry_set_thread_name("Capture");
+
     while (!PROGRAM_EXIT_REQUESTED)
     {
         // See if aspects of the signal have changed.
@@ -553,6 +558,8 @@ static void capture_function(capture_api_video4linux_s *const thisPtr)
                     continue;
                 }
 
+                TELEMETRY_TIME_SCOPE("Capture dequeue");
+
                 v4l2_buffer buf;
                 memset(&buf, 0, sizeof(buf));
                 buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -583,8 +590,12 @@ static void capture_function(capture_api_video4linux_s *const thisPtr)
                     FRAME_BUFFER.pixelFormat = CAPTURE_PIXEL_FORMAT;
 
                     // Copy the frame's data into our local buffer so we can work on it.
-                    memcpy(FRAME_BUFFER.pixels.ptr(), (char*)buf.m.userptr,
-                           FRAME_BUFFER.pixels.up_to(FRAME_BUFFER.r.w * FRAME_BUFFER.r.h * (FRAME_BUFFER.r.bpp / 8)));
+                    {
+                        TELEMETRY_TIME_SCOPE("Capture copy");
+
+                        memcpy(FRAME_BUFFER.pixels.ptr(), (char*)buf.m.userptr,
+                               FRAME_BUFFER.pixels.up_to(FRAME_BUFFER.r.w * FRAME_BUFFER.r.h * (FRAME_BUFFER.r.bpp / 8)));
+                    }
 
                     NUM_FRAMES_CAPTURED++;
                     push_capture_event(capture_event_e::new_frame);
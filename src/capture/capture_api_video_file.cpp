@@ -0,0 +1,221 @@
+/*
+ * 2020 Tarpeeksi Hyvae Soft
+ *
+ * Software: VCS
+ *
+ */
+
+#include <cstring>
+#include "common/telemetry/telemetry.h"
+#include "capture/capture_api_video_file.h"
+
+#ifdef USE_OPENCV
+    #include <opencv2/imgproc/imgproc.hpp>
+    #include <opencv2/videoio/videoio.hpp>
+    #include <opencv2/core/core.hpp>
+
+    // The video being decoded. Opened by initialize(), after which it's used only
+    // by the decoder thread.
+    static cv::VideoCapture *VIDEO = nullptr;
+#endif
+
+bool capture_api_video_file_s::initialize(void)
+{
+    #ifdef USE_OPENCV
+        VIDEO = new cv::VideoCapture(this->filename);
+
+        if (!VIDEO->isOpened())
+        {
+            NBENE(("Failed to open the video file '%s' for decoding.", this->filename.c_str()));
+
+            delete VIDEO;
+            VIDEO = nullptr;
+            PROGRAM_EXIT_REQUESTED = true;
+
+            return false;
+        }
+
+        this->resolution = {unsigned(VIDEO->get(cv::CAP_PROP_FRAME_WIDTH)), unsigned(VIDEO->get(cv::CAP_PROP_FRAME_HEIGHT)), 32};
+        this->refreshRate = refresh_rate_s(VIDEO->get(cv::CAP_PROP_FPS));
+
+        if ((this->resolution.w > MAX_OUTPUT_WIDTH) ||
+            (this->resolution.h > MAX_OUTPUT_HEIGHT))
+        {
+            NBENE(("The video file's resolution (%lu x %lu) exceeds the maximum supported (%u x %u).",
+                   this->resolution.w, this->resolution.h, MAX_OUTPUT_WIDTH, MAX_OUTPUT_HEIGHT));
+
+            delete VIDEO;
+            VIDEO = nullptr;
+            PROGRAM_EXIT_REQUESTED = true;
+
+            return false;
+        }
+
+        INFO(("Decoding frames from '%s' (%lu x %lu, %.3f FPS).",
+              this->filename.c_str(), this->resolution.w, this->resolution.h, this->refreshRate.value<double>()));
+
+        this->frameBuffer.r = this->resolution;
+        this->frameBuffer.pixelFormat = capture_pixel_format_e::rgb_888;
+        this->frameBuffer.pixels.alloc((this->resolution.w * this->resolution.h * 4), "Video file frame buffer");
+        this->backBuffer.alloc((this->resolution.w * this->resolution.h * 4), "Video file frame buffer");
+
+        this->isOpen = true;
+        this->decoderThread = std::thread(&capture_api_video_file_s::decoder_thread_function, this);
+
+        return true;
+    #else
+        NBENE(("Decoding video files requires OpenCV, which has been disabled in this build."));
+
+        PROGRAM_EXIT_REQUESTED = true;
+
+        return false;
+    #endif
+}
+
+bool capture_api_video_file_s::release(void)
+{
+    if (this->decoderThread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->isStopRequested = true;
+        }
+
+        this->backBufferStateChanged.notify_all();
+        this->decoderThread.join();
+    }
+
+    #ifdef USE_OPENCV
+        delete VIDEO;
+        VIDEO = nullptr;
+    #endif
+
+    if (this->isOpen)
+    {
+        this->frameBuffer.pixels.release_memory();
+        this->backBuffer.release_memory();
+        this->isOpen = false;
+    }
+
+    return true;
+}
+
+void capture_api_video_file_s::decoder_thread_function(void)
+{
+    #ifdef USE_OPENCV
+        ktelemetry_set_thread_name("Decoder");
+
+        cv::Mat decoded;
+
+        while (true)
+        {
+            // Wait for the back buffer to be free.
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+
+                this->backBufferStateChanged.wait(lock, [this]{ return (this->isStopRequested || !this->isBackBufferReady); });
+
+                if (this->isStopRequested)
+                {
+                    break;
+                }
+            }
+
+            {
+                TELEMETRY_TIME_SCOPE("Decode frame");
+
+                if (!VIDEO->read(decoded) ||
+                    (decoded.cols != int(this->resolution.w)) ||
+                    (decoded.rows != int(this->resolution.h)))
+                {
+                    break;
+                }
+
+                cv::Mat output(this->resolution.h, this->resolution.w, CV_8UC4, this->backBuffer.ptr());
+                cv::cvtColor(decoded, output, ((decoded.channels() == 1)? CV_GRAY2BGRA : CV_BGR2BGRA));
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->isBackBufferReady = true;
+            }
+
+            this->backBufferStateChanged.notify_all();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->isDecodingFinished = true;
+        }
+
+        this->backBufferStateChanged.notify_all();
+    #endif
+
+    return;
+}
+
+capture_event_e capture_api_video_file_s::pop_capture_event_queue(void)
+{
+    if (!this->isOpen)
+    {
+        return capture_event_e::sleep;
+    }
+
+    // Until VCS has processed the current frame, keep offering it; it may have
+    // had no room for it yet.
+    if (this->isFramePending)
+    {
+        return capture_event_e::new_frame;
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    // Give the decoder a moment to catch up, rather than having the main loop
+    // sleep.
+    this->backBufferStateChanged.wait_for(lock, std::chrono::milliseconds(2), [this]
+    {
+        return (this->isBackBufferReady || this->isDecodingFinished);
+    });
+
+    if (this->isBackBufferReady)
+    {
+        std::swap(this->frameBuffer.pixels, this->backBuffer);
+        this->frameBuffer.processed = false;
+        this->isBackBufferReady = false;
+        this->isFramePending = true;
+        this->numFramesDelivered++;
+
+        lock.unlock();
+        this->backBufferStateChanged.notify_all();
+
+        return capture_event_e::new_frame;
+    }
+    else if (this->isDecodingFinished)
+    {
+        if (this->isEndOfInputReported)
+        {
+            return capture_event_e::sleep;
+        }
+
+        this->isEndOfInputReported = true;
+
+        INFO(("Reached the end of '%s' after %llu frames.", this->filename.c_str(), (unsigned long long)this->numFramesDelivered));
+
+        return capture_event_e::end_of_input;
+    }
+
+    return capture_event_e::none;
+}
+
+const captured_frame_s& capture_api_video_file_s::get_frame_buffer(void) const
+{
+    return this->frameBuffer;
+}
+
+bool capture_api_video_file_s::mark_frame_buffer_as_processed(void)
+{
+    this->isFramePending = false;
+    this->frameBuffer.processed = true;
+
+    return true;
+}
@@ -0,0 +1,89 @@
+/*
+ * 2020 Tarpeeksi Hyvae Soft
+ *
+ * Software: VCS
+ *
+ * A capture API that, in place of a capture device, decodes the frames of a
+ * video file (or of an image sequence, e.g. "frame_%04d.png"); for running
+ * previously recorded footage through VCS's filters and scalers in batch.
+ *
+ * Frames are decoded on a thread of their own, one frame ahead of the frame
+ * VCS is processing; and are delivered as fast as VCS processes them, none
+ * being skipped. Once the last frame has been processed, the API reports the
+ * end of its input.
+ *
+ */
+
+#ifndef CAPTURE_API_VIDEO_FILE_H
+#define CAPTURE_API_VIDEO_FILE_H
+
+#include <condition_variable>
+#include <thread>
+#include <mutex>
+#include "capture/capture_api.h"
+#include "capture/capture.h"
+
+struct capture_api_video_file_s : public capture_api_s
+{
+    capture_api_video_file_s(const std::string &filename) : filename(filename) {}
+
+    // API overrides.
+    bool initialize(void) override;
+    bool release(void) override;
+    std::string get_device_name(void) const override             { return this->filename; }
+    std::string get_api_name(void) const override                { return "VCS Video File API"; }
+    std::string get_device_driver_version(void) const override   { return "1.0"; }
+    std::string get_device_firmware_version(void) const override { return "1.0"; }
+    int get_device_maximum_input_count(void) const override      { return 1;     }
+    video_signal_parameters_s get_video_signal_parameters(void) const override         { return video_signal_parameters_s{}; }
+    video_signal_parameters_s get_default_video_signal_parameters(void) const override { return video_signal_parameters_s{}; }
+    video_signal_parameters_s get_minimum_video_signal_parameters(void) const override { return video_signal_parameters_s{}; }
+    video_signal_parameters_s get_maximum_video_signal_parameters(void) const override { return video_signal_parameters_s{}; }
+    resolution_s get_resolution(void) const override             { return this->resolution; }
+    resolution_s get_minimum_resolution(void) const override     { return this->resolution; }
+    resolution_s get_maximum_resolution(void) const override     { return this->resolution; }
+    refresh_rate_s get_refresh_rate(void) const override         { return this->refreshRate; }
+    uint get_missed_frames_count(void) const override            { return 0; }
+    uint get_input_channel_idx(void) const override              { return 0; }
+    uint get_color_depth(void) const override                    { return (unsigned)this->resolution.bpp; }
+    bool is_capturing(void) const override                       { return !this->isEndOfInputReported; }
+    bool has_invalid_signal(void) const override                 { return false; }
+    bool has_no_signal(void) const override                      { return !this->isOpen; }
+    capture_pixel_format_e get_pixel_format(void) const override { return capture_pixel_format_e::rgb_888; }
+    capture_event_e pop_capture_event_queue(void) override;
+    const captured_frame_s& get_frame_buffer(void) const override;
+    bool mark_frame_buffer_as_processed(void) override;
+
+    // The number of frames delivered so far.
+    u64 num_frames_delivered(void) const { return this->numFramesDelivered; }
+
+private:
+    void decoder_thread_function(void);
+
+    const std::string filename;
+
+    resolution_s resolution = {0, 0, 32};
+    refresh_rate_s refreshRate;
+    bool isOpen = false;
+
+    // The frame VCS is being given; and the next frame, being decoded into the
+    // back buffer meanwhile. The two swap once the back buffer is ready and VCS
+    // is done with the current frame.
+    captured_frame_s frameBuffer;
+    heap_bytes_s<u8> backBuffer;
+
+    std::thread decoderThread;
+    std::mutex mutex;
+    std::condition_variable backBufferStateChanged;
+    bool isBackBufferReady = false;
+    bool isDecodingFinished = false;
+    bool isStopRequested = false;
+
+    // Whether the frame in frameBuffer has been delivered but not yet processed.
+    bool isFramePending = false;
+
+    bool isEndOfInputReported = false;
+    u64 numFramesDelivered = 0;
+};
+
+#endif
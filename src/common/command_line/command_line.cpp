@@ -5,6 +5,13 @@
  */
 
 #include <unistd.h>
+#include <cstdio>
+#include "common/telemetry/telemetry.h"
+#include "scaler/quality_governor.h"
+#include "scaler/pipeline.h"
+#include "scaler/scaler.h"
+#include "record/shm_output.h"
+#include "record/batch.h"
 #include "common/globals.h"
 
 /*
@@ -29,6 +36,28 @@ static std::string ALIAS_FILE_NAME = "";
 // Name of (and path to) the filter set file on disk.
 static std::string FILTERS_FILE_NAME = "";
 
+// Name of (and path to) a video file to record the output into. Used when
+// running headless, where there's no GUI from which to start recording.
+static std::string RECORD_FILE_NAME = "";
+
+// The playback frame rate of the video recorded into RECORD_FILE_NAME.
+static unsigned RECORD_FRAME_RATE = 60;
+
+// The resolution of the video recorded into RECORD_FILE_NAME; or 0 x 0 to record
+// at the output resolution.
+static resolution_s RECORD_RESOLUTION = {0, 0, 0};
+
+// Whether to enable the quality governor; and the bounds within which it may
+// reduce quality.
+static bool IS_GOVERNOR_ENABLED = false;
+static std::string GOVERNOR_LOWEST_SCALING_FILTER = "Linear";
+static bool IS_GOVERNOR_ANALYSIS_SKIPPING_ALLOWED = false;
+
+// Whether to publish frames into shared memory; and under which name.
+static bool IS_SHM_OUTPUT_ENABLED = false;
+static std::string SHM_OUTPUT_NAME = "vcs";
+static bool IS_SHM_CAPTURE_INCLUDED = false;
+
 bool kcom_parse_command_line(const int argc, char *const argv[])
 {
     const char parseFailMsg[] = "VCS has to exit because it found unexpected values "
@@ -38,7 +67,7 @@ bool kcom_parse_command_line(const int argc, char *const argv[])
                                 "again from the command line.";
 
     int c = 0;
-    while ((c = getopt(argc, argv, "i:m:v:a:f:")) != -1)
+    while ((c = getopt(argc, argv, "i:m:v:a:f:o:r:R:l:d:t:T:p:g:GbPs:SB:")) != -1)
     {
         switch (c)
         {
@@ -85,11 +114,185 @@ bool kcom_parse_command_line(const int argc, char *const argv[])
             {
                 FILTERS_FILE_NAME = optarg;
 
+                break;
+            }
+            case 'o':   // Location of the video file to record into.
+            {
+                RECORD_FILE_NAME = optarg;
+
+                break;
+            }
+            case 'r':   // Playback frame rate of the recorded video.
+            {
+                RECORD_FRAME_RATE = strtol(optarg, NULL, 10);
+
+                if ((RECORD_FRAME_RATE < 1) ||
+                    (RECORD_FRAME_RATE > 1000))
+                {
+                    NBENE(("Recording frame rate out of bounds. Expected range: 1-1000."));
+
+                    kd_show_headless_error_message("", parseFailMsg);
+
+                    return false;
+                }
+
+                break;
+            }
+            case 'R':   // Resolution of the recorded video.
+            {
+                unsigned width = 0, height = 0;
+
+                if ((sscanf(optarg, "%ux%u", &width, &height) != 2) ||
+                    (width < MIN_OUTPUT_WIDTH) || (width > MAX_OUTPUT_WIDTH) ||
+                    (height < MIN_OUTPUT_HEIGHT) || (height > MAX_OUTPUT_HEIGHT))
+                {
+                    NBENE(("Malformed or out-of-bounds recording resolution. Expected e.g. 1920x1080, within %ux%u-%ux%u.",
+                           MIN_OUTPUT_WIDTH, MIN_OUTPUT_HEIGHT, MAX_OUTPUT_WIDTH, MAX_OUTPUT_HEIGHT));
+
+                    kd_show_headless_error_message("", parseFailMsg);
+
+                    return false;
+                }
+
+                RECORD_RESOLUTION = {width, height, 32};
+
+                break;
+            }
+            case 'l':   // Location of a file to also write the log into.
+            {
+                if (!klog_set_log_file(optarg))
+                {
+                    NBENE(("Failed to open the log file '%s'.", optarg));
+
+                    kd_show_headless_error_message("", parseFailMsg);
+
+                    return false;
+                }
+
+                break;
+            }
+            case 'd':   // Lowest level of log entry to output.
+            {
+                const long level = strtol(optarg, NULL, 10);
+
+                if ((level < long(log_level_e::debug)) ||
+                    (level > long(log_level_e::error)))
+                {
+                    NBENE(("Log level out of bounds. Expected range: %d-%d.",
+                           int(log_level_e::debug), int(log_level_e::error)));
+
+                    kd_show_headless_error_message("", parseFailMsg);
+
+                    return false;
+                }
+
+                klog_set_log_level(log_level_e(level));
+
+                break;
+            }
+            case 't':   // Location of a file to write pipeline telemetry into.
+            {
+                if (!ktelemetry_set_dump_file(optarg))
+                {
+                    NBENE(("Failed to open the telemetry file '%s'.", optarg));
+
+                    kd_show_headless_error_message("", parseFailMsg);
+
+                    return false;
+                }
+
+                break;
+            }
+            case 'T':   // Location of a file to write a trace of the frame pipeline into.
+            {
+                if (!ktelemetry_set_trace_file(optarg))
+                {
+                    NBENE(("Failed to open the trace file '%s'.", optarg));
+
+                    kd_show_headless_error_message("", parseFailMsg);
+
+                    return false;
+                }
+
+                break;
+            }
+            case 'p':   // Run the frame pipeline's stages on threads, with the given latency budget (ms).
+            {
+                const long latencyBudget = strtol(optarg, NULL, 10);
+
+                if ((latencyBudget < 0) ||
+                    (latencyBudget > 10000))
+                {
+                    NBENE(("Pipeline latency budget out of bounds. Expected range: 0-10000."));
+
+                    kd_show_headless_error_message("", parseFailMsg);
+
+                    return false;
+                }
+
+                kpipeline_set_threaded(true, unsigned(latencyBudget));
+
+                break;
+            }
+            case 'g':   // Enable the quality governor, with the lowest scaling filter it may use.
+            {
+                IS_GOVERNOR_ENABLED = true;
+                GOVERNOR_LOWEST_SCALING_FILTER = optarg;
+
+                break;
+            }
+            case 'G':   // Enable the quality governor, and let it skip analysis filters.
+            {
+                IS_GOVERNOR_ENABLED = true;
+                IS_GOVERNOR_ANALYSIS_SKIPPING_ALLOWED = true;
+
+                break;
+            }
+            case 'b':   // Process frames in cache-sized bands where possible.
+            {
+                ks_set_band_processing_enabled(true);
+
+                break;
+            }
+            case 'P':   // Pass frames that need no processing straight to the display.
+            {
+                ks_set_passthrough_enabled(true);
+
+                break;
+            }
+            case 's':   // Publish output frames into shared memory under the given name.
+            {
+                IS_SHM_OUTPUT_ENABLED = true;
+                SHM_OUTPUT_NAME = optarg;
+
+                break;
+            }
+            case 'S':   // Publish captured frames, too, into shared memory.
+            {
+                IS_SHM_OUTPUT_ENABLED = true;
+                IS_SHM_CAPTURE_INCLUDED = true;
+
+                break;
+            }
+            case 'B':   // Batch process the given video file instead of capturing.
+            {
+                kbatch_set_input_file_name(optarg);
+
                 break;
             }
         }
     }
 
+    if (IS_GOVERNOR_ENABLED)
+    {
+        kgovernor_set_enabled(true, GOVERNOR_LOWEST_SCALING_FILTER, IS_GOVERNOR_ANALYSIS_SKIPPING_ALLOWED);
+    }
+
+    if (IS_SHM_OUTPUT_ENABLED)
+    {
+        kshm_set_enabled(true, SHM_OUTPUT_NAME, IS_SHM_CAPTURE_INCLUDED);
+    }
+
     return true;
 }
 
@@ -107,3 +310,18 @@ const std::string& kcom_params_file_name(void)
 {
     return PARAMS_FILE_NAME;
 }
+
+const std::string& kcom_record_file_name(void)
+{
+    return RECORD_FILE_NAME;
+}
+
+unsigned kcom_record_frame_rate(void)
+{
+    return RECORD_FRAME_RATE;
+}
+
+resolution_s kcom_record_resolution(void)
+{
+    return RECORD_RESOLUTION;
+}
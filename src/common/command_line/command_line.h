@@ -9,6 +9,8 @@
 
 #include <string>
 
+struct resolution_s;
+
 bool kcom_parse_command_line(const int argc, char *const argv[]);
 
 const std::string& kcom_alias_file_name(void);
@@ -17,4 +19,13 @@ const std::string& kcom_filters_file_name(void);
 
 const std::string& kcom_params_file_name(void);
 
+const std::string& kcom_record_file_name(void);
+
+unsigned kcom_record_frame_rate(void);
+
+// The resolution at which to record the video, if given on the command line;
+// otherwise 0 x 0, in which case the video is to be recorded at the output
+// resolution.
+resolution_s kcom_record_resolution(void);
+
 #endif
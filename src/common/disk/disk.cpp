@@ -11,7 +11,6 @@
 #include <QString>
 #include <QDebug>
 #include <QFile>
-#include "display/qt/widgets/filter_widgets.h"
 #include "display/qt/dialogs/filter_graph/filter_graph_node.h"
 #include "common/disk/file_streamer.h"
 #include "common/disk/file_reader.h"
@@ -236,7 +235,7 @@ bool kdisk_save_filter_graph(std::vector<FilterGraphNode*> &nodes,
     return false;
 }
 
-std::pair<std::vector<FilterGraphNode*>,
+std::pair<std::vector<const filter_c*>,
           std::vector<filter_graph_option_s>> kdisk_load_filter_graph(const std::string &sourceFilename)
 {
     if (sourceFilename.empty())
@@ -258,21 +257,23 @@ std::pair<std::vector<FilterGraphNode*>,
         return {};
     }
 
-    std::vector<FilterGraphNode*> graphNodes;
+    std::vector<file_reader::filter_graph::node_s> fileNodes;
+    std::vector<filter_graph_node_s> graphNodes;
     std::vector<filter_graph_option_s> graphOptions;
+    std::vector<const filter_c*> filters;
 
     kd_clear_filter_graph();
 
     if (fileVersion == "a")
     {
-        if (!file_reader::filter_graph::version_a::read(sourceFilename, &graphNodes, &graphOptions))
+        if (!file_reader::filter_graph::version_a::read(sourceFilename, &fileNodes, &graphOptions))
         {
             goto fail;
         }
     }
     else if (fileVersion == "b")
     {
-        if (!file_reader::filter_graph::version_b::read(sourceFilename, &graphNodes, &graphOptions))
+        if (!file_reader::filter_graph::version_b::read(sourceFilename, &fileNodes, &graphOptions))
         {
             goto fail;
         }
@@ -283,9 +284,83 @@ std::pair<std::vector<FilterGraphNode*>,
         goto fail;
     }
 
+    for (const auto &node: fileNodes)
+    {
+        for (const unsigned targetIdx: node.outputConnections)
+        {
+            if (targetIdx >= fileNodes.size())
+            {
+                NBENE(("The filter graph file connects a node to a non-existent node."));
+                goto fail;
+            }
+        }
+    }
+
+    // Create the graph's filters. The filters themselves need no GUI.
+    for (auto &node: fileNodes)
+    {
+        // Older files may hold fewer parameters than filters now have.
+        node.parameterData.resize(FILTER_PARAMETER_ARRAY_LENGTH, 0);
+
+        const filter_c *const filter = kf_create_new_filter_instance(node.filterType, node.parameterData.data());
+
+        filters.push_back(filter);
+        graphNodes.push_back({filter, node.isEnabled, node.outputConnections});
+    }
+
+    // Recreate the graph in the GUI, if there is one; in which case the GUI
+    // will also derive the filter chains from it. Otherwise - e.g. when VCS
+    // is running headless - we derive the chains here.
+    {
+        std::vector<FilterGraphNode*> guiNodes;
+
+        for (const auto &node: graphNodes)
+        {
+            FilterGraphNode *const guiNode = kd_add_filter_graph_node(node.filter);
+
+            if (!guiNode)
+            {
+                k_assert(guiNodes.empty(), "The GUI failed to add a filter graph node.");
+                break;
+            }
+
+            guiNodes.push_back(guiNode);
+        }
+
+        if (guiNodes.empty())
+        {
+            kf_recalculate_filter_chains(graphNodes);
+        }
+        else
+        {
+            for (unsigned i = 0; i < guiNodes.size(); i++)
+            {
+                const auto &fileNode = fileNodes.at(i);
+
+                guiNodes.at(i)->setPos(QPointF(fileNode.scenePosX, fileNode.scenePosY));
+                guiNodes.at(i)->set_enabled(fileNode.isEnabled);
+
+                if (!fileNode.backgroundColor.empty())
+                {
+                    guiNodes.at(i)->set_background_color(QString::fromStdString(fileNode.backgroundColor));
+                }
+
+                for (const unsigned targetIdx: fileNode.outputConnections)
+                {
+                    node_edge_s *const sourceEdge = guiNodes.at(i)->output_edge();
+                    node_edge_s *const targetEdge = guiNodes.at(targetIdx)->input_edge();
+
+                    k_assert((sourceEdge && targetEdge), "Invalid source or target edge for connecting.");
+
+                    sourceEdge->connect_to(targetEdge);
+                }
+            }
+        }
+    }
+
     ke_events().file.loadedFilterGraph->fire();
 
-    return {graphNodes, graphOptions};
+    return {filters, graphOptions};
 
     fail:
     kd_clear_filter_graph();
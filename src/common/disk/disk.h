@@ -6,6 +6,7 @@
 
 class FilterGraphNode;
 class QString;
+class filter_c;
 
 struct filter_graph_option_s;
 struct video_signal_parameters_s;
@@ -17,7 +18,7 @@ bool kdisk_save_filter_graph(std::vector<FilterGraphNode*> &nodes, std::vector<f
 bool kdisk_save_aliases(const std::vector<mode_alias_s> &aliases, const std::string &targetFilename);
 
 std::vector<video_preset_s*> kdisk_load_video_presets(const std::string &sourceFilename);
-std::pair<std::vector<FilterGraphNode*>,
+std::pair<std::vector<const filter_c*>,
           std::vector<filter_graph_option_s>> kdisk_load_filter_graph(const std::string &sourceFilename);
 std::vector<mode_alias_s> kdisk_load_aliases(const std::string &sourceFilename);
 
@@ -8,24 +8,43 @@
 #ifndef FILE_READER_FILTER_GRAPH_H
 #define FILE_READER_FILTER_GRAPH_H
 
-#include "display/qt/dialogs/filter_graph/filter_graph_node.h"
+#include <vector>
+#include <string>
 #include "display/display.h"
+#include "filter/filter.h"
 
 namespace file_reader
 {
 namespace filter_graph
 {
+    // A filter graph node as stored in a filter graph file.
+    struct node_s
+    {
+        filter_type_enum_e filterType;
+        std::vector<u8> parameterData;
+        bool isEnabled = true;
+
+        // Indices in the file's list of nodes of the nodes to which this
+        // node's output is connected.
+        std::vector<unsigned> outputConnections;
+
+        // How the GUI displays the node. Empty/zero if not given in the file.
+        double scenePosX = 0;
+        double scenePosY = 0;
+        std::string backgroundColor;
+    };
+
     namespace version_a
     {
         bool read(const std::string &filename,
-                  std::vector<FilterGraphNode*> *const graphNodes,
+                  std::vector<node_s> *const graphNodes,
                   std::vector<filter_graph_option_s> *const graphOptions);
     }
 
     namespace version_b
     {
         bool read(const std::string &filename,
-                  std::vector<FilterGraphNode*> *const graphNodes,
+                  std::vector<node_s> *const graphNodes,
                   std::vector<filter_graph_option_s> *const graphOptions);
     }
 }
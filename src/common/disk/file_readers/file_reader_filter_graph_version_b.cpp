@@ -11,7 +11,7 @@
 #include "filter/filter.h"
 
 bool file_reader::filter_graph::version_b::read(const std::string &filename,
-                                                std::vector<FilterGraphNode*> *const graphNodes,
+                                                std::vector<node_s> *const graphNodes,
                                                 std::vector<filter_graph_option_s> *const graphOptions)
 {
     // Bails out if the value (string) of the first cell on the current row doesn't match
@@ -59,21 +59,20 @@ bool file_reader::filter_graph::version_b::read(const std::string &filename,
         {
             row++;
             FAIL_IF_FIRST_CELL_IS_NOT("id");
-            const filter_type_enum_e filterType = kf_filter_type_for_id(rowData.at(row).at(1).toStdString());
+            node_s node;
+            node.filterType = kf_filter_type_for_id(rowData.at(row).at(1).toStdString());
 
             row++;
             FAIL_IF_FIRST_CELL_IS_NOT("parameterData");
             const unsigned numParameters = rowData.at(row).at(1).toUInt();
 
-            std::vector<u8> params;
-            params.reserve(numParameters);
+            node.parameterData.reserve(numParameters);
             for (unsigned p = 0; p < numParameters; p++)
             {
-                params.push_back(rowData.at(row).at(2+p).toUInt());
+                node.parameterData.push_back(rowData.at(row).at(2+p).toUInt());
             }
 
-            const auto newNode = kd_add_filter_graph_node(filterType, (const u8*)params.data());
-            graphNodes->push_back(newNode);
+            graphNodes->push_back(node);
         }
 
         // Load the node data.
@@ -82,6 +81,12 @@ bool file_reader::filter_graph::version_b::read(const std::string &filename,
             FAIL_IF_FIRST_CELL_IS_NOT("nodeCount");
             const unsigned nodeCount = rowData.at(row).at(1).toUInt();
 
+            if (nodeCount > graphNodes->size())
+            {
+                NBENE(("Error while loading the filter graph file: found data for more nodes than there are filters."));
+                goto fail;
+            }
+
             for (unsigned i = 0; i < nodeCount; i++)
             {
                 row++;
@@ -95,11 +100,12 @@ bool file_reader::filter_graph::version_b::read(const std::string &filename,
 
                     if (paramName == "scenePosition")
                     {
-                        graphNodes->at(i)->setPos(QPointF(rowData.at(row).at(1).toDouble(), rowData.at(row).at(2).toDouble()));
+                        graphNodes->at(i).scenePosX = rowData.at(row).at(1).toDouble();
+                        graphNodes->at(i).scenePosY = rowData.at(row).at(2).toDouble();
                     }
                     else if (paramName == "isEnabled")
                     {
-                        graphNodes->at(i)->set_enabled(rowData.at(row).at(1).toInt());
+                        graphNodes->at(i).isEnabled = rowData.at(row).at(1).toInt();
                     }
                     else if (paramName == "connections")
                     {
@@ -107,17 +113,12 @@ bool file_reader::filter_graph::version_b::read(const std::string &filename,
 
                         for (unsigned c = 0; c < numConnections; c++)
                         {
-                            node_edge_s *const sourceEdge = graphNodes->at(i)->output_edge();
-                            node_edge_s *const targetEdge = graphNodes->at(rowData.at(row).at(2+c).toUInt())->input_edge();
-
-                            k_assert((sourceEdge && targetEdge), "Invalid source or target edge for connecting.");
-
-                            sourceEdge->connect_to(targetEdge);
+                            graphNodes->at(i).outputConnections.push_back(rowData.at(row).at(2+c).toUInt());
                         }
                     }
                     else if (paramName == "backgroundColor")
                     {
-                        graphNodes->at(i)->set_background_color(rowData.at(row).at(1));
+                        graphNodes->at(i).backgroundColor = rowData.at(row).at(1).toStdString();
                     }
                     else
                     {
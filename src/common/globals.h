@@ -44,6 +44,7 @@ const u32 FILTER_PARAMETER_ARRAY_LENGTH = 16;
                                             {\
                                                 kd_show_headless_assert_error_message(error_string, __FILE__, __LINE__);\
                                                 NBENE(("Assertion failure in %s {%d}: \"%s\"", __FILE__, __LINE__, error_string));\
+                                                klog_flush();\
                                                 throw std::runtime_error(error_string);\
                                             }
 
@@ -56,9 +57,19 @@ const u32 FILTER_PARAMETER_ARRAY_LENGTH = 16;
 #endif
 
 #define DEBUG_(args)        (printf("[Debug] {%s:%i} ", __FILE__, __LINE__), printf args, printf("\n"), fflush(stdout)) /// Temp hack.
-#define DEBUG(args)         (klog_log_debug args)
+
+// Log entries below VCS_MIN_LOG_LEVEL (see log.h) are compiled out.
+#if VCS_MIN_LOG_LEVEL <= 0
+    #define DEBUG(args)     (klog_log_debug args)
+#else
+    #define DEBUG(args)     ((void)0)
+#endif
+#if VCS_MIN_LOG_LEVEL <= 1
+    #define INFO(args)      (klog_log_info args)
+#else
+    #define INFO(args)      ((void)0)
+#endif
 #define NBENE(args)         (klog_log_error args)
-#define INFO(args)          (klog_log_info args)
 
 extern unsigned int FRAME_SKIP;
 
@@ -2,12 +2,23 @@
  * 2018 Tarpeeksi Hyvae Soft /
  * VCS log
  *
- * Logs given entires into the console or the GUI.
+ * Logs given entires into the console, an optional log file, and the GUI.
+ *
+ * Entries can be submitted from any thread. They're placed into a fixed-size
+ * lock-free queue, from which a background thread periodically writes them out;
+ * so submitting an entry costs the caller no more than formatting its message.
+ * Should the queue fill up, further entries are dropped (and a note of how many
+ * were dropped is logged) rather than making the caller wait.
  *
  */
 
+#include <atomic>
+#include <chrono>
 #include <thread>
+#include <mutex>
 #include <deque>
+#include <cstdio>
+#include <cstdlib>
 #include <stdarg.h>
 #include "capture/capture.h"
 #include "capture/capture_api.h"
@@ -17,55 +28,202 @@
 #include "common/log/log.h"
 
 // Set to false to ignore any log events submitted.
-static bool LOGGING_ENABLED = true;
+static std::atomic<bool> LOGGING_ENABLED{true};
+
+// Entries below this level (a log_level_e value) will be ignored.
+static std::atomic<int> MIN_LOG_LEVEL{int(log_level_e::debug)};
+
+// The number of entries the queue can hold. Must be a power of two.
+static const unsigned LOG_QUEUE_SIZE = 512;
+
+// Messages longer than this will be truncated.
+static const unsigned MAX_MESSAGE_LENGTH = 1024;
+
+struct queued_log_entry_s
+{
+    // Coordinates access to the slot between the threads submitting entries and
+    // the one writing them out (c.f. Vyukov's bounded queue). Stored relative to
+    // the slot's index in the queue, so that the queue's initial state is all
+    // zeroes and it's usable even before any of VCS's static initialization.
+    std::atomic<u64> sequence;
+
+    log_level_e level;
+
+    char message[MAX_MESSAGE_LENGTH];
+};
+
+static queued_log_entry_s LOG_QUEUE[LOG_QUEUE_SIZE];
+
+// The position in the queue at which the next entry will be submitted.
+static std::atomic<u64> ENQUEUE_POS{0};
+
+// The position in the queue from which the next entry will be written out.
+// Only to be accessed while holding DRAIN_MUTEX.
+static u64 DEQUEUE_POS = 0;
 
-// We'll only accept logging from the logger's own thread.
-static const std::thread::id NATIVE_LOG_THREAD = std::this_thread::get_id();
+// Held while writing out entries from the queue. Entries are submitted without
+// it.
+static std::mutex DRAIN_MUTEX;
 
-// Log entries submitted for logging but which can't immediately be logged will
-// be placed here to wait.
-static std::deque<log_entry_s> LOG_CACHE;
+// How many entries have been dropped because the queue was full; and how many
+// of those we've so far reported to the user.
+static std::atomic<uint> NUM_DROPPED_ENTRIES{0};
+static uint NUM_DROPPED_ENTRIES_REPORTED = 0;
+
+// The thread that writes out the queued entries.
+static std::thread *DRAIN_THREAD = nullptr;
+static std::atomic<bool> STOP_DRAIN_THREAD{false};
+
+// How often, in milliseconds, the drain thread writes out the queued entries.
+static const unsigned DRAIN_INTERVAL_MS = 10;
+
+// Set once the logger has been released. Entries submitted after that get
+// written out immediately.
+static std::atomic<bool> IS_RELEASED{false};
+
+// The file, if any, into which entries are also written. Only to be accessed
+// while holding DRAIN_MUTEX.
+static FILE *LOG_FILE = nullptr;
+
+// Entries that have been written out but not yet passed to the GUI.
+static std::deque<log_entry_s> GUI_CACHE;
+static std::mutex GUI_CACHE_MUTEX;
+
+// Entries are passed to the GUI only from the main thread, and the GUI may not
+// yet be able to accept them; so to keep the cache from growing without bounds,
+// we'll discard its oldest entries past this limit.
+static const unsigned MAX_GUI_CACHE_SIZE = 1000;
 
 // How many entries we've logged.
 static uint TOTAL_NUM_LOG_ENTRIES = 0;
 
-void klog_set_logging_enabled(const bool state)
+static const char* level_name(const log_level_e level)
 {
-    if (state)
+    switch (level)
     {
-        LOGGING_ENABLED = true;
-        INFO(("Logging has been enabled."));
+        case log_level_e::debug: return "Debug";
+        case log_level_e::info:  return "Info";
+        case log_level_e::error: return "Error";
+        default: return "?";
     }
-    else
+}
+
+// Outputs the given entry into the console, the log file, and the GUI cache.
+// Expects DRAIN_MUTEX to be held.
+static void write_entry(const log_level_e level, const char *const message)
+{
+    const char *const type = level_name(level);
+
+    printf("[%-5s] %s\n", type, message);
+
+    if (LOG_FILE)
     {
-        INFO(("[Info] Logging has been disabled by request. Re-enable it to see "
-               "further messages."));
-        LOGGING_ENABLED = false;
+        fprintf(LOG_FILE, "[%-5s] %s\n", type, message);
+    }
+
+    log_entry_s entry;
+    entry.id = TOTAL_NUM_LOG_ENTRIES++;
+    entry.type = type;
+    entry.message = message;
+
+    std::lock_guard<std::mutex> lock(GUI_CACHE_MUTEX);
+
+    GUI_CACHE.push_back(entry);
+
+    if (GUI_CACHE.size() > MAX_GUI_CACHE_SIZE)
+    {
+        GUI_CACHE.pop_front();
     }
 
     return;
 }
 
-void klog_initialize(void)
+// Writes out all entries currently in the queue.
+static void drain_queue(void)
 {
-    ke_events().capture.newVideoMode->subscribe([]
+    std::lock_guard<std::mutex> lock(DRAIN_MUTEX);
+
+    bool wasAnythingWritten = false;
+
+    while (true)
     {
-        const auto resolution = kc_capture_api().get_resolution();
+        const unsigned idx = (DEQUEUE_POS % LOG_QUEUE_SIZE);
+        queued_log_entry_s &slot = LOG_QUEUE[idx];
 
-        INFO(("New video mode: %u x %u @ %f Hz.", resolution.w, resolution.h, kc_capture_api().get_refresh_rate().value<double>()));
-    });
+        // The slot's entry hasn't been fully submitted yet.
+        if ((slot.sequence.load(std::memory_order_acquire) + idx) != (DEQUEUE_POS + 1))
+        {
+            break;
+        }
+
+        write_entry(slot.level, slot.message);
+
+        // Free the slot for the next lap around the queue.
+        slot.sequence.store((DEQUEUE_POS + LOG_QUEUE_SIZE - idx), std::memory_order_release);
+        DEQUEUE_POS++;
+
+        wasAnythingWritten = true;
+    }
+
+    const uint numDropped = NUM_DROPPED_ENTRIES.load();
+    if (numDropped != NUM_DROPPED_ENTRIES_REPORTED)
+    {
+        char message[128];
+        snprintf(message, NUM_ELEMENTS(message), "The log queue was full. Dropped %u entries.",
+                 (numDropped - NUM_DROPPED_ENTRIES_REPORTED));
+
+        write_entry(log_level_e::error, message);
+
+        NUM_DROPPED_ENTRIES_REPORTED = numDropped;
+        wasAnythingWritten = true;
+    }
+
+    if (wasAnythingWritten)
+    {
+        fflush(stdout);
+
+        if (LOG_FILE)
+        {
+            fflush(LOG_FILE);
+        }
+    }
 
     return;
 }
 
-void log(const char *const type, const char *const msg, va_list args)
+static void drain_thread_function(void)
 {
-    // Only allow logging from the main thread.
-    if (std::this_thread::get_id() != NATIVE_LOG_THREAD)
+    while (!STOP_DRAIN_THREAD)
     {
-        return;
+        drain_queue();
+        std::this_thread::sleep_for(std::chrono::milliseconds(DRAIN_INTERVAL_MS));
     }
 
+    drain_queue();
+
+    return;
+}
+
+// The drain thread is started on the first submitted entry, so that entries
+// logged early in VCS's startup get written out, too.
+static void start_drain_thread(void)
+{
+    static std::once_flag isStarted;
+
+    std::call_once(isStarted, []
+    {
+        DRAIN_THREAD = new std::thread(drain_thread_function);
+
+        // In case VCS exits without going through its usual cleanup, e.g. on
+        // a failure early in startup.
+        std::atexit(klog_release);
+    });
+
+    return;
+}
+
+static void log(const log_level_e level, const char *const msg, va_list args)
+{
     // If the user has turned logging off, don't output anything. Except if
     // the program is exiting - then output the last messages of the exit.
     if (!LOGGING_ENABLED &&
@@ -74,35 +232,172 @@ void log(const char *const type, const char *const msg, va_list args)
         return;
     }
 
-    char buf[1024];
-    vsnprintf(buf, NUM_ELEMENTS(buf), msg, args);
+    if (int(level) < MIN_LOG_LEVEL.load(std::memory_order_relaxed))
+    {
+        return;
+    }
 
-    log_entry_s entry;
-    entry.id = TOTAL_NUM_LOG_ENTRIES;
-    entry.type = type;
-    entry.message = buf;
+    if (!IS_RELEASED)
+    {
+        start_drain_thread();
+    }
 
-    LOG_CACHE.push_back(entry);
-    TOTAL_NUM_LOG_ENTRIES++;
+    // Claim a slot in the queue.
+    u64 pos = ENQUEUE_POS.load(std::memory_order_relaxed);
+    unsigned idx = 0;
+    while (true)
+    {
+        idx = (pos % LOG_QUEUE_SIZE);
 
-    // Output the entry into the console.
-    printf("[%-5s] %s\n", type, buf);
+        const i64 diff = (i64(LOG_QUEUE[idx].sequence.load(std::memory_order_acquire) + idx) - i64(pos));
 
-    // Try and dump the entry/entries into the GUI. If we can't, just
-    // give up for now and we'll try again next time.
-    while (!LOG_CACHE.empty())
-    {
-        if (!PROGRAM_EXIT_REQUESTED &&
-            kd_add_log_entry(LOG_CACHE.front()))
+        // The slot is free.
+        if (diff == 0)
         {
-            LOG_CACHE.pop_front();
+            if (ENQUEUE_POS.compare_exchange_weak(pos, (pos + 1), std::memory_order_relaxed))
+            {
+                break;
+            }
         }
-        else
+        // The slot still holds an entry from the previous lap, i.e. the queue
+        // is full.
+        else if (diff < 0)
         {
+            NUM_DROPPED_ENTRIES++;
             return;
         }
+        // Another thread claimed the slot before us.
+        else
+        {
+            pos = ENQUEUE_POS.load(std::memory_order_relaxed);
+        }
+    }
+
+    queued_log_entry_s &slot = LOG_QUEUE[idx];
+
+    vsnprintf(slot.message, NUM_ELEMENTS(slot.message), msg, args);
+    slot.level = level;
+
+    // Mark the entry as ready to be written out.
+    slot.sequence.store((pos + 1 - idx), std::memory_order_release);
+
+    if (IS_RELEASED)
+    {
+        klog_flush();
+    }
+
+    return;
+}
+
+void klog_set_logging_enabled(const bool state)
+{
+    if (state)
+    {
+        LOGGING_ENABLED = true;
+        INFO(("Logging has been enabled."));
+    }
+    else
+    {
+        INFO(("[Info] Logging has been disabled by request. Re-enable it to see "
+               "further messages."));
+        LOGGING_ENABLED = false;
+    }
+
+    return;
+}
+
+void klog_set_log_level(const log_level_e level)
+{
+    MIN_LOG_LEVEL = int(level);
+
+    return;
+}
+
+log_level_e klog_log_level(void)
+{
+    return log_level_e(MIN_LOG_LEVEL.load());
+}
+
+bool klog_set_log_file(const std::string &filename)
+{
+    std::lock_guard<std::mutex> lock(DRAIN_MUTEX);
+
+    if (LOG_FILE)
+    {
+        fclose(LOG_FILE);
+        LOG_FILE = nullptr;
     }
 
+    if (filename.empty())
+    {
+        return true;
+    }
+
+    LOG_FILE = fopen(filename.c_str(), "w");
+
+    return bool(LOG_FILE);
+}
+
+void klog_flush(void)
+{
+    drain_queue();
+
+    return;
+}
+
+void klog_update_gui(void)
+{
+    std::lock_guard<std::mutex> lock(GUI_CACHE_MUTEX);
+
+    // If the GUI can't take the entries yet, we'll try again next time.
+    while (!GUI_CACHE.empty() &&
+           !PROGRAM_EXIT_REQUESTED &&
+           kd_add_log_entry(GUI_CACHE.front()))
+    {
+        GUI_CACHE.pop_front();
+    }
+
+    return;
+}
+
+uint klog_num_dropped_entries(void)
+{
+    return NUM_DROPPED_ENTRIES;
+}
+
+void klog_initialize(void)
+{
+    ke_events().capture.newVideoMode->subscribe([]
+    {
+        const auto resolution = kc_capture_api().get_resolution();
+
+        INFO(("New video mode: %u x %u @ %f Hz.", resolution.w, resolution.h, kc_capture_api().get_refresh_rate().value<double>()));
+    });
+
+    return;
+}
+
+void klog_release(void)
+{
+    if (IS_RELEASED.exchange(true))
+    {
+        return;
+    }
+
+    if (DRAIN_THREAD)
+    {
+        STOP_DRAIN_THREAD = true;
+        DRAIN_THREAD->join();
+
+        delete DRAIN_THREAD;
+        DRAIN_THREAD = nullptr;
+    }
+
+    // Write out anything that was submitted while the thread was stopping.
+    klog_flush();
+
+    klog_set_log_file("");
+
     return;
 }
 
@@ -110,7 +405,7 @@ void klog_log_error(const char *const msg, ...)
 {
     va_list args;
     va_start(args, msg);
-        log("Error", msg, args);
+        log(log_level_e::error, msg, args);
     va_end(args);
 
     return;
@@ -120,7 +415,7 @@ void klog_log_info(const char *const msg, ...)
 {
     va_list args;
     va_start(args, msg);
-        log("Info", msg, args);
+        log(log_level_e::info, msg, args);
     va_end(args);
 
     return;
@@ -130,7 +425,7 @@ void klog_log_debug(const char *const msg, ...)
 {
     va_list args;
     va_start(args, msg);
-        log("Debug", msg, args);
+        log(log_level_e::debug, msg, args);
     va_end(args);
 
     return;
@@ -10,6 +10,21 @@
 #include <string>
 #include "common/types.h"
 
+// The lowest level of log entry that gets compiled in; the DEBUG(), INFO(), and
+// NBENE() macros of entries below it expand to nothing. Corresponds to the
+// values of log_level_e, e.g. 1 to compile out debug entries. Can be set at
+// build time, e.g. via DEFINES += VCS_MIN_LOG_LEVEL=1.
+#ifndef VCS_MIN_LOG_LEVEL
+    #define VCS_MIN_LOG_LEVEL 0
+#endif
+
+enum class log_level_e
+{
+    debug = 0,
+    info  = 1,
+    error = 2,
+};
+
 struct log_entry_s
 {
     // The index of this entry in the master list of log entries.
@@ -21,6 +36,9 @@ struct log_entry_s
     std::string message;
 };
 
+// Entries can be logged from any thread. They're queued without locking and
+// written out - into the console, the log file (if any), and the GUI - in the
+// background, so logging doesn't stall the caller.
 void klog_log_error(const char *const msg, ...);
 
 void klog_log_debug(const char *const msg, ...);
@@ -29,6 +47,31 @@ void klog_log_info(const char *const msg, ...);
 
 void klog_set_logging_enabled(const bool state);
 
+// Entries below the given level will be ignored. Note that entries below
+// VCS_MIN_LOG_LEVEL will have been compiled out regardless.
+void klog_set_log_level(const log_level_e level);
+
+log_level_e klog_log_level(void);
+
+// Asks the logger to also write entries into the given file, replacing its
+// contents. An empty filename stops any file output. Returns false if the file
+// couldn't be opened.
+bool klog_set_log_file(const std::string &filename);
+
+// Writes out any entries still waiting in the queue. Blocks until done.
+void klog_flush(void);
+
+// Passes to the GUI any entries written out since the previous call. The GUI
+// expects to be accessed from the main thread only, so should be called from
+// there, e.g. once per iteration of the main loop.
+void klog_update_gui(void);
+
+// The number of entries that have had to be discarded because the queue was
+// full.
+uint klog_num_dropped_entries(void);
+
 void klog_initialize(void);
 
+void klog_release(void);
+
 #endif
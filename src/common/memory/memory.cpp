@@ -2,175 +2,535 @@
  * 2018 Tarpeeksi Hyvae Soft /
  * VCS memory manager
  *
- * A basic memory manager. Allocates a bunch of memory on initialization, then doles
- * it out to callers in small sequential chunks afterwards. Useful to prevent fragmentation
- * and to see how memory is being used by the program, though a limited implementation.
+ * A pooling memory manager. Allocations are rounded up into size classes, and
+ * released blocks are kept in per-class free lists for reuse by later requests
+ * of a similar size - e.g. frame buffers for different resolutions - rather than
+ * being handed back to the system right away.
+ *
+ * Each thread keeps a small cache of free blocks of its own, so that threads
+ * which repeatedly allocate and release memory needn't contend for the shared
+ * pool. The pool grows on demand, and blocks in excess of its caching limits are
+ * returned to the system.
+ *
+ * Each block is prefixed with a header recording the allocation's size and the
+ * reason given for it. Live usage is tallied per reason as blocks are allocated
+ * and released, so that kmem_memory_usage() can report at any time where the
+ * memory is going, without walking the blocks.
+ *
+ * All blocks are 64-byte aligned, for aligned SIMD access. Blocks of frame size
+ * or larger are page-aligned (so they can be handed to e.g. V4L2 as user
+ * pointer buffers), and on Linux, are mapped so as to be backed by huge pages
+ * where the system allows it, to cut down on TLB misses during full-frame
+ * passes.
  *
  */
 
-#include <stdexcept>
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
-#include <thread>
+#include <cstdio>
+#include <atomic>
+#include <vector>
+#include <mutex>
+#ifdef __linux__
+    #include <sys/mman.h>
+#endif
+#ifdef _WIN32
+    #include <malloc.h>
+#endif
 #include "common/memory/memory_interface.h"
 #include "common/memory/memory.h"
 #include "common/globals.h"
 
-/*
- * TODOS:
- *
- * - add dynamic resizing to the memory cache for when it's running short.
- *
- */
+// Allocations are rounded up to a size class. Classes start at MIN_BLOCK_SIZE
+// bytes, and above that, each power of two is divided into NUM_SUB_CLASSES
+// equally-spaced classes; so a block has at most 1/NUM_SUB_CLASSES of slack.
+static const uint MIN_BLOCK_SIZE = 64;
+static const uint NUM_SUB_CLASSES = 8;
 
-// How many bytes to pre-allocate for the memory cache. Note that the cache
-// currently has no ability to grow itself, so this amount must be sufficient
-// for the whole of the program's execution.
-static uint MEMORY_CACHE_SIZE = 1024/*MB*/ * 1024 * 1024;
+// Enough classes for allocations of up to 2 GB.
+static const uint NUM_SIZE_CLASSES = (1 + (NUM_SUB_CLASSES * 25));
 
-// The memory manager isn't prepared for multithreading, so discourage its use in
-// that context. We'll grab the id of whatever thread initializes this, and later
-// bail if any other thread requests operations of the manager.
-static const std::thread::id NATIVE_THREAD_ID = std::this_thread::get_id();
+// How many bytes of free blocks each thread may keep in its own cache, and how
+// many the shared pool may keep. Blocks released beyond these limits are returned
+// to the system.
+static const u64 MAX_THREAD_CACHE_SIZE = (64/*MB*/ * 1024 * 1024);
+static const u64 MAX_SHARED_POOL_SIZE = (256/*MB*/ * 1024 * 1024);
 
-// A single allocation from the memory cache.
-struct mem_allocation_s
+// Blocks of at least this size get mapped from the system directly, to be
+// backed by huge pages where possible.
+static const u64 HUGE_PAGE_SIZE = (2/*MB*/ * 1024 * 1024);
+
+// The data of a mapped block starts at this offset into its mapping, so as to
+// be page-aligned; the block's header sits just before it.
+static const u64 MAPPED_DATA_OFFSET = 4096;
+
+// Marks a block's header as belonging to a live or to a released allocation.
+static const u32 BLOCK_MAGIC_IN_USE = 0x564d454d;
+static const u32 BLOCK_MAGIC_RELEASED = 0x66726565;
+
+// Precedes each block of memory handed out by the memory manager.
+struct block_header_s
 {
-    char reason[64];    // For what purpose the memory was needed.
-    const void *memory;
-    uint numBytes;
-    bool isInUse;       // Set to false if the owner asks the memory manager to release the memory.
-    bool isReused;      // Whether this allocation used to belong to someone else who since had it released.
+    u32 magic;
+    u32 sizeClass;
+
+    // The size of the allocation as requested; may be less than the size of
+    // its class.
+    u32 numBytes;
+
+    // Whether the block is in a mapping of its own (cf. HUGE_PAGE_SIZE) rather
+    // than from the C heap.
+    u32 isMapped;
+
+    // For what purpose the memory was needed; an index into REASONS.
+    u32 reasonId;
+
+    // The thread that allocated the block (cf. THREAD_ID). Only that thread
+    // keeps the block in its cache on releasing it, since only it is likely to
+    // allocate another of the same kind.
+    u32 ownerThreadId;
+
+    u8 padding[40];
+};
+
+// Sized so that a block's data has the same 64-byte alignment as the header.
+static_assert((sizeof(block_header_s) == 64), "Expected the block header to be 64 bytes.");
+
+// Free blocks, by size class.
+struct free_lists_s
+{
+    std::vector<block_header_s*> blocks[NUM_SIZE_CLASSES];
+
+    // The combined size of the blocks, by their size class.
+    u64 numBytes = 0;
+};
+
+struct thread_cache_s : free_lists_s
+{
+    ~thread_cache_s(void);
 };
 
-static int TOTAL_BYTES_ALLOCATED = 0;
-static int TOTAL_BYTES_RELEASED = 0;
+// Free blocks shared among all threads. Only to be accessed while holding
+// shared_pool_mutex().
+//
+// Allocated on first use and never destroyed, so that threads can return their
+// caches into it at any point of program termination.
+static free_lists_s& shared_pool(void)
+{
+    static free_lists_s *const pool = new free_lists_s;
+
+    return *pool;
+}
+
+static std::mutex& shared_pool_mutex(void)
+{
+    static std::mutex *const mutex = new std::mutex;
+
+    return *mutex;
+}
+
+static thread_local thread_cache_s THREAD_CACHE;
 
-static u8 *MEMORY_CACHE = NULL;
-static u8 *NEXT_FREE = NULL;    // A pointer to the next free byte in the memory cache (allocations from the cache are made sequentially).
+// Set once the thread's cache has been destroyed on the thread's exit, after
+// which any further (de)allocations by the thread go through the shared pool.
+static thread_local bool IS_THREAD_CACHE_DESTROYED = false;
 
-// Each allocation requested is logged into the allocation table.
-static const uint NUM_ALLOC_TABLE_ELEMENTS = 512;
-static mem_allocation_s *ALLOC_TABLE = NULL;
+// A number identifying the current thread to the memory manager; e.g. as the
+// owner of the blocks it allocates.
+static std::atomic<u32> NUM_THREAD_IDS{0};
+static thread_local const u32 THREAD_ID = ++NUM_THREAD_IDS;
+
+// Running totals, in bytes.
+static std::atomic<u64> TOTAL_BYTES_ALLOCATED{0};
+static std::atomic<u64> TOTAL_BYTES_RELEASED{0};
+static std::atomic<u64> NUM_BYTES_FROM_SYSTEM{0};
+
+// Live usage, in bytes as requested; and the same in bytes of the blocks' size
+// classes, the difference being slack from rounding up to the class.
+static std::atomic<u64> NUM_BYTES_IN_USE{0};
+static std::atomic<u64> NUM_CLASS_BYTES_IN_USE{0};
+static std::atomic<u64> PEAK_BYTES_IN_USE{0};
+
+// How many allocations have been made, and how many of those were served with
+// a block from a free list rather than with new memory from the system.
+static std::atomic<u64> NUM_ALLOCATIONS{0};
+static std::atomic<u64> NUM_REUSED_ALLOCATIONS{0};
 
 // Set to 1 to disallow any further allocations from the cache.
-static uint CACHE_ALLOC_LOCKED = 0;
+static std::atomic<uint> CACHE_ALLOC_LOCKED{0};
 
-static void initialize_cache(void)
+// Allocation reasons past this many distinct ones are tallied together under
+// the last entry.
+static const uint MAX_NUM_REASONS = 128;
+
+// Reasons longer than this are truncated.
+static const uint MAX_REASON_LENGTH = 48;
+
+// Live usage by allocation reason.
+struct reason_usage_s
 {
-    DEBUG(("Initializing the memory manager..."));
+    // Written once, when the reason is registered.
+    char name[MAX_REASON_LENGTH];
 
-    // Ideally, we'll only call this function once.
-    k_assert(MEMORY_CACHE == NULL, "Calling the memory manager initializer with a non-null memory cache.");
+    std::atomic<u64> numBytes;
+    std::atomic<u64> peakBytes;
+    std::atomic<u64> numAllocations;
+};
 
-    static_assert(std::is_same<decltype(MEMORY_CACHE), u8*>::value && (sizeof(u8) == 1), "Expected the memory cache to be u8*.");
-    MEMORY_CACHE = (u8*)calloc(MEMORY_CACHE_SIZE, 1); // Expect to use calloc(), for a cleared-out block.
-    NEXT_FREE = MEMORY_CACHE;
-    k_assert(MEMORY_CACHE != NULL, "The memory manager failed to allocate enough memory for its operation.");
+// Reasons are registered on first use and never removed. Registration is
+// guarded by the mutex; lookups read up to NUM_REASONS without it.
+static reason_usage_s REASONS[MAX_NUM_REASONS];
+static std::atomic<uint> NUM_REASONS{0};
+static std::mutex REASONS_MUTEX;
 
-    // Use the beginning of the memory cache for the allocation table.
-    k_assert((ALLOC_TABLE == NULL), "Expected a null allocation table.");
-    const uint allocTableByteSize = (NUM_ALLOC_TABLE_ELEMENTS * sizeof(mem_allocation_s));
-    k_assert((allocTableByteSize < MEMORY_CACHE_SIZE), "Not enough room in the memory cache for the allocation table.");
-    ALLOC_TABLE = (mem_allocation_s*)MEMORY_CACHE;
-    TOTAL_BYTES_ALLOCATED += allocTableByteSize;
-    NEXT_FREE += allocTableByteSize;
+// Raises the given peak to the given value, if it's lower.
+static void update_peak(std::atomic<u64> &peak, const u64 value)
+{
+    u64 current = peak.load(std::memory_order_relaxed);
+
+    while ((current < value) &&
+           !peak.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+        ;
+    }
 
     return;
 }
 
-// Will return a valid pointer to a zero-initialized block of memory of the given
-// size; or trips an assert if can't.
-//
-void* kmem_allocate(const int numBytes, const char *const reason)
+// Returns the index in REASONS of the given allocation reason, registering the
+// reason if it hasn't been already.
+static uint reason_id(const char *const reason)
 {
-    k_assert(std::this_thread::get_id() == NATIVE_THREAD_ID, "Potential attempt to allocate memory from multiple threads. This isn't supported.");
+    char name[MAX_REASON_LENGTH];
+    snprintf(name, NUM_ELEMENTS(name), "%s", (reason? reason : "Unspecified"));
 
-    k_assert(!CACHE_ALLOC_LOCKED, "Memory allocations are locked, can't add new ones.");
-    k_assert(!PROGRAM_EXIT_REQUESTED, "No more memory should be allocated after the program has been asked to terminate.");
-    k_assert(numBytes > 0, "Can't allocate sub-byte memory blocks.");
+    const auto find = [&name](const uint numReasons)->int
+    {
+        for (uint i = 0; i < numReasons; i++)
+        {
+            if (strcmp(REASONS[i].name, name) == 0)
+            {
+                return i;
+            }
+        }
 
-    // Initialize the memory cache the first time the allocator is called.
-    if (MEMORY_CACHE == NULL)
+        return -1;
+    };
+
+    int id = find(NUM_REASONS.load(std::memory_order_acquire));
+
+    if (id < 0)
     {
-        initialize_cache();
+        std::lock_guard<std::mutex> lock(REASONS_MUTEX);
+
+        const uint numReasons = NUM_REASONS.load(std::memory_order_relaxed);
+
+        // Another thread may have registered the reason meanwhile.
+        id = find(numReasons);
+
+        if (id < 0)
+        {
+            if (numReasons == (MAX_NUM_REASONS - 1))
+            {
+                snprintf(name, NUM_ELEMENTS(name), "Other");
+            }
+            else if (numReasons == MAX_NUM_REASONS)
+            {
+                return (MAX_NUM_REASONS - 1);
+            }
+
+            id = numReasons;
+            memcpy(REASONS[id].name, name, sizeof(name));
+            NUM_REASONS.store((numReasons + 1), std::memory_order_release);
+        }
     }
 
-    k_assert(NEXT_FREE != NULL, "Didn't have a valid free slot in the memory cache for a new allocation.");
-    u8 *mem = NEXT_FREE;
+    return id;
+}
+
+// Returns the size class of an allocation of the given number of bytes.
+static uint size_class_of(const u64 numBytes)
+{
+    if (numBytes <= MIN_BLOCK_SIZE)
+    {
+        return 0;
+    }
 
-    // Find a free spot in the allocation table.
-    uint tableIdx = 0;
-    bool useOldEntry = false;   // If we decided to use a previously-cleared entry.
-    while (1)
+    u64 power = MIN_BLOCK_SIZE;
+    uint classIdx = 1;
+    while ((power * 2) < numBytes)
     {
-        // Take the first unallocated entry. These will always be at the end of
-        // the allocation chain, since past allocations are never cleared until
-        // the program exits.
-        if (ALLOC_TABLE[tableIdx].memory == NULL)
+        power *= 2;
+        classIdx += NUM_SUB_CLASSES;
+    }
+
+    const u64 step = (power / NUM_SUB_CLASSES);
+    const u64 subClass = ((numBytes - power + step - 1) / step);
+
+    return (classIdx + subClass - 1);
+}
+
+static u64 size_of_class(const uint sizeClass)
+{
+    u64 power = MIN_BLOCK_SIZE;
+    uint classIdx = sizeClass;
+
+    if (!classIdx)
+    {
+        return MIN_BLOCK_SIZE;
+    }
+
+    classIdx--;
+    while (classIdx >= NUM_SUB_CLASSES)
+    {
+        power *= 2;
+        classIdx -= NUM_SUB_CLASSES;
+    }
+
+    return (power + ((classIdx + 1) * (power / NUM_SUB_CLASSES)));
+}
+
+static block_header_s* header_of(const void *const mem)
+{
+    return ((block_header_s*)mem - 1);
+}
+
+#ifdef __linux__
+// The length of the mapping that holds a mapped block of the given size class.
+static u64 mapping_length(const uint sizeClass)
+{
+    const u64 length = (MAPPED_DATA_OFFSET + size_of_class(sizeClass));
+
+    return (((length + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE) * HUGE_PAGE_SIZE);
+}
+
+// Maps zeroed memory for a block of the given size class, preferring explicit
+// huge pages (MAP_HUGETLB), then transparent huge pages, then regular pages.
+// Returns a pointer to the block's data, or nullptr on failure.
+static u8* map_block_data(const uint sizeClass)
+{
+    const u64 length = mapping_length(sizeClass);
+
+    // Explicit huge pages need to have been reserved by the system's admin, so
+    // this will often fail.
+    void *mapping = mmap(nullptr, length, (PROT_READ | PROT_WRITE), (MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB), -1, 0);
+
+    if (mapping == MAP_FAILED)
+    {
+        // Transparent huge pages only back regions aligned to the huge page
+        // size, so over-map and trim the mapping to alignment.
+        u8 *const overMapping = (u8*)mmap(nullptr, (length + HUGE_PAGE_SIZE), (PROT_READ | PROT_WRITE), (MAP_PRIVATE | MAP_ANONYMOUS), -1, 0);
+
+        if (overMapping == MAP_FAILED)
         {
-            break;
+            return nullptr;
         }
 
-        // But also, if there's a released entry of just the right size, we can
-        // take that one instead.
-        if (!ALLOC_TABLE[tableIdx].isInUse &&
-            ALLOC_TABLE[tableIdx].numBytes == uint(numBytes))
+        u8 *const aligned = (u8*)((((uintptr_t)overMapping + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE) * HUGE_PAGE_SIZE);
+        const u64 headSlack = (aligned - overMapping);
+        const u64 tailSlack = (HUGE_PAGE_SIZE - headSlack);
+
+        if (headSlack) munmap(overMapping, headSlack);
+        if (tailSlack) munmap((aligned + length), tailSlack);
+
+        // Failure here just means no huge pages.
+        madvise(aligned, length, MADV_HUGEPAGE);
+
+        mapping = aligned;
+    }
+
+    return ((u8*)mapping + MAPPED_DATA_OFFSET);
+}
+#endif
+
+static block_header_s* allocate_from_system(const uint sizeClass)
+{
+    const u64 classSize = size_of_class(sizeClass);
+    block_header_s *block = nullptr;
+
+    #ifdef __linux__
+        if (classSize >= HUGE_PAGE_SIZE)
         {
-            useOldEntry = true;
-            break;
+            u8 *const data = map_block_data(sizeClass);
+
+            if (data)
+            {
+                block = ((block_header_s*)data - 1);
+                block->isMapped = true;
+            }
         }
+    #endif
 
-        tableIdx++;
-        k_assert(tableIdx < NUM_ALLOC_TABLE_ELEMENTS,
-                 "Memory manager overflowed while looking for room for an allocation.");
+    if (!block)
+    {
+        #ifdef _WIN32
+            block = (block_header_s*)_aligned_malloc((sizeof(block_header_s) + classSize), 64);
+        #else
+            if (posix_memalign((void**)&block, 64, (sizeof(block_header_s) + classSize)) != 0)
+            {
+                block = nullptr;
+            }
+        #endif
+
+        k_assert(block, "The memory manager failed to allocate memory from the system.");
+
+        memset(block, 0, (sizeof(block_header_s) + classSize));
     }
 
-    if (useOldEntry)
+    block->sizeClass = sizeClass;
+    NUM_BYTES_FROM_SYSTEM += classSize;
+
+    return block;
+}
+
+static void release_to_system(block_header_s *const block)
+{
+    NUM_BYTES_FROM_SYSTEM -= size_of_class(block->sizeClass);
+
+    #ifdef __linux__
+        if (block->isMapped)
+        {
+            munmap(((u8*)(block + 1) - MAPPED_DATA_OFFSET), mapping_length(block->sizeClass));
+
+            return;
+        }
+    #endif
+
+    #ifdef _WIN32
+        _aligned_free(block);
+    #else
+        free(block);
+    #endif
+
+    return;
+}
+
+// Returns a free block of the given size class from the given free lists, or
+// nullptr if there isn't one.
+static block_header_s* take_from_free_list(free_lists_s &freeLists, const uint sizeClass)
+{
+    auto &blocks = freeLists.blocks[sizeClass];
+
+    if (blocks.empty())
     {
-        mem = (u8*)ALLOC_TABLE[tableIdx].memory;
-        ALLOC_TABLE[tableIdx].isReused = true;
+        return nullptr;
     }
-    else
+
+    block_header_s *const block = blocks.back();
+    blocks.pop_back();
+    freeLists.numBytes -= size_of_class(sizeClass);
+
+    return block;
+}
+
+// Adds the given free block into the given free lists if doing so would keep
+// their combined size within the given limit. Returns false otherwise.
+static bool add_to_free_list(free_lists_s &freeLists, block_header_s *const block, const u64 maxNumBytes)
+{
+    const u64 classSize = size_of_class(block->sizeClass);
+
+    if ((freeLists.numBytes + classSize) > maxNumBytes)
     {
-        TOTAL_BYTES_ALLOCATED += numBytes;
-        NEXT_FREE += numBytes;
+        return false;
     }
 
-    k_assert(strlen(reason) < NUM_ELEMENTS(ALLOC_TABLE[tableIdx].reason),
-             "The reason given for an allocation was too long to fit into the string array.");
-    strcpy(ALLOC_TABLE[tableIdx].reason, reason);
-    ALLOC_TABLE[tableIdx].memory = mem;
-    ALLOC_TABLE[tableIdx].numBytes = numBytes;
-    ALLOC_TABLE[tableIdx].isInUse = true;
+    freeLists.blocks[block->sizeClass].push_back(block);
+    freeLists.numBytes += classSize;
 
-    // Validate the memory before sending it off.
-    k_assert((mem + numBytes) < (MEMORY_CACHE + MEMORY_CACHE_SIZE),
-             "Memory allocation would overflow the memory cache size. The cache needs to be made larger.");
-    k_assert(mem != NULL, "Detected a null return from the memory manager allocator. This should not be the case.");
-    memset(mem, 0, numBytes);
+    return true;
+}
 
-    return (void*)mem;
+// Hands the given free block to the shared pool, or to the system if the pool
+// is full.
+static void return_to_shared_pool(block_header_s *const block)
+{
+    bool isPooled = false;
+    {
+        std::lock_guard<std::mutex> lock(shared_pool_mutex());
+        isPooled = add_to_free_list(shared_pool(), block, MAX_SHARED_POOL_SIZE);
+    }
+
+    if (!isPooled)
+    {
+        release_to_system(block);
+    }
+
+    return;
 }
 
-static uint alloc_table_index_of_pointer(const void *const mem)
+// When a thread exits, the blocks in its cache become available to other threads.
+thread_cache_s::~thread_cache_s(void)
 {
-    uint tableIdx = 0;
-    while (ALLOC_TABLE[tableIdx].memory != mem)
+    IS_THREAD_CACHE_DESTROYED = true;
+
+    for (auto &blocks: this->blocks)
     {
-        tableIdx++;
-        if (tableIdx >= NUM_ALLOC_TABLE_ELEMENTS)
+        for (auto *const block: blocks)
         {
-            k_assert(0, "Couldn't find the requested allocation in the allocation table.");
-            goto bail;
+            return_to_shared_pool(block);
         }
+
+        blocks.clear();
     }
 
-    return tableIdx;
+    this->numBytes = 0;
 
-    bail:
-    throw std::runtime_error("Unexpected code path in the memory manager.");    // We should never reach this, but will if asserts are disabled.
-    return 0;
+    return;
+}
+
+// Returns a valid pointer to a zero-initialized block of memory of the given
+// size; or trips an assert if it can't. Can be called from any thread.
+void* kmem_allocate(const int numBytes, const char *const reason)
+{
+    k_assert(!CACHE_ALLOC_LOCKED, "Memory allocations are locked, can't add new ones.");
+    k_assert(!PROGRAM_EXIT_REQUESTED, "No more memory should be allocated after the program has been asked to terminate.");
+    k_assert(numBytes > 0, "Can't allocate sub-byte memory blocks.");
+    k_assert((uint(numBytes) <= size_of_class(NUM_SIZE_CLASSES - 1)), "Can't allocate a memory block this large.");
+
+    const uint sizeClass = size_class_of(numBytes);
+
+    // Prefer a block from this thread's own cache, then one from the shared pool,
+    // and only then new memory.
+    block_header_s *block = (IS_THREAD_CACHE_DESTROYED? nullptr : take_from_free_list(THREAD_CACHE, sizeClass));
+    if (!block)
+    {
+        std::lock_guard<std::mutex> lock(shared_pool_mutex());
+        block = take_from_free_list(shared_pool(), sizeClass);
+    }
+
+    if (block)
+    {
+        k_assert((block->magic == BLOCK_MAGIC_RELEASED), "Found a corrupted memory block in the free list.");
+
+        memset((block + 1), 0, numBytes);
+
+        NUM_REUSED_ALLOCATIONS++;
+    }
+    else
+    {
+        block = allocate_from_system(sizeClass);
+    }
+
+    block->magic = BLOCK_MAGIC_IN_USE;
+    block->numBytes = numBytes;
+    block->reasonId = reason_id(reason);
+    block->ownerThreadId = THREAD_ID;
+
+    // Tally the allocation.
+    {
+        reason_usage_s &reasonUsage = REASONS[block->reasonId];
+
+        update_peak(reasonUsage.peakBytes, (reasonUsage.numBytes += numBytes));
+        reasonUsage.numAllocations++;
+
+        update_peak(PEAK_BYTES_IN_USE, (NUM_BYTES_IN_USE += numBytes));
+        NUM_CLASS_BYTES_IN_USE += size_of_class(sizeClass);
+        NUM_ALLOCATIONS++;
+        TOTAL_BYTES_ALLOCATED += numBytes;
+    }
+
+    return (void*)(block + 1);
 }
 
 // Returns the number of bytes allocated for the memory block starting at the given
@@ -183,41 +543,54 @@ uint kmem_sizeof_allocation(const void *const mem)
         return 0;
     }
 
-    const uint idx = alloc_table_index_of_pointer(mem);
+    const block_header_s *const block = header_of(mem);
+    k_assert((block->magic == BLOCK_MAGIC_IN_USE), "Asked for the size of memory not allocated by the memory manager.");
 
-    return ALLOC_TABLE[idx].numBytes;
+    return block->numBytes;
 }
 
-// Mark the given pointer as NULL. Internally, we still retain its pointer for
-// for possible reuse, and will deallocate its memory at the end of the program.
-//
+// Marks the given pointer as NULL, and returns its memory to the pool for reuse.
+// Can be called from any thread, regardless of which thread made the allocation.
 void kmem_release(void **mem)
 {
-    k_assert(std::this_thread::get_id() == NATIVE_THREAD_ID, "Potential attempt to release memory from multiple threads. This isn't supported.");
-
     if (*mem == NULL)
     {
         return;
     }
 
-    // Make sure we've been asked to release a valid allocation.
-    assert(*mem >= MEMORY_CACHE);
-    assert(*mem <= (MEMORY_CACHE + MEMORY_CACHE_SIZE));
-
-    const uint idx = alloc_table_index_of_pointer(*mem);
+    block_header_s *const block = header_of(*mem);
 
     // Warn of double deletes.
-    if (!ALLOC_TABLE[idx].isInUse)
+    if (block->magic == BLOCK_MAGIC_RELEASED)
     {
-        NBENE(("Asked to double-delete memory at %p (%s).", *mem, ALLOC_TABLE[idx].reason));
+        NBENE(("Asked to double-delete memory at %p (%s).", *mem, REASONS[block->reasonId].name));
         k_assert(0, "Double-deleting memory.");
     }
 
-    ALLOC_TABLE[idx].isInUse = false;
+    k_assert((block->magic == BLOCK_MAGIC_IN_USE), "Asked to release memory not allocated by the memory manager.");
+
+    block->magic = BLOCK_MAGIC_RELEASED;
+
+    // Tally the release.
+    {
+        reason_usage_s &reasonUsage = REASONS[block->reasonId];
+
+        reasonUsage.numBytes -= block->numBytes;
+        reasonUsage.numAllocations--;
+
+        NUM_BYTES_IN_USE -= block->numBytes;
+        NUM_CLASS_BYTES_IN_USE -= size_of_class(block->sizeClass);
+        TOTAL_BYTES_RELEASED += block->numBytes;
+    }
 
-    if (!ALLOC_TABLE[idx].isReused)
+    // A block released by a thread other than the one that allocated it (e.g. a
+    // frame buffer passed on to the encoder thread) goes into the shared pool,
+    // where the allocating thread can find it again.
+    if (IS_THREAD_CACHE_DESTROYED ||
+        (block->ownerThreadId != THREAD_ID) ||
+        !add_to_free_list(THREAD_CACHE, block, MAX_THREAD_CACHE_SIZE))
     {
-        TOTAL_BYTES_RELEASED += ALLOC_TABLE[idx].numBytes;
+        return_to_shared_pool(block);
     }
 
     *mem = NULL;
@@ -225,6 +598,45 @@ void kmem_release(void **mem)
     return;
 }
 
+memory_usage_s kmem_memory_usage(void)
+{
+    memory_usage_s usage;
+
+    // The counters are read one at a time while other threads may be updating
+    // them, so they needn't agree exactly; clamp to keep the derived figures sane.
+    usage.numBytesInUse = NUM_BYTES_IN_USE;
+    usage.peakNumBytesInUse = std::max(usage.numBytesInUse, PEAK_BYTES_IN_USE.load());
+    usage.numBytesFromSystem = NUM_BYTES_FROM_SYSTEM;
+
+    const u64 numClassBytesInUse = std::min(NUM_CLASS_BYTES_IN_USE.load(), usage.numBytesFromSystem);
+    usage.numBytesPooled = (usage.numBytesFromSystem - numClassBytesInUse);
+
+    usage.fragmentation = (usage.numBytesFromSystem? (1 - (std::min(usage.numBytesInUse, usage.numBytesFromSystem) / double(usage.numBytesFromSystem))) : 0);
+
+    usage.numAllocations = NUM_ALLOCATIONS;
+    usage.reuseRate = (usage.numAllocations? (NUM_REUSED_ALLOCATIONS / double(usage.numAllocations)) : 0);
+
+    const uint numReasons = NUM_REASONS.load(std::memory_order_acquire);
+    for (uint i = 0; i < numReasons; i++)
+    {
+        memory_reason_usage_s reasonUsage;
+
+        reasonUsage.reason = REASONS[i].name;
+        reasonUsage.numBytes = REASONS[i].numBytes;
+        reasonUsage.peakNumBytes = std::max(reasonUsage.numBytes, REASONS[i].peakBytes.load());
+        reasonUsage.numAllocations = REASONS[i].numAllocations;
+
+        usage.reasons.push_back(reasonUsage);
+    }
+
+    std::sort(usage.reasons.begin(), usage.reasons.end(), [](const memory_reason_usage_s &a, const memory_reason_usage_s &b)
+    {
+        return (a.numBytes > b.numBytes);
+    });
+
+    return usage;
+}
+
 void kmem_lock_cache_alloc(void)
 {
     k_assert(CACHE_ALLOC_LOCKED == 0, "Was asked to lock the memory cache, but it had already been locked.");
@@ -240,24 +652,48 @@ void kmem_deallocate_memory_cache(void)
 
     k_assert(PROGRAM_EXIT_REQUESTED, "Was asked to release the memory cache before the program had been told to exit.");
 
-    DEBUG(("Taking stock of allocations in the memory cache (estimated values)."));
-    DEBUG(("Allocated:\t%d KB (%d%% utilization).", (TOTAL_BYTES_ALLOCATED / 1024), int((real(TOTAL_BYTES_ALLOCATED) / MEMORY_CACHE_SIZE) * 100)));
-    DEBUG(("Released:\t%d KB.", (TOTAL_BYTES_RELEASED / 1024)));
-    DEBUG(("Balance:\t%d bytes.", (TOTAL_BYTES_ALLOCATED - TOTAL_BYTES_RELEASED)));
+    DEBUG(("Taking stock of allocations in the memory cache."));
+    DEBUG(("Allocated:\t%llu KB.", (unsigned long long)(TOTAL_BYTES_ALLOCATED / 1024)));
+    DEBUG(("Released:\t%llu KB.", (unsigned long long)(TOTAL_BYTES_RELEASED / 1024)));
+    DEBUG(("Balance:\t%lld bytes.", (long long)(TOTAL_BYTES_ALLOCATED - TOTAL_BYTES_RELEASED)));
+    DEBUG(("Peak:\t%llu KB.", (unsigned long long)(PEAK_BYTES_IN_USE / 1024)));
+
+    for (const auto &reasonUsage: kmem_memory_usage().reasons)
+    {
+        if (reasonUsage.numAllocations)
+        {
+            DEBUG(("Unreleased:\t%llu bytes in %llu allocation(s) for \"%s\".",
+                   (unsigned long long)reasonUsage.numBytes,
+                   (unsigned long long)reasonUsage.numAllocations,
+                   reasonUsage.reason.c_str()));
+        }
+    }
 
-    /*for (uint i = 0; i < NUM_ALLOC_TABLE_ELEMENTS; i++)
+    // Return the free blocks to the system. Blocks still cached by other threads
+    // will be returned to the shared pool when those threads exit.
     {
+        block_header_s *block = nullptr;
 
-        if ((ALLOC_TABLE[i].memory != NULL) &&
-            ALLOC_TABLE[i].isInUse)
+        for (uint i = 0; (i < NUM_SIZE_CLASSES) && !IS_THREAD_CACHE_DESTROYED; i++)
         {
-            DEBUG(("Unreleased memory: %p, %u bytes. Stated purpose: '%s'.", ALLOC_TABLE[i].memory, ALLOC_TABLE[i].numBytes, ALLOC_TABLE[i].reason));
+            while ((block = take_from_free_list(THREAD_CACHE, i)))
+            {
+                release_to_system(block);
+            }
         }
-    }*/
 
-    DEBUG(("(Unreleased allocations will be freed automatically.)"));
+        std::lock_guard<std::mutex> lock(shared_pool_mutex());
+
+        for (uint i = 0; i < NUM_SIZE_CLASSES; i++)
+        {
+            while ((block = take_from_free_list(shared_pool(), i)))
+            {
+                release_to_system(block);
+            }
+        }
+    }
 
-    free(MEMORY_CACHE);
+    DEBUG(("(Unreleased allocations will be freed automatically.)"));
 
     return;
 }
@@ -8,10 +8,61 @@
 #define MEMORY_H
 
 #include <string>
+#include <vector>
 #include "common/types.h"
 
+// The memory in use for a particular allocation reason, i.e. the reason string
+// given to kmem_allocate().
+struct memory_reason_usage_s
+{
+    std::string reason;
+
+    // In bytes as requested.
+    u64 numBytes = 0;
+    u64 peakNumBytes = 0;
+
+    // How many allocations for this reason are currently live.
+    u64 numAllocations = 0;
+};
+
+// A snapshot of the memory manager's usage.
+struct memory_usage_s
+{
+    // Bytes of live allocations, as requested; and the most there has been at
+    // any one time.
+    u64 numBytesInUse = 0;
+    u64 peakNumBytesInUse = 0;
+
+    // Bytes held from the system, whether in use, pooled for reuse, or lost to
+    // rounding allocations up to their size class.
+    u64 numBytesFromSystem = 0;
+
+    // Bytes of free blocks held for reuse.
+    u64 numBytesPooled = 0;
+
+    // The fraction (0-1) of the memory held from the system that isn't in use.
+    double fragmentation = 0;
+
+    // The fraction (0-1) of allocations that have been served by reusing a
+    // block rather than with new memory from the system.
+    double reuseRate = 0;
+
+    // How many allocations have been made in total.
+    u64 numAllocations = 0;
+
+    // By allocation reason, in descending order of bytes in use.
+    std::vector<memory_reason_usage_s> reasons;
+};
+
 void kmem_lock_cache_alloc(void);
 
+// Returns the memory manager's current usage. Can be called from any thread;
+// cheap enough to be called e.g. once per frame.
+memory_usage_s kmem_memory_usage(void);
+
+// Returns a zero-initialized block of memory of the given size, aligned to 64
+// bytes; or to the page size, for blocks of 2 MB or more. Can be called from
+// any thread.
 void* kmem_allocate(const int numBytes, const char *const reason);
 
 void kmem_release(void **mem);
@@ -6,26 +6,129 @@
  */
 
 #include "common/propagate/app_events.h"
+#include "common/telemetry/telemetry.h"
 
 static vcs_event_pool_c EVENTS;
 
+static vcs_event_queue_c MAIN_THREAD_EVENT_QUEUE("Main");
+
 vcs_event_pool_c& ke_events(void)
 {
     return EVENTS;
 }
 
-void vcs_event_c::subscribe(vcs_event_handler_fn_t handlerFn)
+vcs_event_queue_c& ke_main_thread_event_queue(void)
+{
+    return MAIN_THREAD_EVENT_QUEUE;
+}
+
+vcs_event_queue_c::vcs_event_queue_c(const std::string &name, const unsigned maxNumPending) :
+    name(name),
+    maxNumPending(maxNumPending)
+{
+    return;
+}
+
+vcs_event_queue_c::~vcs_event_queue_c(void)
+{
+    this->stop_worker_thread();
+
+    return;
+}
+
+void vcs_event_queue_c::push(const std::function<void(void)> &call)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        if (this->maxNumPending &&
+            (this->pendingCalls.size() >= this->maxNumPending))
+        {
+            this->numDroppedCalls++;
+            return;
+        }
+
+        this->pendingCalls.push_back(call);
+    }
+
+    this->newCallAvailable.notify_one();
+
+    return;
+}
+
+void vcs_event_queue_c::process(void)
+{
+    std::deque<std::function<void(void)>> calls;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        calls.swap(this->pendingCalls);
+    }
+
+    // Calls are made without holding the lock, so they're free to push further
+    // calls into the queue; those will be made on the next pass.
+    for (const auto &call: calls)
+    {
+        call();
+    }
+
+    return;
+}
+
+void vcs_event_queue_c::start_worker_thread(void)
 {
-    this->subscribedHandlers.push_back(handlerFn);
+    if (this->workerThread.joinable())
+    {
+        return;
+    }
+
+    this->stopRequested = false;
+    this->workerThread = std::thread(&vcs_event_queue_c::worker_thread_function, this);
 
     return;
 }
 
-void vcs_event_c::fire(void) const
+void vcs_event_queue_c::stop_worker_thread(void)
 {
-    for (const auto &handlerFn: this->subscribedHandlers)
+    if (!this->workerThread.joinable())
     {
-        handlerFn();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopRequested = true;
+    }
+
+    this->newCallAvailable.notify_all();
+    this->workerThread.join();
+
+    return;
+}
+
+unsigned vcs_event_queue_c::num_dropped_calls(void) const
+{
+    return this->numDroppedCalls;
+}
+
+void vcs_event_queue_c::worker_thread_function(void)
+{
+    ktelemetry_set_thread_name(this->name);
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+
+            this->newCallAvailable.wait(lock, [this]{ return (this->stopRequested || !this->pendingCalls.empty()); });
+
+            if (this->stopRequested &&
+                this->pendingCalls.empty())
+            {
+                break;
+            }
+        }
+
+        this->process();
     }
 
     return;
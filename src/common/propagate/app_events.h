@@ -10,28 +10,128 @@
  * function to that event; e.g. "ke_events().capture.newFrame->subscribe([]{...})".
  * The callback function will then be notified whenever that event occurs.
  *
+ * Events can carry a payload - e.g. the scaler's newFrame event carries the frame -
+ * which is passed to the callback as arguments:
+ *
+ *   ke_events().scaler.newFrameResolution->subscribe([](const resolution_s &r){...});
+ *
+ * By default, a callback is called synchronously, on the thread that fires the
+ * event. Alternatively, a callback can be subscribed with an event queue, in which
+ * case firing the event only places the call (with a copy of the payload) into the
+ * queue, and the call is made later by the thread that processes the queue - e.g.
+ * the main thread, via ke_main_thread_event_queue(), or the queue's own worker
+ * thread:
+ *
+ *   ke_events().capture.signalLost->subscribe([]{...}, ke_main_thread_event_queue());
+ *
  */
 
 #ifndef EVENT_H
 #define EVENT_H
 
+#include <condition_variable>
 #include <functional>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <memory>
+#include <deque>
+#include <mutex>
 #include <list>
 
-typedef std::function<void(void)> vcs_event_handler_fn_t;
+struct scaled_frame_s;
+struct resolution_s;
+
+// A queue of event callback calls waiting to be made by a particular thread.
+// Calls can be pushed from any thread.
+class vcs_event_queue_c
+{
+public:
+    // If maxNumPending is non-zero, calls pushed while the queue already holds
+    // that many are dropped rather than left to pile up behind a slow thread.
+    vcs_event_queue_c(const std::string &name, const unsigned maxNumPending = 0);
+
+    ~vcs_event_queue_c(void);
+
+    void push(const std::function<void(void)> &call);
+
+    // Makes the calls currently in the queue, in the order they were pushed. To
+    // be called by the thread that owns the queue.
+    void process(void);
+
+    // Starts a thread of its own for the queue, which waits for calls to be
+    // pushed and makes them as they arrive.
+    void start_worker_thread(void);
+
+    // Stops the queue's worker thread, if any, once it's made the calls currently
+    // in the queue.
+    void stop_worker_thread(void);
+
+    // The number of calls dropped because the queue was full.
+    unsigned num_dropped_calls(void) const;
+
+private:
+    void worker_thread_function(void);
+
+    const std::string name;
+    const unsigned maxNumPending;
 
+    std::deque<std::function<void(void)>> pendingCalls;
+    std::mutex mutex;
+    std::condition_variable newCallAvailable;
+
+    std::thread workerThread;
+    bool stopRequested = false;
+
+    std::atomic<unsigned> numDroppedCalls{0};
+};
+
+// An event whose callbacks receive a payload of the given types.
+template <typename ...PayloadTypes>
 class vcs_event_c
 {
 public:
-    // Ask the given handler function to be called when this event fires.
-    void subscribe(vcs_event_handler_fn_t handlerFn);
+    typedef std::function<void(const PayloadTypes&...)> handler_fn_t;
+
+    // Ask the given handler function to be called, on the thread that fires the
+    // event, when this event fires. Subscriptions are expected to be made during
+    // VCS's initialization, before events are fired from other threads.
+    void subscribe(const handler_fn_t &handlerFn)
+    {
+        this->subscribedHandlers.push_back(handlerFn);
+
+        return;
+    }
+
+    // Ask the given handler function to be called via the given queue when this
+    // event fires.
+    void subscribe(const handler_fn_t &handlerFn, vcs_event_queue_c &queue)
+    {
+        vcs_event_queue_c *const q = &queue;
+
+        this->subscribedHandlers.push_back([handlerFn, q](const PayloadTypes&... payload)
+        {
+            q->push([handlerFn, payload...]{ handlerFn(payload...); });
+        });
+
+        return;
+    }
+
+    // Fire the event, causing all subscribed handler functions to be called - or,
+    // for those subscribed with a queue, queued - immediately, in the order of
+    // their subscription.
+    void fire(const PayloadTypes&... payload) const
+    {
+        for (const auto &handlerFn: this->subscribedHandlers)
+        {
+            handlerFn(payload...);
+        }
 
-    // Fire the event, causing all subscribed handler functions to be called
-    // immediately, in the order of their subscription.
-    void fire(void) const;
+        return;
+    }
 
 private:
-    std::list<vcs_event_handler_fn_t> subscribedHandlers;
+    std::list<handler_fn_t> subscribedHandlers;
 };
 
 // The selection of events recognized by VCS.
@@ -43,55 +143,65 @@ public:
     {
         // VCS has received a new frame from the capture API. (The frame's data is
         // available from kc_capture_api().get_frame_buffer().)
-        vcs_event_c *const newFrame = new vcs_event_c;
+        vcs_event_c<> *const newFrame = new vcs_event_c<>;
 
         // The capture device has received a new video mode. We treat it as a proposal,
         // since we might e.g. not want this video mode to be used, and in that case
         // would tell the capture device to use some other mode.
-        vcs_event_c *const newProposedVideoMode = new vcs_event_c;
+        vcs_event_c<> *const newProposedVideoMode = new vcs_event_c<>;
 
         // The capture device has received a new video mode that we've approved of
         // (cf. newProposedVideoMode).
-        vcs_event_c *const newVideoMode = new vcs_event_c;
+        vcs_event_c<> *const newVideoMode = new vcs_event_c<>;
 
         // The active input channel index has changed.
-        vcs_event_c *const newInputChannel = new vcs_event_c;
+        vcs_event_c<> *const newInputChannel = new vcs_event_c<>;
+
+        vcs_event_c<> *const signalLost = new vcs_event_c<>;
+        vcs_event_c<> *const signalGained = new vcs_event_c<>;
+        vcs_event_c<> *const invalidSignal = new vcs_event_c<>;
+        vcs_event_c<> *const unrecoverableError = new vcs_event_c<>;
 
-        vcs_event_c *const signalLost = new vcs_event_c;
-        vcs_event_c *const signalGained = new vcs_event_c;
-        vcs_event_c *const invalidSignal = new vcs_event_c;
-        vcs_event_c *const unrecoverableError = new vcs_event_c;
+        // The capture source has no more frames to give; e.g. the end of a video
+        // file being processed in batch has been reached.
+        vcs_event_c<> *const endOfInput = new vcs_event_c<>;
     } capture;
 
     // Events related to video recording.
     struct
     {
-        vcs_event_c *const recordingStarted = new vcs_event_c;
-        vcs_event_c *const recordingEnded = new vcs_event_c;
+        vcs_event_c<> *const recordingStarted = new vcs_event_c<>;
+        vcs_event_c<> *const recordingEnded = new vcs_event_c<>;
     } recorder;
 
     // Events related to file IO.
     struct
     {
-        vcs_event_c *const savedVideoPresets = new vcs_event_c;
-        vcs_event_c *const savedFilterGraph = new vcs_event_c;
-        vcs_event_c *const savedAliases = new vcs_event_c;
-        vcs_event_c *const loadedVideoPresets = new vcs_event_c;
-        vcs_event_c *const loadedFilterGraph = new vcs_event_c;
-        vcs_event_c *const loadedAliases = new vcs_event_c;
+        vcs_event_c<> *const savedVideoPresets = new vcs_event_c<>;
+        vcs_event_c<> *const savedFilterGraph = new vcs_event_c<>;
+        vcs_event_c<> *const savedAliases = new vcs_event_c<>;
+        vcs_event_c<> *const loadedVideoPresets = new vcs_event_c<>;
+        vcs_event_c<> *const loadedFilterGraph = new vcs_event_c<>;
+        vcs_event_c<> *const loadedAliases = new vcs_event_c<>;
     } file;
 
     // Events related to the GUI.
     struct
     {
         // Marks the output window as dirty, i.e. in need of redrawing.
-        vcs_event_c *const dirty = new vcs_event_c;
+        vcs_event_c<> *const dirty = new vcs_event_c<>;
     } display;
 
+    // Events related to scaling.
     struct
     {
-        vcs_event_c *const newFrameResolution = new vcs_event_c;
-        vcs_event_c *const newFrame = new vcs_event_c;
+        // The scaler's output frames have changed resolution. Carries the new
+        // resolution.
+        vcs_event_c<resolution_s> *const newFrameResolution = new vcs_event_c<resolution_s>;
+
+        // The scaler has output a new frame. Carries the frame; subscribers may
+        // hold on to it for as long as they need.
+        vcs_event_c<std::shared_ptr<const scaled_frame_s>> *const newFrame = new vcs_event_c<std::shared_ptr<const scaled_frame_s>>;
     } scaler;
 
 private:
@@ -99,4 +209,8 @@ private:
 
 vcs_event_pool_c& ke_events(void);
 
+// Calls queued here are made by the main thread once per iteration of VCS's main
+// loop.
+vcs_event_queue_c& ke_main_thread_event_queue(void);
+
 #endif
@@ -0,0 +1,137 @@
+/*
+ * 2020 Tarpeeksi Hyvae Soft
+ *
+ * Software: VCS
+ *
+ * A bounded single-producer, single-consumer queue. Items are passed between the
+ * two threads without locking; a mutex is used only to let the consumer sleep
+ * while the queue is empty.
+ *
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <mutex>
+
+template <typename T>
+class spsc_queue_c
+{
+public:
+    // The ring has one slot more than the queue's capacity, so that a full queue
+    // can be told apart from an empty one.
+    spsc_queue_c(const unsigned capacity) :
+        slots(capacity + 1)
+    {
+        return;
+    }
+
+    // Appends the given item into the queue. Returns false, without appending, if
+    // the queue is full. To be called by the producer thread only.
+    bool push(const T &item)
+    {
+        const unsigned tailIdx = this->tail.load(std::memory_order_relaxed);
+        const unsigned nextTailIdx = ((tailIdx + 1) % this->slots.size());
+
+        if (nextTailIdx == this->head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        this->slots[tailIdx] = item;
+        this->tail.store(nextTailIdx, std::memory_order_release);
+
+        // Taking the lock, however briefly, ensures that a consumer that found
+        // the queue empty is either already waiting for the notification or
+        // has yet to check the queue again.
+        {
+            std::lock_guard<std::mutex> lock(this->waitMutex);
+        }
+        this->itemAvailable.notify_one();
+
+        return true;
+    }
+
+    // Moves the item at the front of the queue into the given reference. Returns
+    // false if the queue is empty. To be called by the consumer thread only.
+    bool pop(T &item)
+    {
+        const unsigned headIdx = this->head.load(std::memory_order_relaxed);
+
+        if (headIdx == this->tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        item = this->slots[headIdx];
+        this->slots[headIdx] = T();
+        this->head.store(((headIdx + 1) % this->slots.size()), std::memory_order_release);
+
+        return true;
+    }
+
+    // Like pop(), but waits for an item if the queue is empty. Returns false,
+    // without an item, if the wait is interrupted; cf. interrupt().
+    bool wait_pop(T &item)
+    {
+        while (!this->pop(item))
+        {
+            std::unique_lock<std::mutex> lock(this->waitMutex);
+
+            this->itemAvailable.wait(lock, [this]{ return (this->isInterrupted || this->size()); });
+
+            if (this->isInterrupted)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Wakes the consumer from wait_pop(), and makes any further calls to it
+    // return false right away.
+    void interrupt(void)
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->waitMutex);
+            this->isInterrupted = true;
+        }
+        this->itemAvailable.notify_all();
+
+        return;
+    }
+
+    // The number of items in the queue. Can be called from any thread, though
+    // the value may be out of date by the time it's returned.
+    unsigned size(void) const
+    {
+        const unsigned headIdx = this->head.load(std::memory_order_acquire);
+        const unsigned tailIdx = this->tail.load(std::memory_order_acquire);
+
+        return ((tailIdx + this->slots.size() - headIdx) % this->slots.size());
+    }
+
+    unsigned capacity(void) const
+    {
+        return (this->slots.size() - 1);
+    }
+
+private:
+    std::vector<T> slots;
+
+    // The index of the slot holding the item at the front of the queue, and of
+    // the slot into which the next item will go. Written only by the consumer
+    // and the producer, respectively.
+    std::atomic<unsigned> head{0};
+    std::atomic<unsigned> tail{0};
+
+    std::mutex waitMutex;
+    std::condition_variable itemAvailable;
+    bool isInterrupted = false;
+};
+
+#endif
@@ -0,0 +1,619 @@
+/*
+ * 2020 Tarpeeksi Hyvae Soft
+ *
+ * Software: VCS
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include "common/telemetry/telemetry.h"
+#include "common/memory/memory.h"
+#include "common/globals.h"
+
+// Durations are binned into a log-linear histogram: each power of two is split
+// into NUM_SUB_BUCKETS equal-width buckets, so that a bucket's width is at most
+// 1/NUM_SUB_BUCKETS of the values it holds. Durations below NUM_SUB_BUCKETS ns
+// get a bucket each.
+static const unsigned NUM_SUB_BUCKETS = 8;
+
+// The largest power of two (relative to NUM_SUB_BUCKETS) that the histogram
+// covers; longer durations go into the last bucket. 38 covers up to roughly an
+// hour.
+static const unsigned MAX_BUCKET_SHIFT = 38;
+
+static const unsigned NUM_BUCKETS = ((MAX_BUCKET_SHIFT + 2) * NUM_SUB_BUCKETS);
+
+struct telemetry_stage_s
+{
+    std::string name;
+
+    // The durations of the stage's executions in the current telemetry window.
+    std::atomic<u32> buckets[NUM_BUCKETS];
+    std::atomic<u64> totalNs;
+    std::atomic<i64> maxNs;
+};
+
+// The registered stages, in the order of their registration. Stages are never
+// removed, so their handles remain valid for the lifetime of the program.
+static std::deque<telemetry_stage_s> STAGES;
+static std::mutex STAGES_MUTEX;
+
+// The stats of each stage over the most recent telemetry window.
+static std::vector<telemetry_stage_stats_s> LATEST_STATS;
+static std::mutex LATEST_STATS_MUTEX;
+
+// How long, in milliseconds, a telemetry window lasts.
+static const unsigned WINDOW_LENGTH_MS = 1000;
+
+static std::atomic<bool> TELEMETRY_ENABLED{true};
+
+static const auto START_TIME = std::chrono::steady_clock::now();
+static std::chrono::steady_clock::time_point WINDOW_START_TIME = START_TIME;
+
+// The file, if any, into which the stats of each window are written.
+static FILE *DUMP_FILE = nullptr;
+static bool IS_DUMP_FILE_JSON = false;
+
+// A timed execution of a stage, for tracing.
+struct trace_event_s
+{
+    const telemetry_stage_s *stage;
+
+    // The thread that the stage was executed on; cf. TRACE_THREAD_ID.
+    unsigned threadId;
+
+    // Relative to START_TIME.
+    i64 startNs;
+    i64 durationNs;
+};
+
+static std::atomic<bool> TRACING_ENABLED{false};
+
+// Trace events recorded since they were last written into the trace file.
+static std::vector<trace_event_s> PENDING_TRACE_EVENTS;
+static std::mutex PENDING_TRACE_EVENTS_MUTEX;
+
+// The names given to threads (by their trace thread id), in the order given.
+// Only to be accessed while holding PENDING_TRACE_EVENTS_MUTEX.
+static std::vector<std::pair<unsigned, std::string>> THREAD_NAMES;
+
+// Should the main thread stall for long enough that this many trace events pile
+// up, further ones will be dropped rather than left to consume memory.
+static const unsigned MAX_NUM_PENDING_TRACE_EVENTS = 100000;
+static unsigned NUM_DROPPED_TRACE_EVENTS = 0;
+
+// The file into which trace events are written. Only to be accessed while holding
+// TRACE_FILE_MUTEX.
+static FILE *TRACE_FILE = nullptr;
+static bool IS_TRACE_FILE_EMPTY = true;
+static unsigned NUM_THREAD_NAMES_IN_TRACE_FILE = 0;
+static std::mutex TRACE_FILE_MUTEX;
+
+// Identifies threads in trace events. Assigned on a thread's first trace event.
+static thread_local unsigned TRACE_THREAD_ID = 0;
+static std::atomic<unsigned> NEXT_TRACE_THREAD_ID{1};
+
+static unsigned trace_thread_id(void)
+{
+    if (!TRACE_THREAD_ID)
+    {
+        TRACE_THREAD_ID = NEXT_TRACE_THREAD_ID++;
+    }
+
+    return TRACE_THREAD_ID;
+}
+
+static unsigned bucket_index(const i64 durationNs)
+{
+    if (durationNs < NUM_SUB_BUCKETS)
+    {
+        return std::max(i64(0), durationNs);
+    }
+
+    // Find the power of two the duration falls under, and its position within it.
+    u64 value = durationNs;
+    unsigned shift = 0;
+    while (value >= (NUM_SUB_BUCKETS * 2))
+    {
+        value >>= 1;
+        shift++;
+    }
+
+    return std::min((NUM_BUCKETS - 1), unsigned(((shift + 1) * NUM_SUB_BUCKETS) + (value - NUM_SUB_BUCKETS)));
+}
+
+// Returns the duration in the middle of the range covered by the given bucket.
+static i64 bucket_value(const unsigned idx)
+{
+    if (idx < NUM_SUB_BUCKETS)
+    {
+        return idx;
+    }
+
+    const unsigned shift = ((idx / NUM_SUB_BUCKETS) - 1);
+    const i64 lowerBound = (i64(NUM_SUB_BUCKETS + (idx % NUM_SUB_BUCKETS)) << shift);
+
+    return (lowerBound + ((i64(1) << shift) / 2));
+}
+
+// Resets the given stage's histogram, returning a summary of what it held.
+static telemetry_stage_stats_s take_stage_stats(telemetry_stage_s &stage)
+{
+    telemetry_stage_stats_s stats;
+    stats.stageName = stage.name;
+
+    u32 buckets[NUM_BUCKETS];
+    for (unsigned i = 0; i < NUM_BUCKETS; i++)
+    {
+        buckets[i] = stage.buckets[i].exchange(0, std::memory_order_relaxed);
+        stats.numSamples += buckets[i];
+    }
+
+    const u64 totalNs = stage.totalNs.exchange(0, std::memory_order_relaxed);
+    stats.maxNs = stage.maxNs.exchange(0, std::memory_order_relaxed);
+
+    if (!stats.numSamples)
+    {
+        return stats;
+    }
+
+    stats.meanNs = (totalNs / stats.numSamples);
+
+    const auto percentile = [&](const double fraction)->i64
+    {
+        const u64 targetCount = std::max(u64(1), u64(fraction * stats.numSamples + 0.5));
+
+        u64 count = 0;
+        for (unsigned i = 0; i < NUM_BUCKETS; i++)
+        {
+            count += buckets[i];
+
+            if (count >= targetCount)
+            {
+                // The bucket's midpoint may overshoot the largest actual sample.
+                return std::min(stats.maxNs, bucket_value(i));
+            }
+        }
+
+        return stats.maxNs;
+    };
+
+    stats.p50Ns = percentile(0.50);
+    stats.p95Ns = percentile(0.95);
+    stats.p99Ns = percentile(0.99);
+
+    return stats;
+}
+
+// Stage names are VCS's own, but filter names etc. could conceivably contain
+// characters that need escaping.
+static std::string json_escaped(const std::string &string)
+{
+    std::string escaped;
+
+    for (const char c: string)
+    {
+        if ((c == '"') || (c == '\\')) escaped += '\\';
+        escaped += c;
+    }
+
+    return escaped;
+}
+
+// Appends the given string, which is expected to be a JSON object, into the trace
+// file's array of trace events. Expects TRACE_FILE_MUTEX to be held.
+static void write_trace_event(const char *const eventString)
+{
+    fprintf(TRACE_FILE, "%s%s", (IS_TRACE_FILE_EMPTY? "[\n" : ",\n"), eventString);
+    IS_TRACE_FILE_EMPTY = false;
+
+    return;
+}
+
+// Writes into the trace file the trace events recorded since the previous call.
+static void write_pending_trace_events(void)
+{
+    std::vector<trace_event_s> events;
+    std::vector<std::pair<unsigned, std::string>> threadNames;
+    unsigned numDroppedEvents = 0;
+    {
+        std::lock_guard<std::mutex> lock(PENDING_TRACE_EVENTS_MUTEX);
+
+        events.swap(PENDING_TRACE_EVENTS);
+        threadNames = THREAD_NAMES;
+        std::swap(numDroppedEvents, NUM_DROPPED_TRACE_EVENTS);
+    }
+
+    std::lock_guard<std::mutex> lock(TRACE_FILE_MUTEX);
+
+    if (!TRACE_FILE)
+    {
+        return;
+    }
+
+    // Only the names given since the previous write.
+    threadNames.erase(threadNames.begin(), (threadNames.begin() + NUM_THREAD_NAMES_IN_TRACE_FILE));
+    NUM_THREAD_NAMES_IN_TRACE_FILE += threadNames.size();
+
+    char eventString[512];
+
+    for (const auto &threadName: threadNames)
+    {
+        snprintf(eventString, NUM_ELEMENTS(eventString),
+                 "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\"}}",
+                 threadName.first, json_escaped(threadName.second).c_str());
+
+        write_trace_event(eventString);
+    }
+
+    // Chrome's "complete" events, i.e. a begin and an end event in one.
+    for (const auto &event: events)
+    {
+        snprintf(eventString, NUM_ELEMENTS(eventString),
+                 "{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+                 json_escaped(event.stage->name).c_str(), event.threadId,
+                 (event.startNs / 1000.0), (event.durationNs / 1000.0));
+
+        write_trace_event(eventString);
+    }
+
+    if (numDroppedEvents)
+    {
+        NBENE(("Dropped %u trace events.", numDroppedEvents));
+    }
+
+    fflush(TRACE_FILE);
+
+    return;
+}
+
+// Records the given memory usage into the trace file as counter events, which
+// trace viewers plot as graphs over time.
+static void write_memory_trace_counters(const memory_usage_s &memoryUsage,
+                                        const i64 timestampNs)
+{
+    std::lock_guard<std::mutex> lock(TRACE_FILE_MUTEX);
+
+    if (!TRACE_FILE)
+    {
+        return;
+    }
+
+    char eventString[512];
+
+    snprintf(eventString, NUM_ELEMENTS(eventString),
+             "{\"name\": \"Memory (MB)\", \"ph\": \"C\", \"pid\": 1, \"ts\": %.3f, "
+             "\"args\": {\"in use\": %.2f, \"pooled\": %.2f}}",
+             (timestampNs / 1000.0),
+             (memoryUsage.numBytesInUse / (1024.0 * 1024.0)),
+             (memoryUsage.numBytesPooled / (1024.0 * 1024.0)));
+
+    write_trace_event(eventString);
+
+    return;
+}
+
+static void write_stats_to_dump_file(const std::vector<telemetry_stage_stats_s> &stats,
+                                     const memory_usage_s &memoryUsage,
+                                     const double timestamp)
+{
+    if (!DUMP_FILE)
+    {
+        return;
+    }
+
+    if (IS_DUMP_FILE_JSON)
+    {
+        fprintf(DUMP_FILE, "{\"time\": %.3f, \"memory\": {\"in_use_bytes\": %llu, \"peak_bytes\": %llu, "
+                           "\"from_system_bytes\": %llu, \"pooled_bytes\": %llu, \"fragmentation\": %.3f, "
+                           "\"reuse_rate\": %.3f, \"reasons\": [",
+                timestamp,
+                (unsigned long long)memoryUsage.numBytesInUse,
+                (unsigned long long)memoryUsage.peakNumBytesInUse,
+                (unsigned long long)memoryUsage.numBytesFromSystem,
+                (unsigned long long)memoryUsage.numBytesPooled,
+                memoryUsage.fragmentation,
+                memoryUsage.reuseRate);
+
+        for (unsigned i = 0; i < memoryUsage.reasons.size(); i++)
+        {
+            fprintf(DUMP_FILE, "%s{\"reason\": \"%s\", \"bytes\": %llu, \"peak_bytes\": %llu, \"allocations\": %llu}",
+                    (i? ", " : ""),
+                    json_escaped(memoryUsage.reasons[i].reason).c_str(),
+                    (unsigned long long)memoryUsage.reasons[i].numBytes,
+                    (unsigned long long)memoryUsage.reasons[i].peakNumBytes,
+                    (unsigned long long)memoryUsage.reasons[i].numAllocations);
+        }
+
+        fprintf(DUMP_FILE, "]}, \"stages\": [");
+
+        for (unsigned i = 0; i < stats.size(); i++)
+        {
+            fprintf(DUMP_FILE, "%s{\"name\": \"%s\", \"samples\": %llu, \"mean_us\": %.1f, "
+                               "\"p50_us\": %.1f, \"p95_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f}",
+                    (i? ", " : ""),
+                    json_escaped(stats[i].stageName).c_str(),
+                    (unsigned long long)stats[i].numSamples,
+                    (stats[i].meanNs / 1000.0),
+                    (stats[i].p50Ns / 1000.0),
+                    (stats[i].p95Ns / 1000.0),
+                    (stats[i].p99Ns / 1000.0),
+                    (stats[i].maxNs / 1000.0));
+        }
+
+        fprintf(DUMP_FILE, "]}\n");
+    }
+    else
+    {
+        // The memory columns are per window, so repeat across the window's rows.
+        for (const auto &stage: stats)
+        {
+            fprintf(DUMP_FILE, "%.3f,\"%s\",%llu,%.1f,%.1f,%.1f,%.1f,%.1f,%llu,%llu,%llu,%.3f,%.3f\n",
+                    timestamp,
+                    stage.stageName.c_str(),
+                    (unsigned long long)stage.numSamples,
+                    (stage.meanNs / 1000.0),
+                    (stage.p50Ns / 1000.0),
+                    (stage.p95Ns / 1000.0),
+                    (stage.p99Ns / 1000.0),
+                    (stage.maxNs / 1000.0),
+                    (unsigned long long)(memoryUsage.numBytesInUse / 1024),
+                    (unsigned long long)(memoryUsage.peakNumBytesInUse / 1024),
+                    (unsigned long long)(memoryUsage.numBytesPooled / 1024),
+                    memoryUsage.fragmentation,
+                    memoryUsage.reuseRate);
+        }
+    }
+
+    fflush(DUMP_FILE);
+
+    return;
+}
+
+telemetry_stage_s* ktelemetry_stage(const std::string &stageName)
+{
+    std::lock_guard<std::mutex> lock(STAGES_MUTEX);
+
+    for (auto &stage: STAGES)
+    {
+        if (stage.name == stageName)
+        {
+            return &stage;
+        }
+    }
+
+    STAGES.emplace_back();
+
+    telemetry_stage_s &newStage = STAGES.back();
+    newStage.name = stageName;
+    newStage.totalNs = 0;
+    newStage.maxNs = 0;
+    for (auto &bucket: newStage.buckets)
+    {
+        bucket = 0;
+    }
+
+    return &newStage;
+}
+
+void ktelemetry_add_sample(telemetry_stage_s *const stage,
+                           const std::chrono::steady_clock::time_point &startTime,
+                           const std::chrono::steady_clock::time_point &endTime)
+{
+    k_assert(stage, "Expected a non-null telemetry stage.");
+
+    const i64 durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count();
+
+    if (TRACING_ENABLED.load(std::memory_order_relaxed))
+    {
+        trace_event_s event;
+        event.stage = stage;
+        event.threadId = trace_thread_id();
+        event.startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(startTime - START_TIME).count();
+        event.durationNs = durationNs;
+
+        std::lock_guard<std::mutex> lock(PENDING_TRACE_EVENTS_MUTEX);
+
+        if (PENDING_TRACE_EVENTS.size() < MAX_NUM_PENDING_TRACE_EVENTS)
+        {
+            PENDING_TRACE_EVENTS.push_back(event);
+        }
+        else
+        {
+            NUM_DROPPED_TRACE_EVENTS++;
+        }
+    }
+
+    stage->buckets[bucket_index(durationNs)].fetch_add(1, std::memory_order_relaxed);
+    stage->totalNs.fetch_add(durationNs, std::memory_order_relaxed);
+
+    i64 maxNs = stage->maxNs.load(std::memory_order_relaxed);
+    while ((durationNs > maxNs) &&
+           !stage->maxNs.compare_exchange_weak(maxNs, durationNs, std::memory_order_relaxed))
+    {
+        ;
+    }
+
+    return;
+}
+
+telemetry_stage_stats_s ktelemetry_stage_stats(const std::string &stageName)
+{
+    std::lock_guard<std::mutex> lock(LATEST_STATS_MUTEX);
+
+    for (const auto &stats: LATEST_STATS)
+    {
+        if (stats.stageName == stageName)
+        {
+            return stats;
+        }
+    }
+
+    telemetry_stage_stats_s stats;
+    stats.stageName = stageName;
+
+    return stats;
+}
+
+std::vector<telemetry_stage_stats_s> ktelemetry_stage_stats(void)
+{
+    std::lock_guard<std::mutex> lock(LATEST_STATS_MUTEX);
+
+    return LATEST_STATS;
+}
+
+bool ktelemetry_set_dump_file(const std::string &filename)
+{
+    std::lock_guard<std::mutex> lock(STAGES_MUTEX);
+
+    if (DUMP_FILE)
+    {
+        fclose(DUMP_FILE);
+        DUMP_FILE = nullptr;
+    }
+
+    if (filename.empty())
+    {
+        return true;
+    }
+
+    DUMP_FILE = fopen(filename.c_str(), "w");
+    if (!DUMP_FILE)
+    {
+        return false;
+    }
+
+    const std::string jsonSuffix = ".json";
+    IS_DUMP_FILE_JSON = ((filename.length() >= jsonSuffix.length()) &&
+                         (filename.compare((filename.length() - jsonSuffix.length()), jsonSuffix.length(), jsonSuffix) == 0));
+
+    if (!IS_DUMP_FILE_JSON)
+    {
+        fprintf(DUMP_FILE, "time_s,stage,samples,mean_us,p50_us,p95_us,p99_us,max_us,"
+                           "mem_in_use_kb,mem_peak_kb,mem_pooled_kb,mem_fragmentation,mem_reuse_rate\n");
+    }
+
+    return true;
+}
+
+bool ktelemetry_set_trace_file(const std::string &filename)
+{
+    TRACING_ENABLED = false;
+
+    // Write out what's been recorded into the previous file, if any.
+    write_pending_trace_events();
+
+    std::lock_guard<std::mutex> lock(TRACE_FILE_MUTEX);
+
+    if (TRACE_FILE)
+    {
+        if (!IS_TRACE_FILE_EMPTY)
+        {
+            fprintf(TRACE_FILE, "\n]\n");
+        }
+
+        fclose(TRACE_FILE);
+        TRACE_FILE = nullptr;
+    }
+
+    if (filename.empty())
+    {
+        return true;
+    }
+
+    TRACE_FILE = fopen(filename.c_str(), "w");
+    if (!TRACE_FILE)
+    {
+        return false;
+    }
+
+    IS_TRACE_FILE_EMPTY = true;
+    NUM_THREAD_NAMES_IN_TRACE_FILE = 0;
+    TRACING_ENABLED = true;
+
+    return true;
+}
+
+void ktelemetry_set_thread_name(const std::string &threadName)
+{
+    // Since a pool thread may get reused for the same task, only note changes.
+    static thread_local std::string currentName;
+
+    if (threadName == currentName)
+    {
+        return;
+    }
+
+    currentName = threadName;
+
+    std::lock_guard<std::mutex> lock(PENDING_TRACE_EVENTS_MUTEX);
+    THREAD_NAMES.push_back({trace_thread_id(), threadName});
+
+    return;
+}
+
+void ktelemetry_set_enabled(const bool state)
+{
+    TELEMETRY_ENABLED = state;
+
+    return;
+}
+
+bool ktelemetry_is_enabled(void)
+{
+    return (TELEMETRY_ENABLED.load(std::memory_order_relaxed) ||
+            TRACING_ENABLED.load(std::memory_order_relaxed));
+}
+
+void ktelemetry_update(void)
+{
+    if (TRACING_ENABLED)
+    {
+        write_pending_trace_events();
+    }
+
+    const auto timeNow = std::chrono::steady_clock::now();
+
+    if ((timeNow - WINDOW_START_TIME) < std::chrono::milliseconds(WINDOW_LENGTH_MS))
+    {
+        return;
+    }
+
+    WINDOW_START_TIME = timeNow;
+
+    const memory_usage_s memoryUsage = kmem_memory_usage();
+
+    if (TRACING_ENABLED)
+    {
+        write_memory_trace_counters(memoryUsage, std::chrono::duration_cast<std::chrono::nanoseconds>(timeNow - START_TIME).count());
+    }
+
+    std::vector<telemetry_stage_stats_s> stats;
+    {
+        std::lock_guard<std::mutex> lock(STAGES_MUTEX);
+
+        for (auto &stage: STAGES)
+        {
+            stats.push_back(take_stage_stats(stage));
+        }
+
+        write_stats_to_dump_file(stats, memoryUsage, std::chrono::duration<double>(timeNow - START_TIME).count());
+    }
+
+    std::lock_guard<std::mutex> lock(LATEST_STATS_MUTEX);
+    LATEST_STATS = stats;
+
+    return;
+}
+
+void ktelemetry_release(void)
+{
+    ktelemetry_set_dump_file("");
+    ktelemetry_set_trace_file("");
+
+    return;
+}
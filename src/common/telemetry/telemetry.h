@@ -0,0 +1,153 @@
+/*
+ * 2020 Tarpeeksi Hyvae Soft
+ *
+ * Software: VCS
+ *
+ * Collects timings of the stages of VCS's frame pipeline - e.g. color conversion,
+ * filtering, scaling - for the purposes of performance monitoring.
+ *
+ * Each stage has a histogram into which the durations of its executions get
+ * binned. The histograms are summarized (into percentiles, etc.) and reset once
+ * per telemetry window, i.e. about once per second. The summaries are available
+ * to the rest of VCS via ktelemetry_stage_stats(), and can optionally also be
+ * written into a CSV or JSON file for offline analysis.
+ *
+ * Usage:
+ *
+ *   1. Time a scope as a particular stage:
+ *
+ *      {
+ *          TELEMETRY_TIME_SCOPE("Scaling");
+ *          ...
+ *      }
+ *
+ *   2. Once per iteration of the main loop, call ktelemetry_update().
+ *
+ *   3. Query the stats of the latest telemetry window:
+ *
+ *      const telemetry_stage_stats_s stats = ktelemetry_stage_stats("Scaling");
+ *
+ * Optionally, each timed execution of a stage can also be recorded as a trace
+ * event, with the thread it ran on, and written into a file in the Chrome trace
+ * event format - viewable in e.g. chrome://tracing or Perfetto - to show how the
+ * stages of successive frames line up in time across VCS's threads.
+ *
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include "common/types.h"
+
+// An opaque handle to a pipeline stage whose timings are being collected.
+struct telemetry_stage_s;
+
+// A summary of a stage's timings over a telemetry window.
+struct telemetry_stage_stats_s
+{
+    std::string stageName;
+
+    // How many times the stage was executed during the window.
+    u64 numSamples = 0;
+
+    // Durations, in nanoseconds. The percentiles are accurate to within about
+    // 1/8 of their value.
+    i64 meanNs = 0;
+    i64 p50Ns = 0;
+    i64 p95Ns = 0;
+    i64 p99Ns = 0;
+    i64 maxNs = 0;
+};
+
+// The name of the stage that covers the full processing of a captured frame,
+// from its scaling to its being handed to the display and recorder.
+#define TELEMETRY_STAGE_FRAME_PIPELINE "Frame pipeline"
+
+// Returns a handle to the stage of the given name, registering the stage if it
+// hasn't been already. Since this involves a lookup, callers on hot paths should
+// store the handle rather than calling this each time; see TELEMETRY_TIME_SCOPE().
+// Can be called from any thread.
+telemetry_stage_s* ktelemetry_stage(const std::string &stageName);
+
+// Adds to the given stage's histogram an execution that lasted between the given
+// times; and, if tracing, records it as a trace event on the calling thread. Can
+// be called from any thread. Doesn't block unless tracing.
+void ktelemetry_add_sample(telemetry_stage_s *const stage,
+                           const std::chrono::steady_clock::time_point &startTime,
+                           const std::chrono::steady_clock::time_point &endTime);
+
+// Returns the stats of the given stage over the most recent telemetry window.
+// If there's no such stage, or if it wasn't executed during the window, the
+// stats will have 0 samples.
+telemetry_stage_stats_s ktelemetry_stage_stats(const std::string &stageName);
+
+// Returns the stats of each stage, in the order of their registration, over the
+// most recent telemetry window.
+std::vector<telemetry_stage_stats_s> ktelemetry_stage_stats(void);
+
+// Asks for the stats of each telemetry window to also be written into the given
+// file, replacing its contents. A filename ending in ".json" gets one JSON object
+// per window per line; otherwise, CSV with one row per stage per window. An empty
+// filename stops any file output. Returns false if the file couldn't be opened.
+bool ktelemetry_set_dump_file(const std::string &filename);
+
+// Starts recording trace events into the given file, in Chrome's trace event
+// JSON format, replacing the file's contents. An empty filename stops tracing.
+// Returns false if the file couldn't be opened.
+bool ktelemetry_set_trace_file(const std::string &filename);
+
+// Gives the calling thread a name by which to identify it in trace events.
+void ktelemetry_set_thread_name(const std::string &threadName);
+
+void ktelemetry_set_enabled(const bool state);
+
+// Returns true if stages are being timed; i.e. if either telemetry or tracing
+// is enabled.
+bool ktelemetry_is_enabled(void);
+
+// Closes the current telemetry window if it's run its length, and writes out any
+// trace events recorded since the previous call. Expected to be called from the
+// main thread, e.g. once per iteration of the main loop.
+void ktelemetry_update(void);
+
+void ktelemetry_release(void);
+
+// Times its own lifetime as an execution of the given stage.
+class telemetry_timer_c
+{
+public:
+    telemetry_timer_c(telemetry_stage_s *const stage) :
+        stage(ktelemetry_is_enabled()? stage : nullptr),
+        startTime(this->stage? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point())
+    {
+        return;
+    }
+
+    ~telemetry_timer_c(void)
+    {
+        if (this->stage)
+        {
+            ktelemetry_add_sample(this->stage, this->startTime, std::chrono::steady_clock::now());
+        }
+
+        return;
+    }
+
+private:
+    telemetry_stage_s *const stage;
+    const std::chrono::steady_clock::time_point startTime;
+};
+
+#define TELEMETRY_CONCAT_(a, b) a##b
+#define TELEMETRY_CONCAT(a, b) TELEMETRY_CONCAT_(a, b)
+
+// Times the rest of the enclosing scope as an execution of the stage of the
+// given name. The stage's handle is looked up only on the first pass.
+#define TELEMETRY_TIME_SCOPE(stageName) \
+    static telemetry_stage_s *const TELEMETRY_CONCAT(telemetryStage_, __LINE__) = ktelemetry_stage(stageName);\
+    const telemetry_timer_c TELEMETRY_CONCAT(telemetryTimer_, __LINE__)(TELEMETRY_CONCAT(telemetryStage_, __LINE__))
+
+#endif
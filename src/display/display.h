@@ -44,7 +44,7 @@
 struct log_entry_s;
 struct mode_alias_s;
 class FilterGraphNode;
-enum class filter_type_enum_e;
+class filter_c;
 
 /*!
  * @brief
@@ -186,21 +186,22 @@ void kd_set_filter_graph_source_filename(const std::string &sourceFilename);
 void kd_set_filter_graph_options(const std::vector<filter_graph_option_s> &graphOptions);
 
 /*!
- * Tells the GUI to create and add into its filter graph a new node with the
- * given properties.
+ * Tells the GUI to create and add into its filter graph a new node for the
+ * given filter instance.
  * 
  * The GUI filter graph is expected to be a dialog of some sort - e.g. a visual
  * node graph - in which the user can create and modify filter chains.
  * 
- * @p initialParameterValues is an array of bytes that defines the parameters
- * of the node's filter instance (c.f. the @ref filter_c class of the filter
- * interface, @ref src/filter/filter.h). Assuming VCS's default GUI, you can
- * find which parameters are included in this array for each filter type by
- * inspecting @ref src/display/qt/widgets/filter_widgets.cpp.
+ * @p filter is an instance of @ref filter_c (c.f. the filter interface,
+ * @ref src/filter/filter.h) created via kf_create_new_filter_instance(). The
+ * node takes ownership of the instance, and is expected to delete it via
+ * kf_delete_filter_instance() when the node itself is deleted.
  * 
- * Returns a pointer to the created node; or @a nullptr if no node was created.
+ * Returns a pointer to the created node; or @a nullptr if no node was created,
+ * e.g. because the GUI has no filter graph; in which case the filter instance
+ * remains owned by the caller.
  */
-FilterGraphNode* kd_add_filter_graph_node(const filter_type_enum_e &filterType, const u8 *const initialParameterValues);
+FilterGraphNode* kd_add_filter_graph_node(const filter_c *const filter);
 
 /*!
  * Asks the GUI to repaint its output window (e.g. because there's a new output
@@ -214,10 +215,10 @@ FilterGraphNode* kd_add_filter_graph_node(const filter_type_enum_e &filterType,
  * (error-checking omitted):
  * 
  * @code
- * resolution_s r = ks_output_resolution();
- * u8 *pixels = ks_scaler_output_as_raw_ptr();
- * QImage frame = QImage(pixels, r.w, r.h, QImage::Format_RGB32);
- * QPainter(this).drawImage(0, 0, frame);
+ * const auto frame = ks_scaler_output_frame();
+ * const resolution_s &r = frame->resolution;
+ * QImage image = QImage(frame->pixels.ptr(), r.w, r.h, QImage::Format_RGB32);
+ * QPainter(this).drawImage(0, 0, image);
  * @endcode
  */
 void kd_redraw_output_window(void);
@@ -435,24 +436,4 @@ bool kd_is_fullscreen(void);
  */
 uint kd_output_framerate(void);
 
-/*!
- * Returns the average time, in milliseconds, elapsed between two consecutive
- * frames being painted onto the output window.
- * 
- * The average is assumed to be over a one-second period.
- * 
- * This value is used by VCS to estimate its overall capture performance.
- */
-int kd_average_pipeline_latency(void);
-
-/*!
- * Returns the peak time, in milliseconds, elapsed between two consecutive
- * frames being painted onto the output window.
- * 
- * The peak is assumed to be over a one-second period.
- * 
- * This value is used by VCS to estimate its overall capture performance.
- */
-int kd_peak_pipeline_latency(void);
-
 #endif
@@ -0,0 +1,254 @@
+/*
+ * 2020 Tarpeeksi Hyvae Soft
+ *
+ * Software: VCS
+ *
+ * Implements VCS's display interface for headless operation, i.e. without a
+ * GUI. Capture, anti-tearing, filtering, scaling and recording run as usual,
+ * but are controlled via the command line rather than via windows and dialogs;
+ * and the display interface's functions are for the most part no-ops.
+ *
+ * Compiled in place of the Qt display when building with CONFIG+=headless.
+ *
+ */
+
+#include <QElapsedTimer>
+#include <csignal>
+#include "common/command_line/command_line.h"
+#include "common/propagate/app_events.h"
+#include "capture/capture_api.h"
+#include "capture/capture.h"
+#include "display/display.h"
+#include "common/globals.h"
+#include "common/log/log.h"
+#include "capture/alias.h"
+#include "filter/filter.h"
+#include "record/record.h"
+#include "record/batch.h"
+#include "scaler/scaler.h"
+
+// Whether the display has been acquired.
+static bool IS_ACQUIRED = false;
+
+// The number of frames output (i.e. passed through the scaler) during the
+// previous full second.
+static uint OUTPUT_FRAMERATE = 0;
+
+// Used for measuring the output frame rate.
+static uint NUM_FRAMES_THIS_SECOND = 0;
+static QElapsedTimer FRAMERATE_TIMER;
+
+static void request_program_exit(int)
+{
+    PROGRAM_EXIT_REQUESTED = true;
+
+    return;
+}
+
+// Starts recording into the file given on the command line, if any. In batch
+// mode, the batch takes care of recording.
+static void start_requested_recording(void)
+{
+    if (kcom_record_file_name().empty() ||
+        kbatch_is_enabled() ||
+        krecord_is_recording() ||
+        kc_capture_api().has_no_signal() ||
+        kc_capture_api().has_invalid_signal())
+    {
+        return;
+    }
+
+    const resolution_s videoRes = (kcom_record_resolution().w? kcom_record_resolution() : ks_output_resolution());
+
+    if (!krecord_start_recording(kcom_record_file_name().c_str(),
+                                 videoRes.w, videoRes.h,
+                                 kcom_record_frame_rate()))
+    {
+        NBENE(("Failed to start recording into '%s'. Exiting.", kcom_record_file_name().c_str()));
+        PROGRAM_EXIT_REQUESTED = true;
+    }
+
+    return;
+}
+
+void kd_acquire_output_window(void)
+{
+    INFO(("Acquiring the headless display."));
+
+    // Let the user exit cleanly with e.g. Ctrl+C or a service manager's stop
+    // request, so that any ongoing recording gets finalized.
+    std::signal(SIGINT, request_program_exit);
+    std::signal(SIGTERM, request_program_exit);
+
+    FRAMERATE_TIMER.start();
+
+    ke_events().scaler.newFrame->subscribe([](const std::shared_ptr<const scaled_frame_s>&)
+    {
+        NUM_FRAMES_THIS_SECOND++;
+
+        // Recording begins once there's a frame to record.
+        if (!krecord_is_recording())
+        {
+            start_requested_recording();
+        }
+    });
+
+    // Note that while recording, the scaler keeps its output locked to the
+    // video's resolution, so the recording can carry on across video modes.
+    ke_events().capture.newVideoMode->subscribe([]
+    {
+        const resolution_s inRes = kc_capture_api().get_resolution();
+
+        INFO(("New video mode: %lu x %lu.", inRes.w, inRes.h));
+    });
+
+    ke_events().capture.signalLost->subscribe([]
+    {
+        INFO(("Lost the capture signal."));
+    });
+
+    ke_events().capture.invalidSignal->subscribe([]
+    {
+        INFO(("Received an invalid capture signal."));
+    });
+
+    IS_ACQUIRED = true;
+
+    return;
+}
+
+void kd_release_output_window(void)
+{
+    DEBUG(("Releasing the headless display."));
+
+    IS_ACQUIRED = false;
+
+    return;
+}
+
+void kd_spin_event_loop(void)
+{
+    k_assert(IS_ACQUIRED,
+             "Expected the display to have been acquired before accessing it for events processing. ");
+
+    if (FRAMERATE_TIMER.elapsed() >= 1000)
+    {
+        OUTPUT_FRAMERATE = NUM_FRAMES_THIS_SECOND;
+        NUM_FRAMES_THIS_SECOND = 0;
+        FRAMERATE_TIMER.restart();
+    }
+
+    return;
+}
+
+void kd_update_video_recording_metainfo(void)
+{
+    if (PROGRAM_EXIT_REQUESTED ||
+        !krecord_is_recording())
+    {
+        return;
+    }
+
+    const recording_stats_s stats = krecord_recording_stats();
+
+    INFO(("Recording: %u frames, %.2f FPS in, %.2f FPS encoded, %u pending, %u dropped, %u duplicated.",
+          krecord_num_frames_recorded(),
+          krecord_recording_framerate(),
+          stats.encodeFramerate,
+          stats.numPendingFrames,
+          stats.numDroppedFrames,
+          stats.numDuplicatedFrames));
+
+    return;
+}
+
+uint kd_output_framerate(void)
+{
+    return OUTPUT_FRAMERATE;
+}
+
+bool kd_is_fullscreen(void)
+{
+    return false;
+}
+
+bool kd_add_log_entry(const log_entry_s e)
+{
+    // Log entries are printed into the console by the logger itself.
+    (void)e;
+
+    return false;
+}
+
+FilterGraphNode* kd_add_filter_graph_node(const filter_c *const filter)
+{
+    // There's no graph to display the node in; the caller will build the
+    // filter chains without one.
+    (void)filter;
+
+    return nullptr;
+}
+
+void kd_show_headless_info_message(const char *const title,
+                                   const char *const msg)
+{
+    (void)title;
+
+    INFO(("%s", msg));
+
+    return;
+}
+
+void kd_show_headless_error_message(const char *const title,
+                                    const char *const msg)
+{
+    (void)title;
+
+    NBENE(("%s", msg));
+
+    return;
+}
+
+void kd_show_headless_assert_error_message(const char *const msg,
+                                           const char *const filename,
+                                           const uint lineNum)
+{
+    NBENE(("Assertion failure: %s %s %d", msg, filename, lineNum));
+
+    return;
+}
+
+// The rest of the display interface concerns GUI elements that don't exist in
+// headless mode.
+
+void kd_redraw_output_window(void) { return; }
+
+void kd_clear_filter_graph(void) { return; }
+
+void kd_refresh_filter_chains(void) { return; }
+
+void kd_recalculate_filter_graph_chains(void) { return; }
+
+void kd_disable_output_size_controls(const bool) { return; }
+
+void kd_set_filter_graph_source_filename(const std::string &) { return; }
+
+void kd_set_filter_graph_options(const std::vector<filter_graph_option_s> &) { return; }
+
+void kd_set_video_recording_is_active(const bool) { return; }
+
+void kd_update_output_window_title(void) { return; }
+
+void kd_update_output_window_size(void) { return; }
+
+void kd_update_video_mode_params(void) { return; }
+
+void kd_update_capture_signal_info(void) { return; }
+
+void kd_add_alias(const mode_alias_s) { return; }
+
+void kd_clear_aliases(void) { return; }
+
+void kd_set_capture_signal_reception_status(const bool) { return; }
+
+void kd_set_video_presets_filename(const std::string &) { return; }
@@ -29,9 +29,6 @@ namespace app_n
 // The window we'll display the program in. Also owns the various sub-dialogs, etc.
 static MainWindow *WINDOW = nullptr;
 
-extern int UPDATE_LATENCY_PEAK;
-extern int UPDATE_LATENCY_AVG;
-
 void kd_clear_filter_graph(void)
 {
     if (WINDOW != nullptr)
@@ -62,12 +59,11 @@ void kd_disable_output_size_controls(const bool areDisabled)
     return;
 }
 
-FilterGraphNode* kd_add_filter_graph_node(const filter_type_enum_e &filterType,
-                                          const u8 *const initialParameterValues)
+FilterGraphNode* kd_add_filter_graph_node(const filter_c *const filter)
 {
     if (WINDOW != nullptr)
     {
-        return WINDOW->add_filter_graph_node(filterType, initialParameterValues);
+        return WINDOW->add_filter_graph_node(filter);
     }
 
     return nullptr;
@@ -257,16 +253,6 @@ void kd_refresh_filter_chains(void)
     return;
 }
 
-int kd_peak_pipeline_latency(void)
-{
-    return UPDATE_LATENCY_PEAK;
-}
-
-int kd_average_pipeline_latency(void)
-{
-    return UPDATE_LATENCY_AVG;
-}
-
 bool kd_is_fullscreen(void)
 {
     k_assert(WINDOW != nullptr, "Tried to query the display before it had been initialized.");
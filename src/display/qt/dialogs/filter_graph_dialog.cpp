@@ -54,6 +54,21 @@ FilterGraphDialog::FilterGraphDialog(QWidget *parent) :
 
             filterGraphMenu->addAction(enable);
 
+            // When downscaling, apply the filters that allow it to the downscaled
+            // frame rather than the full-sized one.
+            kf_set_filter_reordering_enabled(kpers_value_of(INI_GROUP_OUTPUT, "filter_reordering", kf_is_filter_reordering_enabled()).toBool());
+
+            QAction *reorder = new QAction("Filter after downscaling", this->menubar);
+            reorder->setCheckable(true);
+            reorder->setChecked(kf_is_filter_reordering_enabled());
+
+            connect(reorder, &QAction::triggered, this, [=](const bool checked)
+            {
+                kf_set_filter_reordering_enabled(checked);
+            });
+
+            filterGraphMenu->addAction(reorder);
+
             filterGraphMenu->addSeparator();
             connect(filterGraphMenu->addAction("New"), &QAction::triggered, this, [=]{this->reset_graph();});
             filterGraphMenu->addSeparator();
@@ -166,6 +181,7 @@ FilterGraphDialog::~FilterGraphDialog()
     // Save persistent settings.
     {
         kpers_set_value(INI_GROUP_OUTPUT, "custom_filtering", this->isEnabled);
+        kpers_set_value(INI_GROUP_OUTPUT, "filter_reordering", kf_is_filter_reordering_enabled());
         kpers_set_value(INI_GROUP_GEOMETRY, "filter_graph", this->size());
     }
 
@@ -258,16 +274,24 @@ void FilterGraphDialog::save_filters(void)
 FilterGraphNode* FilterGraphDialog::add_filter_node(const filter_type_enum_e type,
                                                     const u8 *const initialParameterValues)
 {
-    const filter_c *const newFilter = kf_create_new_filter_instance(type, initialParameterValues);
-    const unsigned filterWidgetWidth = (newFilter->guiWidget->widget->width() + 20);
-    const unsigned filterWidgetHeight = (newFilter->guiWidget->widget->height() + 35);
-    const QString nodeTitle = QString("%1. %2").arg(this->numNodesAdded+1).arg(newFilter->guiWidget->title);
+    return this->add_filter_graph_node(kf_create_new_filter_instance(type, initialParameterValues));
+}
 
+// Adds into the node graph a new node for the given filter instance, which the
+// node takes ownership of. Returns a pointer to the new node.
+FilterGraphNode* FilterGraphDialog::add_filter_graph_node(const filter_c *const newFilter)
+{
     k_assert(newFilter, "Failed to add a new filter node.");
 
+    // The filter's widget is only created now that it's needed for display.
+    filter_widget_s *const filterWidget = newFilter->gui_widget();
+    const unsigned filterWidgetWidth = (filterWidget->widget->width() + 20);
+    const unsigned filterWidgetHeight = (filterWidget->widget->height() + 35);
+    const QString nodeTitle = QString("%1. %2").arg(this->numNodesAdded+1).arg(filterWidget->title);
+
     FilterGraphNode *newNode = nullptr;
 
-    switch (type)
+    switch (newFilter->metaData.type)
     {
         case filter_type_enum_e::input_gate: newNode = new InputGateNode(nodeTitle, filterWidgetWidth, filterWidgetHeight); break;
         case filter_type_enum_e::output_gate: newNode = new OutputGateNode(nodeTitle, filterWidgetWidth, filterWidgetHeight); break;
@@ -279,10 +303,10 @@ FilterGraphNode* FilterGraphDialog::add_filter_node(const filter_type_enum_e typ
     this->graphicsScene->addItem(newNode);
 
     QGraphicsProxyWidget* nodeWidgetProxy = new QGraphicsProxyWidget(newNode);
-    nodeWidgetProxy->setWidget(newFilter->guiWidget->widget);
+    nodeWidgetProxy->setWidget(filterWidget->widget);
     nodeWidgetProxy->widget()->move(10, 30);
 
-    if (type == filter_type_enum_e::input_gate)
+    if (newFilter->metaData.type == filter_type_enum_e::input_gate)
     {
         this->inputGateNodes.push_back(newNode);
     }
@@ -307,56 +331,54 @@ FilterGraphNode* FilterGraphDialog::add_filter_node(const filter_type_enum_e typ
     return newNode;
 }
 
-// Visit each node in the graph and while doing so, group together such chains of
-// filters that run from an input gate through one or more filters into an output
-// gate. The chains will then be submitted to the filter handler for use in applying
-// the filters to captured frames.
+// Describe the nodes of the graph and their connections to the filter handler, which
+// will then group together such chains of filters that run from an input gate through
+// one or more filters into an output gate, for use in applying the filters to captured
+// frames.
 void FilterGraphDialog::recalculate_filter_chains(void)
 {
-    kf_remove_all_filter_chains();
+    std::vector<FilterGraphNode*> nodes;
+    std::vector<filter_graph_node_s> graphNodes;
 
-    const std::function<void(FilterGraphNode *const, std::vector<const filter_c*>)> traverse_filter_node =
-          [&](FilterGraphNode *const node, std::vector<const filter_c*> accumulatedFilterChain)
+    // The input gates go first, in the order they were added, since that's the
+    // order in which the filter handler will add their chains.
+    nodes = this->inputGateNodes;
+
+    for (auto item: this->graphicsScene->items())
     {
-        k_assert((node && node->associatedFilter), "Trying to visit an invalid node.");
+        FilterGraphNode *const node = dynamic_cast<FilterGraphNode*>(item);
 
-        if (std::find(accumulatedFilterChain.begin(),
-                      accumulatedFilterChain.end(),
-                      node->associatedFilter) != accumulatedFilterChain.end())
+        if (node &&
+            (std::find(nodes.begin(), nodes.end(), node) == nodes.end()))
         {
-            kd_show_headless_error_message("VCS detected a potential infinite loop",
-                                           "One or more filter chains in the filter graph are connected in a loop "
-                                           "(a node's output connects back to its input).\n\nChains containing an "
-                                           "infinite loop will remain unusable until the loop is disconnected.");
-
-            return;
+            nodes.push_back(node);
         }
+    }
 
-        if (node->is_enabled())
-        {
-            accumulatedFilterChain.push_back(node->associatedFilter);
-        }
+    for (auto node: nodes)
+    {
+        k_assert(node->associatedFilter, "Found a filter graph node with no filter.");
 
-        if (node->associatedFilter->metaData.type == filter_type_enum_e::output_gate)
-        {
-            kf_add_filter_chain(accumulatedFilterChain);
-            return;
-        }
+        filter_graph_node_s graphNode = {node->associatedFilter, node->is_enabled(), {}};
 
         // NOTE: This assumes that each node in the graph only has one output edge.
-        for (auto outgoing: node->output_edge()->connectedTo)
+        if (node->output_edge())
         {
-            traverse_filter_node(dynamic_cast<FilterGraphNode*>(outgoing->parentNode), accumulatedFilterChain);
-        }
+            for (auto outgoing: node->output_edge()->connectedTo)
+            {
+                const auto target = std::find(nodes.begin(), nodes.end(), dynamic_cast<FilterGraphNode*>(outgoing->parentNode));
 
-        return;
-    };
+                k_assert((target != nodes.end()), "Found a connection to an unknown filter graph node.");
 
-    for (auto inputGate: this->inputGateNodes)
-    {
-        traverse_filter_node(inputGate, {});
+                graphNode.outputConnections.push_back(std::distance(nodes.begin(), target));
+            }
+        }
+
+        graphNodes.push_back(graphNode);
     }
 
+    kf_recalculate_filter_chains(graphNodes);
+
     return;
 }
 
@@ -429,9 +451,3 @@ bool FilterGraphDialog::is_filter_graph_enabled(void)
     return this->isEnabled;
 }
 
-
-FilterGraphNode* FilterGraphDialog::add_filter_graph_node(const filter_type_enum_e &filterType,
-                                                          const u8 *const initialParameterValues)
-{
-    return add_filter_node(filterType, initialParameterValues);
-}
@@ -24,7 +24,7 @@ public:
 
     void clear_filter_graph(void);
 
-    FilterGraphNode* add_filter_graph_node(const filter_type_enum_e &filterType, const u8 * const initialParameterValues);
+    FilterGraphNode* add_filter_graph_node(const filter_c *const filter);
 
     FilterGraphNode* add_filter_node(const filter_type_enum_e type, const u8 *const initialParameterValues = nullptr);
 
@@ -17,9 +17,14 @@
 #include "display/qt/dialogs/overlay_dialog.h"
 #include "display/qt/persistent_settings.h"
 #include "display/qt/utility.h"
+#include "common/telemetry/telemetry.h"
+#include "common/memory/memory.h"
 #include "display/display.h"
 #include "capture/capture_api.h"
 #include "capture/capture.h"
+#include "record/record.h"
+#include "scaler/quality_governor.h"
+#include "scaler/pipeline.h"
 #include "ui_overlay_dialog.h"
 
 OverlayDialog::OverlayDialog(QWidget *parent) :
@@ -118,9 +123,108 @@ OverlayDialog::OverlayDialog(QWidget *parent) :
                     this->insert_text_into_overlay_editor("$averageLatencyMs");
                 });
 
+                connect(outputMenu->addAction("Median latency (ms)"), &QAction::triggered, this, [=]
+                {
+                    this->insert_text_into_overlay_editor("$latencyP50Ms");
+                });
+
+                connect(outputMenu->addAction("95th percentile latency (ms)"), &QAction::triggered, this, [=]
+                {
+                    this->insert_text_into_overlay_editor("$latencyP95Ms");
+                });
+
+                connect(outputMenu->addAction("99th percentile latency (ms)"), &QAction::triggered, this, [=]
+                {
+                    this->insert_text_into_overlay_editor("$latencyP99Ms");
+                });
+
+                connect(outputMenu->addAction("Pipeline stage timings"), &QAction::triggered, this, [=]
+                {
+                    this->insert_text_into_overlay_editor("$stageTimings");
+                });
+
+                connect(outputMenu->addAction("Pipeline queues"), &QAction::triggered, this, [=]
+                {
+                    this->insert_text_into_overlay_editor("$pipelineQueues");
+                });
+
+                connect(outputMenu->addAction("Quality governor status"), &QAction::triggered, this, [=]
+                {
+                    this->insert_text_into_overlay_editor("$qualityGovernor");
+                });
+
                 variablesMenu->addMenu(outputMenu);
             }
 
+            // Memory usage.
+            {
+                QMenu *memoryMenu = new QMenu("Memory", this->menubar);
+
+                connect(memoryMenu->addAction("In use (MB)"), &QAction::triggered, this, [=]
+                {
+                    this->insert_text_into_overlay_editor("$memoryInUseMB");
+                });
+
+                connect(memoryMenu->addAction("Peak (MB)"), &QAction::triggered, this, [=]
+                {
+                    this->insert_text_into_overlay_editor("$memoryPeakMB");
+                });
+
+                connect(memoryMenu->addAction("Pooled (MB)"), &QAction::triggered, this, [=]
+                {
+                    this->insert_text_into_overlay_editor("$memoryPooledMB");
+                });
+
+                connect(memoryMenu->addAction("Fragmentation (%)"), &QAction::triggered, this, [=]
+                {
+                    this->insert_text_into_overlay_editor("$memoryFragmentation");
+                });
+
+                connect(memoryMenu->addAction("Reuse rate (%)"), &QAction::triggered, this, [=]
+                {
+                    this->insert_text_into_overlay_editor("$memoryReuseRate");
+                });
+
+                connect(memoryMenu->addAction("Usage by purpose"), &QAction::triggered, this, [=]
+                {
+                    this->insert_text_into_overlay_editor("$memoryByReason");
+                });
+
+                variablesMenu->addMenu(memoryMenu);
+            }
+
+            // Video recording.
+            {
+                QMenu *recordingMenu = new QMenu("Recording", this->menubar);
+
+                connect(recordingMenu->addAction("Encoder frame rate (FPS)"), &QAction::triggered, this, [=]
+                {
+                    this->insert_text_into_overlay_editor("$recordingEncoderFPS");
+                });
+
+                connect(recordingMenu->addAction("Pending frames"), &QAction::triggered, this, [=]
+                {
+                    this->insert_text_into_overlay_editor("$recordingPendingFrames");
+                });
+
+                connect(recordingMenu->addAction("Dropped frames"), &QAction::triggered, this, [=]
+                {
+                    this->insert_text_into_overlay_editor("$recordingDroppedFrames");
+                });
+
+                connect(recordingMenu->addAction("Duplicated frames"), &QAction::triggered, this, [=]
+                {
+                    this->insert_text_into_overlay_editor("$recordingDuplicatedFrames");
+                });
+
+                connect(recordingMenu->addAction("Disk write (MB/s)"), &QAction::triggered, this, [=]
+                {
+                    this->insert_text_into_overlay_editor("$recordingDiskMBps");
+                });
+
+                variablesMenu->addMenu(recordingMenu);
+            }
+
             variablesMenu->addSeparator();
 
             // System.
@@ -225,6 +329,9 @@ void OverlayDialog::set_overlay_max_width(const uint width)
 {
     overlayDocument.setTextWidth(width);
 
+    // Force the overlay to be re-rendered at the new width.
+    this->cachedOverlayString.clear();
+
     return;
 }
 
@@ -246,19 +353,70 @@ void OverlayDialog::set_overlay_enabled(const bool enabled)
     return;
 }
 
-// Renders the overlay into a QImage, and returns the image.
+// Renders the overlay into a QImage, and returns the image. The image is cropped
+// to the bounds of the overlay's visible content, and its offset() gives the
+// position in the output frame at which it should be drawn. Returns a null
+// image if the overlay has no visible content.
+//
+// Rendering the overlay's HTML is expensive, so the image is cached and only
+// re-rendered when the parsed overlay string changes - e.g. when the value of
+// one of its variables changes.
 QImage OverlayDialog::overlay_as_qimage(void)
 {
-    const resolution_s outputRes = ks_output_resolution();
+    const QString parsedString = parsed_overlay_string();
+
+    if (parsedString == this->cachedOverlayString)
+    {
+        return this->cachedOverlayImage;
+    }
+
+    this->cachedOverlayString = parsedString;
+    overlayDocument.setHtml(parsedString);
 
-    QImage image = QImage(outputRes.w, outputRes.h, QImage::Format_ARGB32_Premultiplied);
+    const QSize documentSize = overlayDocument.size().toSize();
+    if (documentSize.isEmpty())
+    {
+        this->cachedOverlayImage = QImage();
+        return this->cachedOverlayImage;
+    }
+
+    QImage image = QImage(documentSize, QImage::Format_ARGB32_Premultiplied);
     image.fill(QColor(0, 0, 0, 0));
 
-    QPainter painter(&image);
-    overlayDocument.setHtml(parsed_overlay_string());
-    overlayDocument.drawContents(&painter, image.rect());
+    {
+        QPainter painter(&image);
+        overlayDocument.drawContents(&painter, image.rect());
+    }
+
+    // Find the bounding box of the overlay's visible pixels. Since the overlay's
+    // text may be aligned to the right or center of the document, this tends to
+    // be considerably smaller than the document itself.
+    QRect bounds;
+    for (int y = 0; y < image.height(); y++)
+    {
+        const QRgb *const row = (const QRgb*)image.constScanLine(y);
+
+        int left = 0;
+        while ((left < image.width()) && !qAlpha(row[left])) left++;
+
+        if (left == image.width()) continue;
+
+        int right = (image.width() - 1);
+        while (!qAlpha(row[right])) right--;
+
+        bounds |= QRect(left, y, (right - left + 1), 1);
+    }
+
+    if (bounds.isEmpty())
+    {
+        this->cachedOverlayImage = QImage();
+        return this->cachedOverlayImage;
+    }
+
+    this->cachedOverlayImage = image.copy(bounds);
+    this->cachedOverlayImage.setOffset(bounds.topLeft());
 
-    return image;
+    return this->cachedOverlayImage;
 }
 
 // Appends the given bit of text into the overlay editor's text field at its
@@ -285,8 +443,89 @@ QString OverlayDialog::parsed_overlay_string(void)
     parsed.replace("$inputHz",          QString::number(kc_capture_api().get_refresh_rate().value<unsigned>()));
     parsed.replace("$outputFPS",        QString::number(kd_output_framerate()));
     parsed.replace("$areFramesDropped", ((kc_capture_api().get_missed_frames_count() > 0)? "Dropping frames" : ""));
-    parsed.replace("$peakLatencyMs",    QString::number(kd_peak_pipeline_latency()));
-    parsed.replace("$averageLatencyMs", QString::number(kd_average_pipeline_latency()));
+    if (parsed.contains("latency", Qt::CaseInsensitive))
+    {
+        const telemetry_stage_stats_s stats = ktelemetry_stage_stats(TELEMETRY_STAGE_FRAME_PIPELINE);
+
+        parsed.replace("$peakLatencyMs",    QString::number((stats.maxNs / 1000000.0), 'f', 2));
+        parsed.replace("$averageLatencyMs", QString::number((stats.meanNs / 1000000.0), 'f', 2));
+        parsed.replace("$latencyP50Ms",     QString::number((stats.p50Ns / 1000000.0), 'f', 2));
+        parsed.replace("$latencyP95Ms",     QString::number((stats.p95Ns / 1000000.0), 'f', 2));
+        parsed.replace("$latencyP99Ms",     QString::number((stats.p99Ns / 1000000.0), 'f', 2));
+    }
+    if (parsed.contains("$stageTimings"))
+    {
+        // One line per pipeline stage run during the latest telemetry window,
+        // with the stage's median, 95th, and 99th percentile timings in ms.
+        QString timings;
+        for (const auto &stats: ktelemetry_stage_stats())
+        {
+            if (!stats.numSamples) continue;
+
+            timings += QString("%1: %2 / %3 / %4<br>").arg(QString::fromStdString(stats.stageName))
+                                                      .arg((stats.p50Ns / 1000000.0), 0, 'f', 2)
+                                                      .arg((stats.p95Ns / 1000000.0), 0, 'f', 2)
+                                                      .arg((stats.p99Ns / 1000000.0), 0, 'f', 2);
+        }
+
+        parsed.replace("$stageTimings", timings);
+    }
+    if (parsed.contains("$pipelineQueues"))
+    {
+        // One line per stage of the threaded pipeline, with its queue's current
+        // and peak depth, and the number of frames dropped at the stage.
+        QString queues;
+        for (const auto &stats: kpipeline_stage_stats())
+        {
+            queues += QString("%1: %2 / %3 of %4, %5 dropped<br>").arg(QString::fromStdString(stats.stageName))
+                                                                  .arg(stats.queueDepth)
+                                                                  .arg(stats.peakQueueDepth)
+                                                                  .arg(stats.queueCapacity)
+                                                                  .arg(stats.numFramesDropped);
+        }
+
+        parsed.replace("$pipelineQueues", queues);
+    }
+    if (parsed.contains("$qualityGovernor"))
+    {
+        parsed.replace("$qualityGovernor", (kgovernor_is_enabled()? QString::fromStdString(kgovernor_status()) : "Off"));
+    }
+    if (parsed.contains("$memory"))
+    {
+        const memory_usage_s usage = kmem_memory_usage();
+
+        parsed.replace("$memoryInUseMB",       QString::number((usage.numBytesInUse / (1024.0 * 1024.0)), 'f', 1));
+        parsed.replace("$memoryPeakMB",        QString::number((usage.peakNumBytesInUse / (1024.0 * 1024.0)), 'f', 1));
+        parsed.replace("$memoryPooledMB",      QString::number((usage.numBytesPooled / (1024.0 * 1024.0)), 'f', 1));
+        parsed.replace("$memoryFragmentation", QString::number((usage.fragmentation * 100), 'f', 1));
+        parsed.replace("$memoryReuseRate",     QString::number((usage.reuseRate * 100), 'f', 1));
+
+        if (parsed.contains("$memoryByReason"))
+        {
+            // One line per allocation reason with memory in use, in MB.
+            QString reasons;
+            for (const auto &reason: usage.reasons)
+            {
+                if (!reason.numBytes) continue;
+
+                reasons += QString("%1: %2<br>").arg(QString::fromStdString(reason.reason).toHtmlEscaped())
+                                                .arg((reason.numBytes / (1024.0 * 1024.0)), 0, 'f', 2);
+            }
+
+            parsed.replace("$memoryByReason", reasons);
+        }
+    }
+    if (parsed.contains("$recording"))
+    {
+        const recording_stats_s stats = krecord_recording_stats();
+
+        parsed.replace("$recordingEncoderFPS",       QString::number(stats.encodeFramerate, 'f', 1));
+        parsed.replace("$recordingPendingFrames",    QString::number(stats.numPendingFrames));
+        parsed.replace("$recordingDroppedFrames",    QString::number(stats.numDroppedFrames));
+        parsed.replace("$recordingDuplicatedFrames", QString::number(stats.numDuplicatedFrames));
+        parsed.replace("$recordingDiskMBps",         QString::number((stats.diskThroughput / (1024*1024)), 'f', 2));
+    }
+
     parsed.replace("$systemTime",       QDateTime::currentDateTime().time().toString());
     parsed.replace("$systemDate",       QDateTime::currentDateTime().date().toString());
 
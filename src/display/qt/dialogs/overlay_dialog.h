@@ -9,6 +9,7 @@
 
 #include <QTextDocument>
 #include <QDialog>
+#include <QImage>
 
 class QMenu;
 class QMenuBar;
@@ -51,6 +52,12 @@ private:
     // Used to render the overlay's HTML into an image.
     QTextDocument overlayDocument;
 
+    // The most recently rendered overlay image, and the parsed overlay string
+    // it was rendered from. The overlay only needs to be re-rendered when its
+    // parsed string changes.
+    QImage cachedOverlayImage;
+    QString cachedOverlayString;
+
     QMenuBar *menubar = nullptr;
 };
 
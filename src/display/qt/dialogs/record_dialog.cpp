@@ -6,7 +6,9 @@
  *
  */
 
+#include <QInputDialog>
 #include <QFileDialog>
+#include <QDateTime>
 #include <QFileInfo>
 #include <QMenuBar>
 #include "display/qt/dialogs/record_dialog.h"
@@ -141,11 +143,116 @@ RecordDialog::RecordDialog(QDialog *parent) :
                 this->set_recording_enabled(!this->isEnabled);
             });
 
+            QAction *segmentLength = new QAction("Segment length...", this->menubar);
+
+            connect(segmentLength, &QAction::triggered, this, [=]
+            {
+                bool ok = false;
+                const uint minutes = QInputDialog::getInt(this, "VCS - Video Recorder",
+                                                          "Roll over into a new file every N minutes (0 = never):",
+                                                          this->segmentMinutes, 0, 10000, 1, &ok);
+
+                if (ok) this->segmentMinutes = minutes;
+            });
+
+            QAction *segmentSize = new QAction("Segment size...", this->menubar);
+
+            connect(segmentSize, &QAction::triggered, this, [=]
+            {
+                bool ok = false;
+                const uint megabytes = QInputDialog::getInt(this, "VCS - Video Recorder",
+                                                            "Roll over into a new file every N megabytes (0 = never):",
+                                                            this->segmentMegabytes, 0, 1000000, 100, &ok);
+
+                if (ok) this->segmentMegabytes = megabytes;
+            });
+
+            connect(this, &RecordDialog::recording_enabled, this, [=]
+            {
+                segmentLength->setEnabled(false);
+                segmentSize->setEnabled(false);
+            });
+
+            connect(this, &RecordDialog::recording_disabled, this, [=]
+            {
+                segmentLength->setEnabled(true);
+                segmentSize->setEnabled(true);
+            });
+
             recordMenu->addAction(enable);
+            recordMenu->addSeparator();
+            recordMenu->addAction(segmentLength);
+            recordMenu->addAction(segmentSize);
 
             this->menubar->addMenu(recordMenu);
         }
 
+        // Replay buffer...
+        {
+            QMenu *replayMenu = new QMenu("Replay buffer", this->menubar);
+
+            QAction *enable = new QAction("Enabled", this->menubar);
+            enable->setCheckable(true);
+            enable->setChecked(false);
+
+            QAction *save = new QAction("Save replay", this->menubar);
+            save->setEnabled(false);
+
+            connect(this, &RecordDialog::replay_buffer_enabled, this, [=]
+            {
+                enable->setChecked(true);
+                save->setEnabled(true);
+            });
+
+            connect(this, &RecordDialog::replay_buffer_disabled, this, [=]
+            {
+                enable->setChecked(false);
+                save->setEnabled(false);
+            });
+
+            connect(enable, &QAction::triggered, this, [=]
+            {
+                this->set_replay_buffer_enabled(!krecord_is_replay_buffer_active());
+            });
+
+            connect(save, &QAction::triggered, this, [=]
+            {
+                this->save_replay();
+            });
+
+            QAction *length = new QAction("Length...", this->menubar);
+
+            connect(length, &QAction::triggered, this, [=]
+            {
+                bool ok = false;
+                const uint seconds = QInputDialog::getInt(this, "VCS - Replay buffer",
+                                                          "Seconds of output to keep in the replay buffer:",
+                                                          this->replayBufferSeconds, 1, 3600, 1, &ok);
+
+                if (ok) this->replayBufferSeconds = seconds;
+            });
+
+            QAction *memory = new QAction("Memory budget...", this->menubar);
+
+            connect(memory, &QAction::triggered, this, [=]
+            {
+                bool ok = false;
+                const uint megabytes = QInputDialog::getInt(this, "VCS - Replay buffer",
+                                                            "Maximum memory use of the replay buffer (MB):",
+                                                            this->replayBufferMemoryMB, 16, 16384, 16, &ok);
+
+                if (ok) this->replayBufferMemoryMB = megabytes;
+            });
+
+            replayMenu->addAction(enable);
+            replayMenu->addAction(save);
+            replayMenu->addSeparator();
+            replayMenu->addAction(length);
+            replayMenu->addAction(memory);
+
+            this->menubar->addMenu(replayMenu);
+        }
+
         this->layout()->setMenuBar(menubar);
     }
 
@@ -167,6 +274,10 @@ RecordDialog::RecordDialog(QDialog *parent) :
     {
         ui->spinBox_recordingFramerate->setValue(kpers_value_of(INI_GROUP_RECORDING, "frame_rate", 60).toUInt());
         ui->comboBox_recordingLinearFrameInsertion->setCurrentIndex(kpers_value_of(INI_GROUP_RECORDING, "linear_sampling", true).toBool());
+        this->replayBufferSeconds = kpers_value_of(INI_GROUP_RECORDING, "replay_seconds", 30).toUInt();
+        this->replayBufferMemoryMB = kpers_value_of(INI_GROUP_RECORDING, "replay_memory_mb", 512).toUInt();
+        this->segmentMinutes = kpers_value_of(INI_GROUP_RECORDING, "segment_minutes", 0).toUInt();
+        this->segmentMegabytes = kpers_value_of(INI_GROUP_RECORDING, "segment_mb", 0).toUInt();
         this->resize(kpers_value_of(INI_GROUP_GEOMETRY, "record", this->size()).toSize());
 
         #if _WIN32
@@ -220,6 +331,10 @@ RecordDialog::~RecordDialog()
     {
         kpers_set_value(INI_GROUP_RECORDING, "frame_rate", ui->spinBox_recordingFramerate->value());
         kpers_set_value(INI_GROUP_RECORDING, "linear_sampling", bool(ui->comboBox_recordingLinearFrameInsertion->currentIndex()));
+        kpers_set_value(INI_GROUP_RECORDING, "replay_seconds", this->replayBufferSeconds);
+        kpers_set_value(INI_GROUP_RECORDING, "replay_memory_mb", this->replayBufferMemoryMB);
+        kpers_set_value(INI_GROUP_RECORDING, "segment_minutes", this->segmentMinutes);
+        kpers_set_value(INI_GROUP_RECORDING, "segment_mb", this->segmentMegabytes);
         kpers_set_value(INI_GROUP_GEOMETRY, "record", this->size());
 
         #if _WIN32
@@ -294,6 +409,17 @@ void RecordDialog::update_recording_metainfo(void)
         ui->tableWidget_status->modify_property("Input FPS", QString::number(krecord_recording_framerate(), 'f', 2));
 
         ui->tableWidget_status->modify_property("Target FPS", QString::number(krecord_playback_framerate()));
+
+        ui->tableWidget_status->modify_property("Segment", QString::number(krecord_segment_index()));
+
+        const recording_stats_s stats = krecord_recording_stats();
+
+        ui->tableWidget_status->modify_property("Encoder FPS", QString::number(stats.encodeFramerate, 'f', 2));
+        ui->tableWidget_status->modify_property("Encode time", QString("%1 ms").arg(QString::number(stats.encodeTimePerFrame, 'f', 2)));
+        ui->tableWidget_status->modify_property("Pending frames", QString::number(stats.numPendingFrames));
+        ui->tableWidget_status->modify_property("Dropped frames", QString::number(stats.numDroppedFrames));
+        ui->tableWidget_status->modify_property("Duplicated frames", QString::number(stats.numDuplicatedFrames));
+        ui->tableWidget_status->modify_property("Disk write", QString("%1 MB/s").arg(QString::number((stats.diskThroughput / (1024*1024)), 'f', 2)));
     }
     else
     {
@@ -302,6 +428,13 @@ void RecordDialog::update_recording_metainfo(void)
         ui->tableWidget_status->modify_property("File size", "-");
         ui->tableWidget_status->modify_property("Input FPS", "-");
         ui->tableWidget_status->modify_property("Target FPS", "-");
+        ui->tableWidget_status->modify_property("Segment", "-");
+        ui->tableWidget_status->modify_property("Encoder FPS", "-");
+        ui->tableWidget_status->modify_property("Encode time", "-");
+        ui->tableWidget_status->modify_property("Pending frames", "-");
+        ui->tableWidget_status->modify_property("Dropped frames", "-");
+        ui->tableWidget_status->modify_property("Duplicated frames", "-");
+        ui->tableWidget_status->modify_property("Disk write", "-");
     }
 
     return;
@@ -434,6 +567,8 @@ void RecordDialog::set_recording_enabled(const bool enabled)
 
             const resolution_s videoResolution = ks_output_resolution();
 
+            krecord_set_segment_limits(this->segmentMinutes, this->segmentMegabytes);
+
             krecord_start_recording(ui->lineEdit_recordingFilename->text().toStdString().c_str(),
                                     videoResolution.w, videoResolution.h,
                                     ui->spinBox_recordingFramerate->value(),
@@ -459,3 +594,45 @@ bool RecordDialog::is_recording_enabled(void)
 {
     return this->isEnabled;
 }
+
+void RecordDialog::set_replay_buffer_enabled(const bool enabled)
+{
+    if (!enabled)
+    {
+        krecord_stop_replay_buffer();
+    }
+    else if (apply_x264_registry_settings())
+    {
+        krecord_start_replay_buffer(this->replayBufferSeconds,
+                                    this->replayBufferMemoryMB,
+                                    ui->spinBox_recordingFramerate->value());
+    }
+
+    if (krecord_is_replay_buffer_active())
+    {
+        emit this->replay_buffer_enabled();
+    }
+    else
+    {
+        emit this->replay_buffer_disabled();
+    }
+
+    return;
+}
+
+// Saves the replay buffer's current contents into a timestamped file alongside
+// the recording's output file. Returns true if the saving was started; false
+// otherwise.
+bool RecordDialog::save_replay(void)
+{
+    if (!krecord_is_replay_buffer_active())
+    {
+        return false;
+    }
+
+    const QFileInfo recordingFile(ui->lineEdit_recordingFilename->text());
+    const QString filename = QString("%1/replay_%2").arg(recordingFile.path())
+                                                    .arg(QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss"));
+
+    return krecord_save_replay_buffer(filename.toStdString().c_str());
+}
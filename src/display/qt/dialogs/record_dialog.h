@@ -27,6 +27,10 @@ public:
 
     bool is_recording_enabled(void);
 
+    void set_replay_buffer_enabled(const bool enabled);
+
+    bool save_replay(void);
+
 signals:
     // Emitted when the recording's enabled status is toggled.
     void recording_enabled(void);
@@ -34,6 +38,10 @@ signals:
     void recording_could_not_be_disabled(void);
     void recording_could_not_be_enabled(void);
 
+    // Emitted when the replay buffer's enabled status is toggled.
+    void replay_buffer_enabled(void);
+    void replay_buffer_disabled(void);
+
 private:
     bool apply_x264_registry_settings(void);
 
@@ -42,6 +50,16 @@ private:
     // Whether recording is enabled (on).
     bool isEnabled = false;
 
+    // The maximum length (in seconds) and memory use (in megabytes) of the
+    // replay buffer.
+    uint replayBufferSeconds = 30;
+    uint replayBufferMemoryMB = 512;
+
+    // The time (in minutes) and size (in megabytes) limits after which the
+    // recording rolls over into a new file. 0 disables the limit.
+    uint segmentMinutes = 0;
+    uint segmentMegabytes = 0;
+
     QMenuBar *menubar = nullptr;
 };
 
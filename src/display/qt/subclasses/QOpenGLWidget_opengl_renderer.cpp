@@ -5,25 +5,54 @@
  * Uses Qt's OpenGL implementation to draw the contents of the VCS frame buffer
  * to screen. I.e. just draws a full-window textured quad.
  *
+ * The frame texture persists across frames and is only reallocated when the
+ * output resolution changes. Where the OpenGL implementation supports pixel
+ * buffer objects, frames are streamed into the texture through a small ring of
+ * them, so that the upload can proceed asynchronously rather than stalling the
+ * main thread; otherwise, they're uploaded directly with glTexSubImage2D().
+ *
  */
 
 #include <QCoreApplication>
+#include <QOpenGLContext>
+#include <QOpenGLBuffer>
 #include <QOpenGLWidget>
 #include <QMatrix4x4>
 #include "display/qt/subclasses/QOpenGLWidget_opengl_renderer.h"
+#include "display/qt/utility.h"
 #include "capture/capture.h"
+#include "common/telemetry/telemetry.h"
 #include "common/globals.h"
 #include "scaler/scaler.h"
 
 // The texture into which we'll stream the captured frames.
 GLuint FRAMEBUFFER_TEXTURE;
 
+// The resolution for which the frame texture's storage has been allocated.
+resolution_s FRAMEBUFFER_TEXTURE_RESOLUTION = {0, 0, 0};
+
+// A ring of pixel buffer objects through which frames are uploaded into the
+// frame texture. Successive frames use successive buffers, so that writing a
+// new frame needn't wait for the GPU to finish reading the previous one.
+static const uint NUM_UPLOAD_BUFFERS = 2;
+QOpenGLBuffer UPLOAD_BUFFERS[NUM_UPLOAD_BUFFERS];
+uint UPLOAD_BUFFER_IDX = 0;
+
+// Set to false if the OpenGL implementation doesn't support pixel buffer
+// objects, in which case frames get uploaded directly from client memory.
+bool ARE_UPLOAD_BUFFERS_AVAILABLE = false;
+
 // The texture in which we'll display the current output overlay, if any.
 GLuint OVERLAY_TEXTURE;
 
 // A function that returns the current overlay as a QImage.
 std::function<QImage()> OVERLAY_AS_QIMAGE_F;
 
+// The cache key of the overlay image most recently uploaded into the overlay
+// texture. The overlay only changes now and then, so we can skip re-uploading
+// it for as long as the key stays the same.
+qint64 OVERLAY_TEXTURE_CACHE_KEY = 0;
+
 OGLWidget::OGLWidget(std::function<QImage()> overlay_as_qimage, QWidget *parent) : QOpenGLWidget(parent)
 {
     OVERLAY_AS_QIMAGE_F = overlay_as_qimage;
@@ -48,6 +77,31 @@ void OGLWidget::initializeGL()
     this->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     this->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
+    FRAMEBUFFER_TEXTURE_RESOLUTION = {0, 0, 0};
+
+    // The overlay texture is created anew, too, so it'll need its image uploaded.
+    OVERLAY_TEXTURE_CACHE_KEY = 0;
+
+    // Pixel buffer objects are core in OpenGL 2.1, and otherwise available via
+    // an extension.
+    {
+        const QSurfaceFormat format = this->context()->format();
+
+        ARE_UPLOAD_BUFFERS_AVAILABLE = ((format.majorVersion() > 2) ||
+                                        ((format.majorVersion() == 2) && (format.minorVersion() >= 1)) ||
+                                        this->context()->hasExtension("GL_ARB_pixel_buffer_object"));
+
+        for (uint i = 0; (i < NUM_UPLOAD_BUFFERS) && ARE_UPLOAD_BUFFERS_AVAILABLE; i++)
+        {
+            UPLOAD_BUFFERS[i] = QOpenGLBuffer(QOpenGLBuffer::PixelUnpackBuffer);
+            UPLOAD_BUFFERS[i].setUsagePattern(QOpenGLBuffer::StreamDraw);
+
+            ARE_UPLOAD_BUFFERS_AVAILABLE = UPLOAD_BUFFERS[i].create();
+        }
+
+        INFO(("Frames will be uploaded to OpenGL %s.", (ARE_UPLOAD_BUFFERS_AVAILABLE? "via pixel buffer objects" : "directly")));
+    }
+
     this->glGenTextures(1, &OVERLAY_TEXTURE);
     this->glBindTexture(GL_TEXTURE_2D, OVERLAY_TEXTURE);
     this->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -73,26 +127,102 @@ void OGLWidget::resizeGL(int w, int h)
     return;
 }
 
+// Uploads the given frame into the frame texture, which is expected to be bound.
+void OGLWidget::upload_frame_texture(const u8 *const pixels, const resolution_s &r)
+{
+    const int numBytes = (r.w * r.h * 4);
+
+    // Only reallocate the texture's storage when the output resolution changes.
+    if ((r.w != FRAMEBUFFER_TEXTURE_RESOLUTION.w) ||
+        (r.h != FRAMEBUFFER_TEXTURE_RESOLUTION.h))
+    {
+        this->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, r.w, r.h, 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+        FRAMEBUFFER_TEXTURE_RESOLUTION = r;
+    }
+
+    if (ARE_UPLOAD_BUFFERS_AVAILABLE)
+    {
+        QOpenGLBuffer &buffer = UPLOAD_BUFFERS[UPLOAD_BUFFER_IDX];
+        UPLOAD_BUFFER_IDX = ((UPLOAD_BUFFER_IDX + 1) % NUM_UPLOAD_BUFFERS);
+
+        buffer.bind();
+
+        // Reallocating the buffer's storage orphans its previous contents, so
+        // the driver needn't wait for any pending reads of them to finish.
+        buffer.allocate(numBytes);
+
+        void *const dst = buffer.map(QOpenGLBuffer::WriteOnly);
+        if (dst)
+        {
+            memcpy(dst, pixels, numBytes);
+            buffer.unmap();
+
+            // With a pixel unpack buffer bound, the data pointer is an offset
+            // into the buffer.
+            this->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, r.w, r.h, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+            buffer.release();
+
+            return;
+        }
+
+        // If the buffer can't be mapped, fall back to a direct upload.
+        buffer.release();
+    }
+
+    this->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, r.w, r.h, GL_BGRA, GL_UNSIGNED_BYTE, pixels);
+
+    return;
+}
+
 void OGLWidget::paintGL()
 {
-    // Draw the output frame.
+    TELEMETRY_TIME_SCOPE("Paint");
+
     const resolution_s r = ks_output_resolution();
-    const u8 *const fb = ks_scaler_output_as_raw_ptr();
-    if (fb != nullptr)
+
+    // Scale factors from output resolution to window coordinates.
+    const double scaleX = (this->width() / double(r.w));
+    const double scaleY = (this->height() / double(r.h));
+
+    // Draw the output frame. Holding a reference to it keeps its pixels intact
+    // for the duration of the upload.
+    const auto frame = ks_scaler_output_frame();
+    if (frame)
     {
+        // The output frame may be smaller than the output resolution if the
+        // scaler has left its upscaling for us to do.
+        const resolution_s frameRes = frame->resolution;
+
+        const QRect frameRect = scaler_output_frame_rect();
+        const int left = (frameRect.left() * scaleX);
+        const int top = (frameRect.top() * scaleY);
+        const int right = ((frameRect.left() + frameRect.width()) * scaleX);
+        const int bottom = ((frameRect.top() + frameRect.height()) * scaleY);
+
+        // Clear any padding around the frame.
+        if ((frameRes.w != r.w) || (frameRes.h != r.h))
+        {
+            this->glClearColor(0, 0, 0, 1);
+            this->glClear(GL_COLOR_BUFFER_BIT);
+        }
+
         this->glDisable(GL_BLEND);
 
         this->glBindTexture(GL_TEXTURE_2D, FRAMEBUFFER_TEXTURE);
-        this->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, r.w, r.h, 0, GL_BGRA, GL_UNSIGNED_BYTE, fb);
+        upload_frame_texture(frame->pixels.ptr(), frameRes);
+
+        const GLint magFilter = (is_renderer_upscale_smoothed()? GL_LINEAR : GL_NEAREST);
+        this->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, magFilter);
+        this->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
 
         glBegin(GL_TRIANGLES);
-            glTexCoord2i(0, 0); glVertex2i(0,             0);
-            glTexCoord2i(0, 1); glVertex2i(0,             this->height());
-            glTexCoord2i(1, 1); glVertex2i(this->width(), this->height());
+            glTexCoord2i(0, 0); glVertex2i(left,  top);
+            glTexCoord2i(0, 1); glVertex2i(left,  bottom);
+            glTexCoord2i(1, 1); glVertex2i(right, bottom);
 
-            glTexCoord2i(1, 1); glVertex2i(this->width(), this->height());
-            glTexCoord2i(1, 0); glVertex2i(this->width(), 0);
-            glTexCoord2i(0, 0); glVertex2i(0,             0);
+            glTexCoord2i(1, 1); glVertex2i(right, bottom);
+            glTexCoord2i(1, 0); glVertex2i(right, top);
+            glTexCoord2i(0, 0); glVertex2i(left,  top);
         glEnd();
     }
 
@@ -103,16 +233,28 @@ void OGLWidget::paintGL()
         this->glEnable(GL_BLEND);
 
         this->glBindTexture(GL_TEXTURE_2D, OVERLAY_TEXTURE);
-        this->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.width(), image.height(), 0, GL_BGRA, GL_UNSIGNED_BYTE, image.constBits());
+
+        if (image.cacheKey() != OVERLAY_TEXTURE_CACHE_KEY)
+        {
+            this->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.width(), image.height(), 0, GL_BGRA, GL_UNSIGNED_BYTE, image.constBits());
+            OVERLAY_TEXTURE_CACHE_KEY = image.cacheKey();
+        }
+
+        // The overlay image covers only part of the output frame, so map its
+        // position and size from output resolution to window coordinates.
+        const int left = (image.offset().x() * scaleX);
+        const int top = (image.offset().y() * scaleY);
+        const int right = ((image.offset().x() + image.width()) * scaleX);
+        const int bottom = ((image.offset().y() + image.height()) * scaleY);
 
         glBegin(GL_TRIANGLES);
-            glTexCoord2i(0, 0); glVertex2i(0,             0);
-            glTexCoord2i(0, 1); glVertex2i(0,             this->height());
-            glTexCoord2i(1, 1); glVertex2i(this->width(), this->height());
+            glTexCoord2i(0, 0); glVertex2i(left,  top);
+            glTexCoord2i(0, 1); glVertex2i(left,  bottom);
+            glTexCoord2i(1, 1); glVertex2i(right, bottom);
 
-            glTexCoord2i(1, 1); glVertex2i(this->width(), this->height());
-            glTexCoord2i(1, 0); glVertex2i(this->width(), 0);
-            glTexCoord2i(0, 0); glVertex2i(0,             0);
+            glTexCoord2i(1, 1); glVertex2i(right, bottom);
+            glTexCoord2i(1, 0); glVertex2i(right, top);
+            glTexCoord2i(0, 0); glVertex2i(left,  top);
         glEnd();
     }
 
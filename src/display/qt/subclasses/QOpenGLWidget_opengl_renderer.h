@@ -14,6 +14,7 @@
 #include "common/types.h"
 
 class OverlayDialog;
+struct resolution_s;
 
 class OGLWidget : public QOpenGLWidget, protected QOpenGLFunctions_1_2
 {
@@ -26,6 +27,9 @@ protected:
     void initializeGL();
     void resizeGL(int w, int h);
     void paintGL();
+
+private:
+    void upload_frame_texture(const u8 *const pixels, const resolution_s &r);
 };
 
 #endif
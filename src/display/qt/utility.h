@@ -12,7 +12,9 @@
 #include <QComboBox>
 #include <QWidget>
 #include <QTimer>
+#include <QRect>
 #include "common/globals.h"
+#include "scaler/scaler.h"
 
 // Emits a signal when the mouse becomes active or inactivates. Note that this class
 // works manually rather than automatically: you call report_activity() to indicate
@@ -105,6 +107,33 @@ private:
     const bool previousBlockStatus;
 };
 
+// Returns the rectangle, in output resolution coordinates, into which the
+// scaler's current output frame should be drawn. Normally, this covers the whole
+// output; but if the scaler has left the upscaling of the frame to the renderer,
+// the frame may also need to be padded to maintain its aspect ratio.
+inline QRect scaler_output_frame_rect(void)
+{
+    const resolution_s outputRes = ks_output_resolution();
+    const resolution_s frameRes = ks_scaler_output_resolution();
+
+    if (((frameRes.w == outputRes.w) && (frameRes.h == outputRes.h)) ||
+        !ks_is_forced_aspect_enabled())
+    {
+        return QRect(0, 0, outputRes.w, outputRes.h);
+    }
+
+    const resolution_s paddedRes = ks_padded_resolution(frameRes, outputRes);
+
+    return QRect(((outputRes.w - paddedRes.w) / 2), ((outputRes.h - paddedRes.h) / 2), paddedRes.w, paddedRes.h);
+}
+
+// Returns true if the renderer should smooth the output frame as it upscales it.
+inline bool is_renderer_upscale_smoothed(void)
+{
+    return (ks_is_deferred_upscaling_enabled() &&
+            (ks_upscaling_filter_name() == "Linear"));
+}
+
 class set_qcombobox_idx_c
 {
 public:
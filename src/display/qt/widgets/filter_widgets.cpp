@@ -4,17 +4,11 @@
 
 filter_widget_s::filter_widget_s(const filter_type_enum_e filterType,
                                  u8 *const parameterArray,
-                                 const u8 *const initialParameterValues,
                                  const unsigned minWidth) :
     title(QString::fromStdString(kf_filter_name_for_type(filterType))),
     parameterArray(parameterArray),
     minWidth(minWidth)
 {
-    if (initialParameterValues)
-    {
-        memcpy(parameterArray, initialParameterValues, FILTER_PARAMETER_ARRAY_LENGTH);
-    }
-
     return;
 }
 
@@ -23,14 +17,14 @@ filter_widget_s::~filter_widget_s()
     return;
 }
 
-void filter_widget_blur_s::reset_parameter_data(void)
+void filter_widget_blur_s::reset_parameter_data(u8 *const parameterArray)
 {
-    k_assert(this->parameterArray, "Expected non-null pointer to filter data.");
+    k_assert(parameterArray, "Expected non-null pointer to filter data.");
 
-    memset(this->parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
+    memset(parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
 
-    this->parameterArray[OFFS_KERNEL_SIZE] = 10;
-    this->parameterArray[OFFS_TYPE] = FILTER_TYPE_GAUSSIAN;
+    parameterArray[OFFS_KERNEL_SIZE] = 10;
+    parameterArray[OFFS_TYPE] = FILTER_TYPE_GAUSSIAN;
 
     return;
 }
@@ -76,17 +70,17 @@ void filter_widget_blur_s::create_widget(void)
     return;
 }
 
-void filter_widget_rotate_s::reset_parameter_data(void)
+void filter_widget_rotate_s::reset_parameter_data(u8 *const parameterArray)
 {
-    k_assert(this->parameterArray, "Expected non-null pointer to filter data.");
+    k_assert(parameterArray, "Expected non-null pointer to filter data.");
 
-    memset(this->parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
+    memset(parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
 
     // The scale value gets divided by 100 when used.
-    *(i16*)&(this->parameterArray[OFFS_SCALE]) = 100;
+    *(i16*)&(parameterArray[OFFS_SCALE]) = 100;
 
     // The rotation value gets divided by 10 when used.
-    *(i16*)&(this->parameterArray[OFFS_ROT]) = 0;
+    *(i16*)&(parameterArray[OFFS_ROT]) = 0;
 
     return;
 }
@@ -131,14 +125,14 @@ void filter_widget_rotate_s::create_widget(void)
     return;
 }
 
-void filter_widget_input_gate_s::reset_parameter_data(void)
+void filter_widget_input_gate_s::reset_parameter_data(u8 *const parameterArray)
 {
-    k_assert(this->parameterArray, "Expected non-null pointer to filter data.");
+    k_assert(parameterArray, "Expected non-null pointer to filter data.");
 
-    memset(this->parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
+    memset(parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
 
-    *(u16*)&(this->parameterArray[OFFS_WIDTH]) = 640;
-    *(u16*)&(this->parameterArray[OFFS_HEIGHT]) = 480;
+    *(u16*)&(parameterArray[OFFS_WIDTH]) = 640;
+    *(u16*)&(parameterArray[OFFS_HEIGHT]) = 480;
 }
 
 void filter_widget_input_gate_s::create_widget(void)
@@ -178,14 +172,14 @@ void filter_widget_input_gate_s::create_widget(void)
     return;
 }
 
-void filter_widget_output_gate_s::reset_parameter_data(void)
+void filter_widget_output_gate_s::reset_parameter_data(u8 *const parameterArray)
 {
-    k_assert(this->parameterArray, "Expected non-null pointer to filter data.");
+    k_assert(parameterArray, "Expected non-null pointer to filter data.");
 
-    memset(this->parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
+    memset(parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
 
-    *(u16*)&(this->parameterArray[OFFS_WIDTH]) = 1920;
-    *(u16*)&(this->parameterArray[OFFS_HEIGHT]) = 1080;
+    *(u16*)&(parameterArray[OFFS_WIDTH]) = 1920;
+    *(u16*)&(parameterArray[OFFS_HEIGHT]) = 1080;
 
     return;
 }
@@ -227,17 +221,17 @@ void filter_widget_output_gate_s::create_widget(void)
     return;
 }
 
-void filter_widget_crop_s::reset_parameter_data(void)
+void filter_widget_crop_s::reset_parameter_data(u8 *const parameterArray)
 {
-    k_assert(this->parameterArray, "Expected non-null pointer to filter data.");
+    k_assert(parameterArray, "Expected non-null pointer to filter data.");
 
-    memset(this->parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
+    memset(parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
 
-    *(u16*)&(this->parameterArray[OFFS_X]) = 0;
-    *(u16*)&(this->parameterArray[OFFS_Y]) = 0;
-    *(u16*)&(this->parameterArray[OFFS_WIDTH]) = 640;
-    *(u16*)&(this->parameterArray[OFFS_HEIGHT]) = 480;
-    this->parameterArray[OFFS_SCALER] = 0;
+    *(u16*)&(parameterArray[OFFS_X]) = 0;
+    *(u16*)&(parameterArray[OFFS_Y]) = 0;
+    *(u16*)&(parameterArray[OFFS_WIDTH]) = 640;
+    *(u16*)&(parameterArray[OFFS_HEIGHT]) = 480;
+    parameterArray[OFFS_SCALER] = 0;
 
     return;
 }
@@ -317,11 +311,11 @@ void filter_widget_crop_s::create_widget(void)
     return;
 }
 
-void filter_widget_flip_s::reset_parameter_data(void)
+void filter_widget_flip_s::reset_parameter_data(u8 *const parameterArray)
 {
-    k_assert(this->parameterArray, "Expected non-null pointer to filter data.");
+    k_assert(parameterArray, "Expected non-null pointer to filter data.");
 
-    memset(this->parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
+    memset(parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
 
     return;
 }
@@ -353,13 +347,13 @@ void filter_widget_flip_s::create_widget(void)
     return;
 }
 
-void filter_widget_median_s::reset_parameter_data(void)
+void filter_widget_median_s::reset_parameter_data(u8 *const parameterArray)
 {
-    k_assert(this->parameterArray, "Expected non-null pointer to filter data.");
+    k_assert(parameterArray, "Expected non-null pointer to filter data.");
 
-    memset(this->parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
+    memset(parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
 
-    this->parameterArray[OFFS_KERNEL_SIZE] = 3;
+    parameterArray[OFFS_KERNEL_SIZE] = 3;
 
     return;
 }
@@ -390,13 +384,13 @@ void filter_widget_median_s::create_widget(void)
     return;
 }
 
-void filter_widget_denoise_temporal_s::reset_parameter_data(void)
+void filter_widget_denoise_temporal_s::reset_parameter_data(u8 *const parameterArray)
 {
-    k_assert(this->parameterArray, "Expected non-null pointer to filter data.");
+    k_assert(parameterArray, "Expected non-null pointer to filter data.");
 
-    memset(this->parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
+    memset(parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
 
-    this->parameterArray[OFFS_THRESHOLD] = 5;
+    parameterArray[OFFS_THRESHOLD] = 5;
 
     return;
 }
@@ -427,16 +421,16 @@ void filter_widget_denoise_temporal_s::create_widget(void)
     return;
 }
 
-void filter_widget_denoise_nonlocal_means_s::reset_parameter_data(void)
+void filter_widget_denoise_nonlocal_means_s::reset_parameter_data(u8 *const parameterArray)
 {
-    k_assert(this->parameterArray, "Expected non-null pointer to filter data.");
+    k_assert(parameterArray, "Expected non-null pointer to filter data.");
 
-    memset(this->parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
+    memset(parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
 
-    this->parameterArray[OFFS_H] = 10;
-    this->parameterArray[OFFS_H_COLOR] = 10;
-    this->parameterArray[OFFS_TEMPLATE_WINDOW_SIZE] = 7;
-    this->parameterArray[OFFS_SEARCH_WINDOW_SIZE] = 21;
+    parameterArray[OFFS_H] = 10;
+    parameterArray[OFFS_H_COLOR] = 10;
+    parameterArray[OFFS_TEMPLATE_WINDOW_SIZE] = 7;
+    parameterArray[OFFS_SEARCH_WINDOW_SIZE] = 21;
 
     return;
 }
@@ -503,11 +497,11 @@ void filter_widget_denoise_nonlocal_means_s::create_widget(void)
     return;
 }
 
-void filter_widget_sharpen_s::reset_parameter_data(void)
+void filter_widget_sharpen_s::reset_parameter_data(u8 *const parameterArray)
 {
-    k_assert(this->parameterArray, "Expected non-null pointer to filter data.");
+    k_assert(parameterArray, "Expected non-null pointer to filter data.");
 
-    memset(this->parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
+    memset(parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
 
     return;
 }
@@ -529,14 +523,14 @@ void filter_widget_sharpen_s::create_widget(void)
     return;
 }
 
-void filter_widget_unsharp_mask_s::reset_parameter_data(void)
+void filter_widget_unsharp_mask_s::reset_parameter_data(u8 *const parameterArray)
 {
-    k_assert(this->parameterArray, "Expected non-null pointer to filter data.");
+    k_assert(parameterArray, "Expected non-null pointer to filter data.");
 
-    memset(this->parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
+    memset(parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
 
-    this->parameterArray[OFFS_STRENGTH] = 50;
-    this->parameterArray[OFFS_RADIUS] = 10;
+    parameterArray[OFFS_STRENGTH] = 50;
+    parameterArray[OFFS_RADIUS] = 10;
 
     return;
 }
@@ -580,14 +574,14 @@ void filter_widget_unsharp_mask_s::create_widget(void)
     return;
 }
 
-void filter_widget_decimate_s::reset_parameter_data(void)
+void filter_widget_decimate_s::reset_parameter_data(u8 *const parameterArray)
 {
-    k_assert(this->parameterArray, "Expected non-null pointer to filter data.");
+    k_assert(parameterArray, "Expected non-null pointer to filter data.");
 
-    memset(this->parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
+    memset(parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
 
-    this->parameterArray[OFFS_FACTOR] = 2;
-    this->parameterArray[OFFS_TYPE] = FILTER_TYPE_AVERAGE;
+    parameterArray[OFFS_FACTOR] = 2;
+    parameterArray[OFFS_TYPE] = FILTER_TYPE_AVERAGE;
 
     return;
 }
@@ -635,11 +629,11 @@ void filter_widget_decimate_s::create_widget(void)
     return;
 }
 
-void filter_widget_delta_histogram_s::reset_parameter_data(void)
+void filter_widget_delta_histogram_s::reset_parameter_data(u8 *const parameterArray)
 {
-    k_assert(this->parameterArray, "Expected non-null pointer to filter data.");
+    k_assert(parameterArray, "Expected non-null pointer to filter data.");
 
-    memset(this->parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
+    memset(parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
 
     return;
 }
@@ -661,14 +655,14 @@ void filter_widget_delta_histogram_s::create_widget(void)
     return;
 }
 
-void filter_widget_unique_count_s::reset_parameter_data()
+void filter_widget_unique_count_s::reset_parameter_data(u8 *const parameterArray)
 {
-    k_assert(this->parameterArray, "Expected non-null pointer to filter data.");
+    k_assert(parameterArray, "Expected non-null pointer to filter data.");
 
-    memset(this->parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
+    memset(parameterArray, 0, sizeof(u8) * FILTER_PARAMETER_ARRAY_LENGTH);
 
-    this->parameterArray[OFFS_THRESHOLD] = 20;
-    this->parameterArray[OFFS_CORNER] = 0;
+    parameterArray[OFFS_THRESHOLD] = 20;
+    parameterArray[OFFS_CORNER] = 0;
 
     return;
 }
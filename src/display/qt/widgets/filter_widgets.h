@@ -17,15 +17,11 @@ struct filter_widget_s : public QObject
 {
     filter_widget_s(const filter_type_enum_e filterType,
                     u8 *const parameterArray,
-                    const u8 *const initialParameterValues = nullptr,
                     const unsigned minWidth = 220);
     virtual ~filter_widget_s();
 
     QWidget *widget = nullptr;
 
-    // Fills the given byte array with the filter's default parameters.
-    virtual void reset_parameter_data(void) = 0;
-
     // Initializes the filter's Qt widget, which contains all the filter's user-
     // accessible controls. The widget might contain, for instance, a spin box
     // for adjusting the radius of a blur filter.
@@ -38,6 +34,9 @@ struct filter_widget_s : public QObject
     // user-configurable parameters.
     const QString noParamsMsg = "(No parameters.)";
 
+    // The filter's parameters, which the widget's controls modify. The array is
+    // expected to have been initialized beforehand, either with saved values or
+    // via the static reset_parameter_data() of the derived widget.
     u8 *const parameterArray;
 
     // The default width of the widget.
@@ -54,15 +53,14 @@ struct filter_widget_input_gate_s : public filter_widget_s
     // Width and height reserve two bytes each.
     enum data_offset_e { OFFS_WIDTH = 0, OFFS_HEIGHT = 2};
 
-    filter_widget_input_gate_s(u8 *const parameterArray, const u8 *const initialParameterValues) :
-        filter_widget_s(filter_type_enum_e::input_gate, parameterArray, initialParameterValues, 180)
+    filter_widget_input_gate_s(u8 *const parameterArray) :
+        filter_widget_s(filter_type_enum_e::input_gate, parameterArray, 180)
     {
-        if (!initialParameterValues) this->reset_parameter_data();
         create_widget();
         return;
     }
 
-    void reset_parameter_data(void) override;
+    static void reset_parameter_data(u8 *const parameterArray);
 
 private:
     Q_OBJECT
@@ -77,15 +75,14 @@ struct filter_widget_output_gate_s : public filter_widget_s
     // Width and height reserve two bytes each.
     enum data_offset_e { OFFS_WIDTH = 0, OFFS_HEIGHT = 2};
 
-    filter_widget_output_gate_s(u8 *const parameterArray, const u8 *const initialParameterValues) :
-        filter_widget_s(filter_type_enum_e::output_gate, parameterArray, initialParameterValues, 180)
+    filter_widget_output_gate_s(u8 *const parameterArray) :
+        filter_widget_s(filter_type_enum_e::output_gate, parameterArray, 180)
     {
-        if (!initialParameterValues) this->reset_parameter_data();
         create_widget();
         return;
     }
 
-    void reset_parameter_data(void) override;
+    static void reset_parameter_data(u8 *const parameterArray);
 
 private:
     Q_OBJECT
@@ -100,15 +97,14 @@ struct filter_widget_blur_s : public filter_widget_s
     enum data_offset_e { OFFS_TYPE = 0, OFFS_KERNEL_SIZE = 1 };
     enum filter_type_e { FILTER_TYPE_BOX = 0, FILTER_TYPE_GAUSSIAN = 1 };
 
-    filter_widget_blur_s(u8 *const parameterArray, const u8 *const initialParameterValues) :
-        filter_widget_s(filter_type_enum_e::blur, parameterArray, initialParameterValues)
+    filter_widget_blur_s(u8 *const parameterArray) :
+        filter_widget_s(filter_type_enum_e::blur, parameterArray)
     {
-        if (!initialParameterValues) this->reset_parameter_data();
         create_widget();
         return;
     }
 
-    void reset_parameter_data(void) override;
+    static void reset_parameter_data(u8 *const parameterArray);
 
 private:
     Q_OBJECT
@@ -123,15 +119,14 @@ struct filter_widget_rotate_s : public filter_widget_s
     // Note: the rotation angle and scale reserve two bytes.
     enum data_offset_e { OFFS_ROT = 0, OFFS_SCALE = 2 };
 
-    filter_widget_rotate_s(u8 *const parameterArray, const u8 *const initialParameterValues) :
-        filter_widget_s(filter_type_enum_e::rotate, parameterArray, initialParameterValues)
+    filter_widget_rotate_s(u8 *const parameterArray) :
+        filter_widget_s(filter_type_enum_e::rotate, parameterArray)
     {
-        if (!initialParameterValues) this->reset_parameter_data();
         create_widget();
         return;
     }
 
-    void reset_parameter_data(void) override;
+    static void reset_parameter_data(u8 *const parameterArray);
 
 private:
     Q_OBJECT
@@ -146,15 +141,14 @@ struct filter_widget_crop_s : public filter_widget_s
     // Note: x, y, width, and height reserve two bytes each.
     enum data_offset_e { OFFS_X = 0, OFFS_Y = 2, OFFS_WIDTH = 4, OFFS_HEIGHT = 6, OFFS_SCALER = 8 };
 
-    filter_widget_crop_s(u8 *const parameterArray, const u8 *const initialParameterValues) :
-        filter_widget_s(filter_type_enum_e::crop, parameterArray, initialParameterValues)
+    filter_widget_crop_s(u8 *const parameterArray) :
+        filter_widget_s(filter_type_enum_e::crop, parameterArray)
     {
-        if (!initialParameterValues) this->reset_parameter_data();
         create_widget();
         return;
     }
 
-    void reset_parameter_data(void) override;
+    static void reset_parameter_data(u8 *const parameterArray);
 
 private:
     Q_OBJECT
@@ -168,15 +162,14 @@ struct filter_widget_flip_s : public filter_widget_s
 {
     enum data_offset_e { OFFS_AXIS = 0 };
 
-    filter_widget_flip_s(u8 *const parameterArray, const u8 *const initialParameterValues) :
-        filter_widget_s(filter_type_enum_e::flip, parameterArray, initialParameterValues)
+    filter_widget_flip_s(u8 *const parameterArray) :
+        filter_widget_s(filter_type_enum_e::flip, parameterArray)
     {
-        if (!initialParameterValues) this->reset_parameter_data();
         create_widget();
         return;
     }
 
-    void reset_parameter_data(void) override;
+    static void reset_parameter_data(u8 *const parameterArray);
 
 private:
     Q_OBJECT
@@ -190,15 +183,14 @@ struct filter_widget_median_s : public filter_widget_s
 {
     enum data_offset_e { OFFS_KERNEL_SIZE = 0 };
 
-    filter_widget_median_s(u8 *const parameterArray, const u8 *const initialParameterValues) :
-        filter_widget_s(filter_type_enum_e::median, parameterArray, initialParameterValues)
+    filter_widget_median_s(u8 *const parameterArray) :
+        filter_widget_s(filter_type_enum_e::median, parameterArray)
     {
-        if (!initialParameterValues) this->reset_parameter_data();
         create_widget();
         return;
     }
 
-    void reset_parameter_data(void) override;
+    static void reset_parameter_data(u8 *const parameterArray);
 
 private:
     Q_OBJECT
@@ -213,15 +205,14 @@ struct filter_widget_denoise_temporal_s : public filter_widget_s
     enum data_offset_e { OFFS_THRESHOLD = 0};
     enum filter_type_e { FILTER_TYPE_TEMPORAL = 0, FILTER_TYPE_SPATIAL = 1 };
 
-    filter_widget_denoise_temporal_s(u8 *const parameterArray, const u8 *const initialParameterValues) :
-        filter_widget_s(filter_type_enum_e::denoise_temporal, parameterArray, initialParameterValues)
+    filter_widget_denoise_temporal_s(u8 *const parameterArray) :
+        filter_widget_s(filter_type_enum_e::denoise_temporal, parameterArray)
     {
-        if (!initialParameterValues) this->reset_parameter_data();
         create_widget();
         return;
     }
 
-    void reset_parameter_data(void) override;
+    static void reset_parameter_data(u8 *const parameterArray);
 
 private:
     Q_OBJECT
@@ -236,15 +227,14 @@ struct filter_widget_denoise_nonlocal_means_s : public filter_widget_s
     // Offsets in the paramData array of the various parameters' values.
     enum data_offset_e { OFFS_H = 0, OFFS_H_COLOR = 1, OFFS_TEMPLATE_WINDOW_SIZE = 2, OFFS_SEARCH_WINDOW_SIZE = 3};
 
-    filter_widget_denoise_nonlocal_means_s(u8 *const parameterArray, const u8 *const initialParameterValues) :
-        filter_widget_s(filter_type_enum_e::denoise_nonlocal_means, parameterArray, initialParameterValues)
+    filter_widget_denoise_nonlocal_means_s(u8 *const parameterArray) :
+        filter_widget_s(filter_type_enum_e::denoise_nonlocal_means, parameterArray)
     {
-        if (!initialParameterValues) this->reset_parameter_data();
         create_widget();
         return;
     }
 
-    void reset_parameter_data(void) override;
+    static void reset_parameter_data(u8 *const parameterArray);
 
 private:
     Q_OBJECT
@@ -256,15 +246,14 @@ private:
 
 struct filter_widget_sharpen_s : public filter_widget_s
 {
-    filter_widget_sharpen_s(u8 *const parameterArray, const u8 *const initialParameterValues) :
-        filter_widget_s(filter_type_enum_e::sharpen, parameterArray, initialParameterValues)
+    filter_widget_sharpen_s(u8 *const parameterArray) :
+        filter_widget_s(filter_type_enum_e::sharpen, parameterArray)
     {
-        if (!initialParameterValues) this->reset_parameter_data();
         create_widget();
         return;
     }
 
-    void reset_parameter_data(void) override;
+    static void reset_parameter_data(u8 *const parameterArray);
 
 private:
     Q_OBJECT
@@ -278,15 +267,14 @@ struct filter_widget_unsharp_mask_s : public filter_widget_s
 {
     enum data_offset_e { OFFS_STRENGTH = 0, OFFS_RADIUS = 1 };
 
-    filter_widget_unsharp_mask_s(u8 *const parameterArray, const u8 *const initialParameterValues) :
-        filter_widget_s(filter_type_enum_e::unsharp_mask, parameterArray, initialParameterValues)
+    filter_widget_unsharp_mask_s(u8 *const parameterArray) :
+        filter_widget_s(filter_type_enum_e::unsharp_mask, parameterArray)
     {
-        if (!initialParameterValues) this->reset_parameter_data();
         create_widget();
         return;
     }
 
-    void reset_parameter_data(void) override;
+    static void reset_parameter_data(u8 *const parameterArray);
 
 private:
     Q_OBJECT
@@ -301,15 +289,14 @@ struct filter_widget_decimate_s : public filter_widget_s
     enum data_offset_e { OFFS_TYPE = 0, OFFS_FACTOR = 1 };
     enum filter_type_e { FILTER_TYPE_NEAREST = 0, FILTER_TYPE_AVERAGE = 1 };
 
-    filter_widget_decimate_s(u8 *const parameterArray, const u8 *const initialParameterValues) :
-        filter_widget_s(filter_type_enum_e::decimate, parameterArray, initialParameterValues)
+    filter_widget_decimate_s(u8 *const parameterArray) :
+        filter_widget_s(filter_type_enum_e::decimate, parameterArray)
     {
-        if (!initialParameterValues) this->reset_parameter_data();
         create_widget();
         return;
     }
 
-    void reset_parameter_data(void) override;
+    static void reset_parameter_data(u8 *const parameterArray);
 
 private:
     Q_OBJECT
@@ -321,15 +308,14 @@ private:
 
 struct filter_widget_delta_histogram_s : public filter_widget_s
 {
-    filter_widget_delta_histogram_s(u8 *const parameterArray, const u8 *const initialParameterValues) :
-        filter_widget_s(filter_type_enum_e::delta_histogram, parameterArray, initialParameterValues)
+    filter_widget_delta_histogram_s(u8 *const parameterArray) :
+        filter_widget_s(filter_type_enum_e::delta_histogram, parameterArray)
     {
-        if (!initialParameterValues) this->reset_parameter_data();
         create_widget();
         return;
     }
 
-    void reset_parameter_data(void) override;
+    static void reset_parameter_data(u8 *const parameterArray);
 
 private:
     Q_OBJECT
@@ -343,15 +329,14 @@ struct filter_widget_unique_count_s : public filter_widget_s
 {
     enum data_offset_e { OFFS_THRESHOLD = 0, OFFS_CORNER = 1 };
 
-    filter_widget_unique_count_s(u8 *const parameterArray, const u8 *const initialParameterValues) :
-        filter_widget_s(filter_type_enum_e::unique_count, parameterArray, initialParameterValues)
+    filter_widget_unique_count_s(u8 *const parameterArray) :
+        filter_widget_s(filter_type_enum_e::unique_count, parameterArray)
     {
-        if (!initialParameterValues) this->reset_parameter_data();
         create_widget();
         return;
     }
 
-    void reset_parameter_data(void) override;
+    static void reset_parameter_data(u8 *const parameterArray);
 
 private:
     Q_OBJECT
@@ -41,8 +41,10 @@
 #include "display/qt/dialogs/alias_dialog.h"
 #include "display/qt/dialogs/about_dialog.h"
 #include "display/qt/persistent_settings.h"
+#include "display/qt/utility.h"
 #include "filter/anti_tear.h"
 #include "common/propagate/app_events.h"
+#include "common/telemetry/telemetry.h"
 #include "capture/video_presets.h"
 #include "capture/capture_api.h"
 #include "capture/capture.h"
@@ -52,11 +54,6 @@
 #include "scaler/scaler.h"
 #include "ui_output_window.h"
 
-/// Temp. Stores the number of milliseconds passed for each frame update. This
-/// number includes everything done to the frame - capture, scaling, and display.
-int UPDATE_LATENCY_PEAK = 0;
-int UPDATE_LATENCY_AVG = 0;
-
 /// Temporary.
 uint CURRENT_OUTPUT_FRAMERATE = 0;
 
@@ -475,6 +472,18 @@ MainWindow::MainWindow(QWidget *parent) :
             menu->addSeparator();
             menu->addMenu(upscaler);
             menu->addMenu(downscaler);
+
+            // Lets the renderer do nearest/linear upscaling instead of the scaler.
+            QAction *rendererUpscaling = new QAction("Upscale in renderer", this);
+            {
+                rendererUpscaling->setCheckable(true);
+
+                connect(rendererUpscaling, &QAction::toggled, this, [=](const bool checked){ks_set_deferred_upscaling_enabled(checked);});
+
+                rendererUpscaling->setChecked(kpers_value_of(INI_GROUP_OUTPUT, "renderer_upscaling", false).toBool());
+            }
+
+            menu->addAction(rendererUpscaling);
             menu->addSeparator();
 
             QAction *overlay = new QAction("Overlay...", this);
@@ -601,7 +610,7 @@ MainWindow::MainWindow(QWidget *parent) :
 
     // Subscribe to app events.
     {
-        ke_events().scaler.newFrame->subscribe([this]
+        ke_events().scaler.newFrame->subscribe([this](const std::shared_ptr<const scaled_frame_s>&)
         {
             this->redraw();
 
@@ -609,7 +618,7 @@ MainWindow::MainWindow(QWidget *parent) :
             this->measure_framerate();
         });
 
-        ke_events().scaler.newFrameResolution->subscribe([this]
+        ke_events().scaler.newFrameResolution->subscribe([this](const resolution_s&)
         {
             this->update_window_title();
             this->update_window_size();
@@ -697,6 +706,7 @@ MainWindow::~MainWindow()
         kpers_set_value(INI_GROUP_OUTPUT, "renderer", (OGL_SURFACE? "OpenGL" : "Software"));
         kpers_set_value(INI_GROUP_OUTPUT, "upscaler", QString::fromStdString(ks_upscaling_filter_name()));
         kpers_set_value(INI_GROUP_OUTPUT, "downscaler", QString::fromStdString(ks_downscaling_filter_name()));
+        kpers_set_value(INI_GROUP_OUTPUT, "renderer_upscaling", ks_is_deferred_upscaling_enabled());
     }
 
     delete ui;
@@ -1013,6 +1023,8 @@ QImage MainWindow::overlay_image(void)
         overlayDlg != nullptr &&
         overlayDlg->is_overlay_enabled())
     {
+        TELEMETRY_TIME_SCOPE("Overlay");
+
         return overlayDlg->overlay_as_qimage();
     }
     else return QImage();
@@ -1023,33 +1035,47 @@ void MainWindow::paintEvent(QPaintEvent *)
     // If OpenGL is enabled, its own paintGL() should be getting called instead of paintEvent().
     if (OGL_SURFACE != nullptr) return;
 
-    // Convert the output buffer into a QImage frame.
-    const QImage frameImage = ([]()->QImage
-    {
-        const resolution_s r = ks_output_resolution();
-        const u8 *const fb = ks_scaler_output_as_raw_ptr();
+    TELEMETRY_TIME_SCOPE("Paint");
 
-        if (fb == nullptr)
+    // Convert the output frame into a QImage. The image doesn't copy the frame's
+    // pixels, so we hold a reference to the frame until we're done painting.
+    const auto frame = ks_scaler_output_frame();
+    const QImage frameImage = ([&frame]()->QImage
+    {
+        if (!frame)
         {
-            DEBUG(("Requested the scaler output as a QImage while the scaler's output buffer was uninitialized."));
+            DEBUG(("Requested the scaler output as a QImage while the scaler had no output frame."));
             return QImage();
         }
-        else return QImage(fb, r.w, r.h, QImage::Format_RGB32);
+        else return QImage(frame->pixels.ptr(), frame->resolution.w, frame->resolution.h, QImage::Format_RGB32);
     })();
 
     QPainter painter(this);
 
+    // The frame may be smaller than the window if the scaler has left its
+    // upscaling for us to do.
+    const QRect frameRect = scaler_output_frame_rect();
+
     // Draw the frame.
     if (!frameImage.isNull())
     {
-        painter.drawImage(0, 0, frameImage);
+        if (frameImage.size() == frameRect.size())
+        {
+            painter.drawImage(frameRect.topLeft(), frameImage);
+        }
+        else
+        {
+            painter.fillRect(this->rect(), Qt::black);
+            painter.setRenderHint(QPainter::SmoothPixmapTransform, is_renderer_upscale_smoothed());
+            painter.drawImage(frameRect, frameImage);
+        }
     }
 
     // Draw the overlay.
     const QImage overlayImg = overlay_image();
     if (!overlayImg.isNull())
     {
-        painter.drawImage(0, 0, overlayImg);
+        painter.drawImage(overlayImg.offset(), overlayImg);
     }
 
     // Show a magnifying glass effect which blows up part of the captured image.
@@ -1072,8 +1098,14 @@ void MainWindow::paintEvent(QPaintEvent *)
         const QSize magnifiedRegionSize = QSize(40, 30);
         const QSize glassSize = QSize(280, 210);
         const QPoint cursorPos = this->mapFromGlobal(QCursor::pos());
-        QPoint regionTopLeft = QPoint((cursorPos.x() - (magnifiedRegionSize.width() / 2)),
-                                      (cursorPos.y() - (magnifiedRegionSize.height() / 2)));
+
+        // The cursor's position in the frame image, which may be smaller than
+        // the window if its upscaling has been left to the renderer.
+        const QPoint imageCursorPos = QPoint(((cursorPos.x() - frameRect.left()) * frameImage.width() / std::max(1, frameRect.width())),
+                                             ((cursorPos.y() - frameRect.top()) * frameImage.height() / std::max(1, frameRect.height())));
+
+        QPoint regionTopLeft = QPoint((imageCursorPos.x() - (magnifiedRegionSize.width() / 2)),
+                                      (imageCursorPos.y() - (magnifiedRegionSize.height() / 2)));
 
         // Don't let the magnification overflow the image buffer.
         if (regionTopLeft.x() < 0)
@@ -1119,8 +1151,7 @@ void MainWindow::paintEvent(QPaintEvent *)
 
 void MainWindow::measure_framerate()
 {
-    static qint64 elapsed = 0, prevElapsed = 0;
-    static u32 peakProcessTime = 0, avgProcessTime = 0;
+    static qint64 elapsed = 0;
     static u32 numFramesDrawn = 0;
 
     static QElapsedTimer fpsTimer;
@@ -1131,13 +1162,6 @@ void MainWindow::measure_framerate()
 
     elapsed = fpsTimer.elapsed();
 
-    if ((elapsed - prevElapsed) > peakProcessTime)
-    {
-        peakProcessTime = (elapsed - prevElapsed);
-    }
-
-    avgProcessTime += (elapsed - prevElapsed);
-
     numFramesDrawn++;
 
     // Once per second or so update the GUI on capture output performance.
@@ -1145,22 +1169,12 @@ void MainWindow::measure_framerate()
     {
         const int fps = round(1000 / (real(elapsed) / numFramesDrawn));
 
-        UPDATE_LATENCY_AVG = (avgProcessTime / numFramesDrawn);
-        UPDATE_LATENCY_PEAK = peakProcessTime;
-
         this->update_output_framerate(fps, kc_capture_api().get_missed_frames_count());
         kc_capture_api().reset_missed_frames_count();
 
         numFramesDrawn = 0;
-        avgProcessTime = 0;
-        peakProcessTime = 0;
-        prevElapsed = 0;
         fpsTimer.restart();
     }
-    else
-    {
-        prevElapsed = elapsed;
-    }
 
     return;
 }
@@ -1191,6 +1205,9 @@ void MainWindow::set_keyboard_shortcuts(void)
     connect(keyboardShortcut("ctrl+shift+a"), &QShortcut::activated, [=]{this->antitearDlg->set_anti_tear_enabled(!this->antitearDlg->is_anti_tear_enabled());});
     connect(keyboardShortcut("ctrl+shift+r"), &QShortcut::activated, [=]{this->recordDlg->set_recording_enabled(!this->recordDlg->is_recording_enabled());});
 
+    // Save the contents of the replay buffer, if it's active.
+    connect(keyboardShortcut("ctrl+shift+s"), &QShortcut::activated, [=]{this->recordDlg->save_replay();});
+
     // Ctrl + function keys maps to video presets.
     for (uint i = 1; i <= 12; i++)
     {
@@ -1235,11 +1252,10 @@ void MainWindow::disable_output_size_controls(const bool areDisabled)
     return;
 }
 
-FilterGraphNode* MainWindow::add_filter_graph_node(const filter_type_enum_e &filterType,
-                                                   const u8 *const initialParameterValues)
+FilterGraphNode* MainWindow::add_filter_graph_node(const filter_c *const filter)
 {
     k_assert(this->filterGraphDlg != nullptr, "");
-    return this->filterGraphDlg->add_filter_graph_node(filterType, initialParameterValues);
+    return this->filterGraphDlg->add_filter_graph_node(filter);
 }
 
 void MainWindow::update_window_title()
@@ -86,7 +86,7 @@ public:
 
     void recalculate_filter_graph_chains(void);
 
-    FilterGraphNode* add_filter_graph_node(const filter_type_enum_e &filterType, const u8 * const initialParameterValues);
+    FilterGraphNode* add_filter_graph_node(const filter_c *const filter);
 
     void set_filter_graph_source_filename(const std::string &sourceFilename);
 
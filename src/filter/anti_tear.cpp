@@ -9,6 +9,7 @@
  */
 
 #include <cstring>
+#include <mutex>
 #include "filter/anti_tear.h"
 #include "display/display.h"
 #include "capture/capture_api.h"
@@ -47,6 +48,11 @@ static const u32 EXPECTED_BIT_DEPTH = 32;
 
 static bool ANTI_TEARING_ENABLED = false;
 
+// Guards the engine's state, so that frames can be anti-teared on one thread
+// while the settings are changed on another. Recursive, since the setters call
+// on each other's helpers.
+static std::recursive_mutex ANTI_TEAR_MUTEX;
+
 // We'll place the extracted portions of frames into two back buffers. If a frame
 // contains new data both for the previous frame and the next frame, we place the
 // data for the previous frame into one back buffer and the data for the next frame
@@ -102,6 +108,8 @@ static void reset_all_buffers(void)
 
 void kat_set_buffer_updates_disabled(const bool disabled)
 {
+    std::lock_guard<std::recursive_mutex> lock(ANTI_TEAR_MUTEX);
+
     if (PREVENT_BUFFER_RESET && !disabled)
     {
         PREVENT_BUFFER_RESET = false;
@@ -412,6 +420,8 @@ static bool copy_new_frame_data(const captured_frame_s &frame)
 
 void kat_set_anti_tear_enabled(const bool state)
 {
+    std::lock_guard<std::recursive_mutex> lock(ANTI_TEAR_MUTEX);
+
     ANTI_TEARING_ENABLED = state;
 
     reset_all_buffers();
@@ -428,6 +438,8 @@ void kat_set_visualization(const bool visualize,
                            const bool visualizeTear,
                            const bool visualizeRange)
 {
+    std::lock_guard<std::recursive_mutex> lock(ANTI_TEAR_MUTEX);
+
     VISUALIZE = visualize;
     VISUALIZE_TEAR = visualizeTear;
     VISUALIZE_RANGE = visualizeRange;
@@ -437,6 +449,8 @@ void kat_set_visualization(const bool visualize,
 
 void kat_set_range(const u32 min, const u32 max)
 {
+    std::lock_guard<std::recursive_mutex> lock(ANTI_TEAR_MUTEX);
+
     MINY = min;
     MAXY_OFFS = max;
 
@@ -447,6 +461,8 @@ void kat_set_range(const u32 min, const u32 max)
 
 void kat_set_threshold(const u32 t)
 {
+    std::lock_guard<std::recursive_mutex> lock(ANTI_TEAR_MUTEX);
+
     THRESHOLD = t;
 
     reset_all_buffers();
@@ -456,6 +472,8 @@ void kat_set_threshold(const u32 t)
 
 void kat_set_domain_size(const u32 ds)
 {
+    std::lock_guard<std::recursive_mutex> lock(ANTI_TEAR_MUTEX);
+
     DOMAIN_SIZE = ds;
 
     reset_all_buffers();
@@ -465,6 +483,8 @@ void kat_set_domain_size(const u32 ds)
 
 void kat_set_step_size(const u32 s)
 {
+    std::lock_guard<std::recursive_mutex> lock(ANTI_TEAR_MUTEX);
+
     STEP_SIZE = s;
 
     reset_all_buffers();
@@ -474,6 +494,8 @@ void kat_set_step_size(const u32 s)
 
 void kat_set_matches_required(const u32 mr)
 {
+    std::lock_guard<std::recursive_mutex> lock(ANTI_TEAR_MUTEX);
+
     MATCHES_REQD = mr;
 
     reset_all_buffers();
@@ -483,6 +505,8 @@ void kat_set_matches_required(const u32 mr)
 
 u8* kat_anti_tear(u8 *const pixels, const resolution_s &r)
 {
+    std::lock_guard<std::recursive_mutex> lock(ANTI_TEAR_MUTEX);
+
     captured_frame_s frame;
     frame.r = r;
     frame.pixels.point_to(pixels, (frame.r.w * frame.r.h * (frame.r.bpp / 8)));
@@ -600,6 +624,27 @@ u8* kat_anti_tear(u8 *const pixels, const resolution_s &r)
     return pixels;
 }
 
+bool kat_anti_tear_in_place(u8 *const pixels, const resolution_s &r)
+{
+    std::lock_guard<std::recursive_mutex> lock(ANTI_TEAR_MUTEX);
+
+    const u8 *const result = kat_anti_tear(pixels, r);
+
+    if (!result)
+    {
+        return false;
+    }
+
+    // The result may point into the engine's back buffers, which the next call
+    // will overwrite; so copy it out while we still hold the lock.
+    if (result != pixels)
+    {
+        memcpy(pixels, result, (r.w * r.h * (r.bpp / 8)));
+    }
+
+    return true;
+}
+
 void kat_initialize_anti_tear(void)
 {
     const resolution_s &maxres = kc_capture_api().get_maximum_resolution();
@@ -632,6 +677,8 @@ const anti_tear_options_s& kat_default_settings(void)
 
 void kat_release_anti_tear(void)
 {
+    std::lock_guard<std::recursive_mutex> lock(ANTI_TEAR_MUTEX);
+
     DEBUG(("Releasing the anti-tear engine."));
 
     BACK_BUFFER_STORAGE.release_memory();
@@ -48,6 +48,11 @@ void kat_set_range(const u32 min, const u32 max);
 
 u8 *kat_anti_tear(u8 *const pixels, const resolution_s &r);
 
+// Like kat_anti_tear(), but places the anti-teared frame into the given pixel
+// buffer. Returns false, leaving the buffer untouched, if no frame was ready for
+// display. Can be called from any thread.
+bool kat_anti_tear_in_place(u8 *const pixels, const resolution_s &r);
+
 void kat_set_anti_tear_enabled(const bool state);
 
 bool kat_is_anti_tear_enabled(void);
@@ -8,11 +8,14 @@
  */
 
 #include <unordered_map>
+#include <algorithm>
 #include <cstring>
 #include <vector>
 #include <cmath>
+#include <mutex>
 #include <map>
 #include "display/qt/widgets/filter_widgets.h"
+#include "common/telemetry/telemetry.h"
 #include "display/display.h"
 #include "capture/capture.h"
 #include "common/globals.h"
@@ -22,6 +25,14 @@
 // Whether filters (if any are activated) should be applied to incoming frames.
 static bool FILTERING_ENABLED = false;
 
+// Whether filters that only analyze frames - e.g. drawing a histogram over them -
+// rather than alter their image should be left out when applying filter chains.
+static bool SKIP_ANALYSIS_FILTERS = false;
+
+// Whether filters that allow it may be applied after downscaling a frame rather
+// than before, when that's cheaper.
+static bool REORDERING_ENABLED = false;
+
 // All filter types available to the user.
 //
 // Note: Each filter is identified by a UUID string. A UUID must be unique to a filter.
@@ -30,21 +41,21 @@ static bool FILTERING_ENABLED = false;
 //
 static const std::unordered_map<std::string, const filter_c::filter_metadata_s> KNOWN_FILTER_TYPES =
 {
-    {"a5426f2e-b060-48a9-adf8-1646a2d3bd41", {"Blur",                filter_type_enum_e::blur,                   filter_func_blur                   }},
-    {"fc85a109-c57a-4317-994f-786652231773", {"Delta histogram",     filter_type_enum_e::delta_histogram,        filter_func_delta_histogram        }},
-    {"badb0129-f48c-4253-a66f-b0ec94e225a0", {"Frame rate estimate", filter_type_enum_e::unique_count,           filter_func_unique_count           }},
-    {"03847778-bb9c-4e8c-96d5-0c10335c4f34", {"Unsharp mask",        filter_type_enum_e::unsharp_mask,           filter_func_unsharp_mask           }},
-    {"eb586eb4-2d9d-41b4-9e32-5cbcf0bbbf03", {"Decimate",            filter_type_enum_e::decimate,               filter_func_decimate               }},
-    {"94adffac-be42-43ac-9839-9cc53a6d615c", {"Denoise (temporal)",  filter_type_enum_e::denoise_temporal,       filter_func_denoise_temporal       }},
-    {"e31d5ee3-f5df-4e7c-81b8-227fc39cbe76", {"Denoise (NL means)",  filter_type_enum_e::denoise_nonlocal_means, filter_func_denoise_nonlocal_means }},
-    {"1c25bbb1-dbf4-4a03-93a1-adf24b311070", {"Sharpen",             filter_type_enum_e::sharpen,                filter_func_sharpen                }},
-    {"de60017c-afe5-4e5e-99ca-aca5756da0e8", {"Median",              filter_type_enum_e::median,                 filter_func_median                 }},
-    {"2448cf4a-112d-4d70-9fc1-b3e9176b6684", {"Crop",                filter_type_enum_e::crop,                   filter_func_crop                   }},
-    {"80a3ac29-fcec-4ae0-ad9e-bbd8667cc680", {"Flip",                filter_type_enum_e::flip,                   filter_func_flip                   }},
-    {"140c514d-a4b0-4882-abc6-b4e9e1ff4451", {"Rotate",              filter_type_enum_e::rotate,                 filter_func_rotate                 }},
-
-    {"136deb34-ac79-46b1-a09c-d57dcfaa84ad", {"Input gate",          filter_type_enum_e::input_gate,             nullptr                            }},
-    {"be8443e2-4355-40fd-aded-63cebcbfb8ce", {"Output gate",         filter_type_enum_e::output_gate,            nullptr                            }},
+    {"a5426f2e-b060-48a9-adf8-1646a2d3bd41", {"Blur",                filter_type_enum_e::blur,                   filter_func_blur,                   true,  filter_halo_blur                   }},
+    {"fc85a109-c57a-4317-994f-786652231773", {"Delta histogram",     filter_type_enum_e::delta_histogram,        filter_func_delta_histogram,        false, nullptr                            }},
+    {"badb0129-f48c-4253-a66f-b0ec94e225a0", {"Frame rate estimate", filter_type_enum_e::unique_count,           filter_func_unique_count,           false, nullptr                            }},
+    {"03847778-bb9c-4e8c-96d5-0c10335c4f34", {"Unsharp mask",        filter_type_enum_e::unsharp_mask,           filter_func_unsharp_mask,           true,  filter_halo_unsharp_mask           }},
+    {"eb586eb4-2d9d-41b4-9e32-5cbcf0bbbf03", {"Decimate",            filter_type_enum_e::decimate,               filter_func_decimate,               false, nullptr                            }},
+    {"94adffac-be42-43ac-9839-9cc53a6d615c", {"Denoise (temporal)",  filter_type_enum_e::denoise_temporal,       filter_func_denoise_temporal,       false, nullptr                            }},
+    {"e31d5ee3-f5df-4e7c-81b8-227fc39cbe76", {"Denoise (NL means)",  filter_type_enum_e::denoise_nonlocal_means, filter_func_denoise_nonlocal_means, true,  filter_halo_denoise_nonlocal_means }},
+    {"1c25bbb1-dbf4-4a03-93a1-adf24b311070", {"Sharpen",             filter_type_enum_e::sharpen,                filter_func_sharpen,                true,  filter_halo_sharpen                }},
+    {"de60017c-afe5-4e5e-99ca-aca5756da0e8", {"Median",              filter_type_enum_e::median,                 filter_func_median,                 true,  filter_halo_median                 }},
+    {"2448cf4a-112d-4d70-9fc1-b3e9176b6684", {"Crop",                filter_type_enum_e::crop,                   filter_func_crop,                   false, nullptr                            }},
+    {"80a3ac29-fcec-4ae0-ad9e-bbd8667cc680", {"Flip",                filter_type_enum_e::flip,                   filter_func_flip,                   true,  nullptr                            }},
+    {"140c514d-a4b0-4882-abc6-b4e9e1ff4451", {"Rotate",              filter_type_enum_e::rotate,                 filter_func_rotate,                 true,  nullptr                            }},
+
+    {"136deb34-ac79-46b1-a09c-d57dcfaa84ad", {"Input gate",          filter_type_enum_e::input_gate,             nullptr,                            false, nullptr                            }},
+    {"be8443e2-4355-40fd-aded-63cebcbfb8ce", {"Output gate",         filter_type_enum_e::output_gate,            nullptr,                            false, nullptr                            }},
 };
 
 // All filters the user has added to the filter graph.
@@ -60,6 +71,16 @@ static std::vector<std::vector<const filter_c*>> FILTER_CHAINS;
 // resolution.
 static int MOST_RECENT_FILTER_CHAIN_IDX = -1;
 
+// Incremented whenever FILTER_CHAINS is modified, so that a filter_chain_split_s
+// made of an earlier version of the chains can be told apart.
+static u64 FILTER_CHAINS_GENERATION = 0;
+
+// Held while the filter chains are being applied to a frame, and while the chains
+// or the filter instances they refer to are being modified; since frames may be
+// filtered on a thread of their own. Recursive, as modifying the filters can have
+// the GUI recalculate the chains.
+static std::recursive_mutex FILTERS_MUTEX;
+
 std::string kf_filter_name_for_type(const filter_type_enum_e type)
 {
     for (const auto filterType: KNOWN_FILTER_TYPES)
@@ -100,36 +121,57 @@ std::string kf_filter_id_for_type(const filter_type_enum_e type)
     return "(unknown)";
 }
 
-// Apply to the given pixel buffer the chain of filters (if any) whose input gate
-// matches the frame's resolution and output gate that of the current output resolution.
-void kf_apply_filter_chain(u8 *const pixels, const resolution_s &r)
+// Returns the telemetry stage under which applications of filters of the given
+// type are timed.
+static telemetry_stage_s* filter_telemetry_stage(const filter_c::filter_metadata_s &filterType)
 {
-    if (!FILTERING_ENABLED) return;
+    static std::unordered_map<const filter_c::filter_metadata_s*, telemetry_stage_s*> stages;
 
-    k_assert((r.bpp == 32), "Filters can only be applied to 32-bit pixel data.");
+    const auto stage = stages.find(&filterType);
+    if (stage != stages.end())
+    {
+        return stage->second;
+    }
 
-    std::pair<const std::vector<const filter_c*>*, unsigned> partialMatch = {nullptr, 0};
-    std::pair<const std::vector<const filter_c*>*, unsigned> openMatch = {nullptr, 0};
-    const resolution_s outputRes = ks_output_resolution();
+    return (stages[&filterType] = ktelemetry_stage("Filter: " + filterType.name));
+}
 
-    static const auto apply_chain = [=](const std::vector<const filter_c*> &chain, const unsigned idx)
-    {
-        // The gate filters are expected to be #first and #last, while the actual
-        // applicable filters are the ones in-between.
-        for (unsigned c = 1; c < (chain.size() - 1); c++)
-        {
-            chain[c]->metaData.apply(pixels, &r, chain[c]->parameterData.ptr());
-        }
+static bool is_analysis_filter(const filter_type_enum_e type)
+{
+    return ((type == filter_type_enum_e::delta_histogram) ||
+            (type == filter_type_enum_e::unique_count));
+}
 
-        MOST_RECENT_FILTER_CHAIN_IDX = idx;
+// Returns true if filters of the given type keep, from one frame to the next,
+// state that depends on the order in which the frames are filtered.
+static bool is_stateful_filter(const filter_type_enum_e type)
+{
+    return ((type == filter_type_enum_e::denoise_temporal) ||
+            (type == filter_type_enum_e::delta_histogram) ||
+            (type == filter_type_enum_e::unique_count));
+}
 
-        return;
-    };
+// A filter copied out of its chain, so that it can be applied without holding
+// FILTERS_MUTEX - and so by several threads at once - while the chain remains
+// free to be modified.
+struct filter_copy_s
+{
+    const filter_c::filter_metadata_s *metaData;
+    telemetry_stage_s *telemetryStage;
+    std::vector<u8> parameterData;
+};
+
+// Returns the first filter chain, if any, whose input and output resolution matches
+// the given frame and output resolution, along with the chain's index. If no such
+// chain is found, returns secondarily a matching partially or fully open chain (a
+// chain being open if its input or output node's resolution contains one or more 0
+// values). Expects FILTERS_MUTEX to be held.
+static std::pair<const std::vector<const filter_c*>*, unsigned> matching_filter_chain(const resolution_s &r,
+                                                                                      const resolution_s &outputRes)
+{
+    std::pair<const std::vector<const filter_c*>*, unsigned> partialMatch = {nullptr, 0};
+    std::pair<const std::vector<const filter_c*>*, unsigned> openMatch = {nullptr, 0};
 
-    // Apply the first filter chain, if any, whose input and output resolution matches
-    // those of the frame and the current scaler. If no such chain is found, we'll secondarily
-    // apply a matching partially or fully open chain (a chain being open if its input or
-    // output node's resolution contains one or more 0 values).
     for (unsigned i = 0; i < FILTER_CHAINS.size(); i++)
     {
         const auto &filterChain = FILTER_CHAINS[i];
@@ -161,21 +203,291 @@ void kf_apply_filter_chain(u8 *const pixels, const resolution_s &r)
                  (outputRes.w == outputGateWidth) &&
                  (outputRes.h == outputGateHeight))
         {
-            apply_chain(filterChain, i);
+            return {&filterChain, i};
+        }
+    }
 
-            return;
+    return (partialMatch.first? partialMatch : openMatch);
+}
+
+// Returns how many of the filters at the end of the given chain are to be applied
+// to a frame of resolution r after, rather than before, it's scaled to the given
+// output resolution. Expects FILTERS_MUTEX to be held.
+static unsigned num_post_scaling_filters(const std::vector<const filter_c*> &chain,
+                                         const resolution_s &r,
+                                         const resolution_s &outputRes)
+{
+    if (!REORDERING_ENABLED)
+    {
+        return 0;
+    }
+
+    // We estimate a filter's cost as proportional to the number of pixels it
+    // processes, so it's cheaper to apply after scaling only if the scaling
+    // reduces the pixel count; i.e. when downscaling. When upscaling, filters
+    // are already applied before the scaling.
+    if ((u64(outputRes.w) * outputRes.h) >= (u64(r.w) * r.h))
+    {
+        return 0;
+    }
+
+    // Only an unbroken run of reorderable filters at the end of the chain can
+    // be moved past the scaling without changing the order of the filters.
+    unsigned numFilters = 0;
+    for (unsigned c = (chain.size() - 2); (c >= 1) && chain[c]->metaData.isReorderable; c--)
+    {
+        numFilters++;
+    }
+
+    return numFilters;
+}
+
+// Returns copies of the filters of the given chain from index first up to but not
+// including index last that are to be applied. Expects FILTERS_MUTEX to be held.
+static std::vector<filter_copy_s> copy_filters(const std::vector<const filter_c*> &chain,
+                                               const unsigned first,
+                                               const unsigned last)
+{
+    std::vector<filter_copy_s> filters;
+
+    for (unsigned c = first; c < last; c++)
+    {
+        if (SKIP_ANALYSIS_FILTERS &&
+            is_analysis_filter(chain[c]->metaData.type))
+        {
+            continue;
+        }
+
+        filters.push_back({&chain[c]->metaData,
+                           filter_telemetry_stage(chain[c]->metaData),
+                           std::vector<u8>(chain[c]->parameterData.ptr(),
+                                           (chain[c]->parameterData.ptr() + chain[c]->parameterData.size()))});
+    }
+
+    return filters;
+}
+
+// Applies the given filters to the given pixels; optionally timing each filter
+// for telemetry.
+static void apply_filters(const std::vector<filter_copy_s> &filters,
+                          u8 *const pixels,
+                          const resolution_s &r,
+                          const bool isTimed = true)
+{
+    for (const auto &filter: filters)
+    {
+        const telemetry_timer_c timer(isTimed? filter.telemetryStage : nullptr);
+
+        filter.metaData->apply(pixels, &r, filter.parameterData.data());
+    }
+
+    return;
+}
+
+// Returns the chain of the given split, or null if the filter chains have been
+// modified since the split was made. Expects FILTERS_MUTEX to be held.
+static const std::vector<const filter_c*>* split_filter_chain(const filter_chain_split_s &split)
+{
+    if ((split.chainIdx < 0) ||
+        (split.chainsGeneration != FILTER_CHAINS_GENERATION) ||
+        (unsigned(split.chainIdx) >= FILTER_CHAINS.size()))
+    {
+        return nullptr;
+    }
+
+    return &FILTER_CHAINS[split.chainIdx];
+}
+
+filter_chain_split_s kf_filter_chain_split(const resolution_s &r, const resolution_s &outputRes)
+{
+    std::lock_guard<std::recursive_mutex> lock(FILTERS_MUTEX);
+
+    filter_chain_split_s split;
+
+    if (!FILTERING_ENABLED) return split;
+
+    const auto match = matching_filter_chain(r, outputRes);
+
+    if (match.first)
+    {
+        const auto &chain = *match.first;
+
+        split.chainIdx = int(match.second);
+        split.chainsGeneration = FILTER_CHAINS_GENERATION;
+        split.outputGateIdx = (chain.size() - 1);
+        split.postScalingIdx = (split.outputGateIdx - num_post_scaling_filters(chain, r, outputRes));
+    }
+
+    return split;
+}
+
+// Returns copies of the filters that the given split applies before scaling, or
+// none if the filter chains have been modified since the split was made.
+static std::vector<filter_copy_s> copy_pre_scaling_filters(const filter_chain_split_s &split)
+{
+    std::lock_guard<std::recursive_mutex> lock(FILTERS_MUTEX);
+
+    if (const auto chain = split_filter_chain(split))
+    {
+        MOST_RECENT_FILTER_CHAIN_IDX = split.chainIdx;
+
+        // The gate filters are expected to be #first and #last, while the actual
+        // applicable filters are the ones in-between.
+        return copy_filters(*chain, 1, split.postScalingIdx);
+    }
+
+    return {};
+}
+
+// Apply to the given pixel buffer the chain of filters (if any) whose input gate
+// matches the frame's resolution and output gate the given output resolution;
+// except for any filters that are to be applied after scaling.
+filter_chain_split_s kf_apply_filter_chain(u8 *const pixels, const resolution_s &r, const resolution_s &outputRes)
+{
+    const filter_chain_split_s split = kf_filter_chain_split(r, outputRes);
+
+    kf_apply_pre_scaling_filters(pixels, r, split);
+
+    return split;
+}
+
+void kf_apply_pre_scaling_filters(u8 *const pixels,
+                                  const resolution_s &r,
+                                  const filter_chain_split_s &split)
+{
+    if (split.chainIdx < 0) return;
+
+    k_assert((r.bpp == 32), "Filters can only be applied to 32-bit pixel data.");
+
+    apply_filters(copy_pre_scaling_filters(split), pixels, r);
+
+    return;
+}
+
+bool kf_is_filter_chain_stateless(const filter_chain_split_s &split)
+{
+    std::lock_guard<std::recursive_mutex> lock(FILTERS_MUTEX);
+
+    if (split.chainIdx < 0) return true;
+
+    const auto chain = split_filter_chain(split);
+
+    if (!chain)
+    {
+        return false;
+    }
+
+    for (unsigned c = 1; c < split.postScalingIdx; c++)
+    {
+        if (is_stateful_filter((*chain)[c]->metaData.type) &&
+            (!SKIP_ANALYSIS_FILTERS || !is_analysis_filter((*chain)[c]->metaData.type)))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int kf_filter_chain_band_halo(const filter_chain_split_s &split)
+{
+    std::lock_guard<std::recursive_mutex> lock(FILTERS_MUTEX);
+
+    if (split.chainIdx < 0) return 0;
+
+    const auto chain = split_filter_chain(split);
+
+    if (!chain)
+    {
+        return -1;
+    }
+
+    int halo = 0;
+
+    // The rows a filter reads beyond the band have to themselves have been
+    // produced by the preceding filters, so the halos add up.
+    for (unsigned c = 1; c < split.postScalingIdx; c++)
+    {
+        if (SKIP_ANALYSIS_FILTERS &&
+            is_analysis_filter((*chain)[c]->metaData.type))
+        {
+            continue;
+        }
+
+        if (!(*chain)[c]->metaData.bandHalo)
+        {
+            return -1;
         }
+
+        halo += (*chain)[c]->metaData.bandHalo((*chain)[c]->parameterData.ptr());
     }
 
-    if (partialMatch.first)
+    return halo;
+}
+
+bool kf_is_filter_chain_active(const resolution_s &r, const resolution_s &outputRes)
+{
+    std::lock_guard<std::recursive_mutex> lock(FILTERS_MUTEX);
+
+    if (!FILTERING_ENABLED) return false;
+
+    const auto match = matching_filter_chain(r, outputRes);
+
+    if (!match.first)
     {
-        apply_chain(*partialMatch.first, partialMatch.second);
+        return false;
     }
-    else if (openMatch.first)
+
+    const auto &chain = *match.first;
+
+    for (unsigned c = 1; c < (chain.size() - 1); c++)
     {
-        apply_chain(*openMatch.first, openMatch.second);
+        if (!SKIP_ANALYSIS_FILTERS ||
+            !is_analysis_filter(chain[c]->metaData.type))
+        {
+            return true;
+        }
     }
 
+    return false;
+}
+
+void kf_apply_filter_chain_to_band(u8 *const pixels,
+                                   const resolution_s &bandRes,
+                                   const filter_chain_split_s &split)
+{
+    if (split.chainIdx < 0) return;
+
+    k_assert((bandRes.bpp == 32), "Filters can only be applied to 32-bit pixel data.");
+
+    // The filters are applied once per band, so timing each application would
+    // misrepresent the filters' per-frame cost.
+    apply_filters(copy_pre_scaling_filters(split), pixels, bandRes, false);
+
+    return;
+}
+
+void kf_apply_post_scaling_filters(u8 *const pixels,
+                                   const resolution_s &scaledRes,
+                                   const filter_chain_split_s &split)
+{
+    if (!split.has_post_scaling_filters()) return;
+
+    k_assert((scaledRes.bpp == 32), "Filters can only be applied to 32-bit pixel data.");
+
+    std::vector<filter_copy_s> filters;
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(FILTERS_MUTEX);
+
+        if (const auto chain = split_filter_chain(split))
+        {
+            filters = copy_filters(*chain, split.postScalingIdx, split.outputGateIdx);
+        }
+    }
+
+    apply_filters(filters, pixels, scaledRes);
+
     return;
 }
 
@@ -193,6 +505,8 @@ std::vector<const filter_c::filter_metadata_s*> kf_known_filter_types(void)
 
 void kf_add_filter_chain(std::vector<const filter_c*> newChain)
 {
+    std::lock_guard<std::recursive_mutex> lock(FILTERS_MUTEX);
+
     k_assert((newChain.size() >= 2) &&
              (newChain.at(0)->metaData.type == filter_type_enum_e::input_gate) &&
              (newChain.at(newChain.size()-1)->metaData.type == filter_type_enum_e::output_gate),
@@ -203,9 +517,77 @@ void kf_add_filter_chain(std::vector<const filter_c*> newChain)
     return;
 }
 
+void kf_recalculate_filter_chains(const std::vector<filter_graph_node_s> &graphNodes)
+{
+    std::lock_guard<std::recursive_mutex> lock(FILTERS_MUTEX);
+
+    kf_remove_all_filter_chains();
+
+    // Follows the graph's connections depth-first from the given node, adding a
+    // filter chain for each path that ends in an output gate.
+    const std::function<void(const unsigned, std::vector<unsigned>, std::vector<const filter_c*>)> traverse_node =
+          [&](const unsigned nodeIdx, std::vector<unsigned> visitedNodes, std::vector<const filter_c*> accumulatedFilterChain)
+    {
+        k_assert((nodeIdx < graphNodes.size()), "Trying to visit an invalid node.");
+
+        const filter_graph_node_s &node = graphNodes[nodeIdx];
+
+        if (std::find(visitedNodes.begin(), visitedNodes.end(), nodeIdx) != visitedNodes.end())
+        {
+            kd_show_headless_error_message("VCS detected a potential infinite loop",
+                                           "One or more filter chains in the filter graph are connected in a loop "
+                                           "(a node's output connects back to its input).\n\nChains containing an "
+                                           "infinite loop will remain unusable until the loop is disconnected.");
+
+            return;
+        }
+
+        visitedNodes.push_back(nodeIdx);
+
+        if (node.isEnabled)
+        {
+            accumulatedFilterChain.push_back(node.filter);
+        }
+
+        if (node.filter->metaData.type == filter_type_enum_e::output_gate)
+        {
+            // A chain whose gates have been disabled can't be told apart from
+            // a malformed one, so we don't add it.
+            if ((accumulatedFilterChain.size() >= 2) &&
+                (accumulatedFilterChain.front()->metaData.type == filter_type_enum_e::input_gate) &&
+                (accumulatedFilterChain.back()->metaData.type == filter_type_enum_e::output_gate))
+            {
+                kf_add_filter_chain(accumulatedFilterChain);
+            }
+
+            return;
+        }
+
+        for (const unsigned targetIdx: node.outputConnections)
+        {
+            traverse_node(targetIdx, visitedNodes, accumulatedFilterChain);
+        }
+
+        return;
+    };
+
+    for (unsigned i = 0; i < graphNodes.size(); i++)
+    {
+        if (graphNodes[i].filter->metaData.type == filter_type_enum_e::input_gate)
+        {
+            traverse_node(i, {}, {});
+        }
+    }
+
+    return;
+}
+
 void kf_remove_all_filter_chains(void)
 {
+    std::lock_guard<std::recursive_mutex> lock(FILTERS_MUTEX);
+
     FILTER_CHAINS.clear();
+    FILTER_CHAINS_GENERATION++;
     MOST_RECENT_FILTER_CHAIN_IDX = -1;
 
     return;
@@ -213,6 +595,8 @@ void kf_remove_all_filter_chains(void)
 
 const filter_c* kf_create_new_filter_instance(const char *const id)
 {
+    std::lock_guard<std::recursive_mutex> lock(FILTERS_MUTEX);
+
     filter_c *filter = new filter_c(id);
 
     FILTER_POOL.push_back(filter);
@@ -222,12 +606,17 @@ const filter_c* kf_create_new_filter_instance(const char *const id)
 
 void kf_delete_filter_instance(const filter_c *const filter)
 {
+    std::lock_guard<std::recursive_mutex> lock(FILTERS_MUTEX);
+
     const auto entry = std::find(FILTER_POOL.begin(), FILTER_POOL.end(), filter);
 
     if (entry != FILTER_POOL.end())
     {
         delete (*entry);
         FILTER_POOL.erase(entry);
+
+        // A chain may still refer to the filter.
+        FILTER_CHAINS_GENERATION++;
     }
 
     return;
@@ -236,6 +625,8 @@ void kf_delete_filter_instance(const filter_c *const filter)
 const filter_c* kf_create_new_filter_instance(const filter_type_enum_e type,
                                               const u8 *const initialParameterValues)
 {
+    std::lock_guard<std::recursive_mutex> lock(FILTERS_MUTEX);
+
     filter_c *newFilterInstance = nullptr;
 
     for (const auto filter: KNOWN_FILTER_TYPES)
@@ -256,6 +647,8 @@ const filter_c* kf_create_new_filter_instance(const filter_type_enum_e type,
 
 void kf_delete_filter(const filter_c *const filter)
 {
+    std::lock_guard<std::recursive_mutex> lock(FILTERS_MUTEX);
+
     const auto filterEntry = std::find(FILTER_POOL.begin(), FILTER_POOL.end(), filter);
 
     k_assert(filterEntry != FILTER_POOL.end(),"Was asked to delete an unknown filter.");
@@ -271,7 +664,10 @@ void kf_release_filters(void)
 {
     DEBUG(("Releasing custom filtering."));
 
+    std::lock_guard<std::recursive_mutex> lock(FILTERS_MUTEX);
+
     MOST_RECENT_FILTER_CHAIN_IDX = -1;
+    FILTER_CHAINS_GENERATION++;
 
     for (auto filter: FILTER_POOL)
     {
@@ -283,6 +679,8 @@ void kf_release_filters(void)
 
 void kf_set_filtering_enabled(const bool enabled)
 {
+    std::lock_guard<std::recursive_mutex> lock(FILTERS_MUTEX);
+
     FILTERING_ENABLED = enabled;
 
     return;
@@ -293,6 +691,29 @@ bool kf_is_filtering_enabled(void)
     return FILTERING_ENABLED;
 }
 
+void kf_set_filter_reordering_enabled(const bool enabled)
+{
+    std::lock_guard<std::recursive_mutex> lock(FILTERS_MUTEX);
+
+    REORDERING_ENABLED = enabled;
+
+    return;
+}
+
+bool kf_is_filter_reordering_enabled(void)
+{
+    return REORDERING_ENABLED;
+}
+
+void kf_set_analysis_filters_skipped(const bool skipped)
+{
+    std::lock_guard<std::recursive_mutex> lock(FILTERS_MUTEX);
+
+    SKIP_ANALYSIS_FILTERS = skipped;
+
+    return;
+}
+
 // Find by how many pixels the given image is out of alignment with the
 // edges of the capture screen vertically and horizontally, by counting how
 // many vertical/horizontal columns/rows at the edges of the image contain
@@ -385,9 +806,17 @@ void kf_initialize_filters(void)
 
 filter_c::filter_c(const std::string &id, const u8 *initialParameterValues) :
     metaData(KNOWN_FILTER_TYPES.at(id)),
-    parameterData(heap_bytes_s<u8>(FILTER_PARAMETER_ARRAY_LENGTH, "Filter parameter data")),
-    guiWidget(create_gui_widget(initialParameterValues))
+    parameterData(heap_bytes_s<u8>(FILTER_PARAMETER_ARRAY_LENGTH, "Filter parameter data"))
 {
+    if (initialParameterValues)
+    {
+        memcpy(this->parameterData.ptr(), initialParameterValues, FILTER_PARAMETER_ARRAY_LENGTH);
+    }
+    else
+    {
+        this->reset_parameter_data();
+    }
+
     return;
 }
 
@@ -399,32 +828,68 @@ filter_c::~filter_c()
     return;
 }
 
-filter_widget_s *filter_c::create_gui_widget(const u8 *const initialParameterValues)
+filter_widget_s* filter_c::gui_widget(void) const
+{
+    if (!this->guiWidget)
+    {
+        this->guiWidget = this->create_gui_widget();
+    }
+
+    return this->guiWidget;
+}
+
+void filter_c::reset_parameter_data(void)
 {
     u8 *const paramArray = this->parameterData.ptr();
 
-    #define arguments paramArray, initialParameterValues
+    switch (this->metaData.type)
+    {
+        case filter_type_enum_e::blur:                   filter_widget_blur_s::reset_parameter_data(paramArray); break;
+        case filter_type_enum_e::rotate:                 filter_widget_rotate_s::reset_parameter_data(paramArray); break;
+        case filter_type_enum_e::crop:                   filter_widget_crop_s::reset_parameter_data(paramArray); break;
+        case filter_type_enum_e::flip:                   filter_widget_flip_s::reset_parameter_data(paramArray); break;
+        case filter_type_enum_e::median:                 filter_widget_median_s::reset_parameter_data(paramArray); break;
+        case filter_type_enum_e::denoise_temporal:       filter_widget_denoise_temporal_s::reset_parameter_data(paramArray); break;
+        case filter_type_enum_e::denoise_nonlocal_means: filter_widget_denoise_nonlocal_means_s::reset_parameter_data(paramArray); break;
+        case filter_type_enum_e::sharpen:                filter_widget_sharpen_s::reset_parameter_data(paramArray); break;
+        case filter_type_enum_e::unsharp_mask:           filter_widget_unsharp_mask_s::reset_parameter_data(paramArray); break;
+        case filter_type_enum_e::decimate:               filter_widget_decimate_s::reset_parameter_data(paramArray); break;
+        case filter_type_enum_e::delta_histogram:        filter_widget_delta_histogram_s::reset_parameter_data(paramArray); break;
+        case filter_type_enum_e::unique_count:           filter_widget_unique_count_s::reset_parameter_data(paramArray); break;
+
+        case filter_type_enum_e::input_gate:             filter_widget_input_gate_s::reset_parameter_data(paramArray); break;
+        case filter_type_enum_e::output_gate:            filter_widget_output_gate_s::reset_parameter_data(paramArray); break;
+
+        default: k_assert(0, "No default parameters are yet available for the given filter type.");
+    }
+
+    return;
+}
+
+filter_widget_s *filter_c::create_gui_widget(void) const
+{
+    u8 *const paramArray = this->parameterData.ptr();
 
     switch (this->metaData.type)
     {
-        case filter_type_enum_e::blur:                   return new filter_widget_blur_s(arguments);
-        case filter_type_enum_e::rotate:                 return new filter_widget_rotate_s(arguments);
-        case filter_type_enum_e::crop:                   return new filter_widget_crop_s(arguments);
-        case filter_type_enum_e::flip:                   return new filter_widget_flip_s(arguments);
-        case filter_type_enum_e::median:                 return new filter_widget_median_s(arguments);
-        case filter_type_enum_e::denoise_temporal:       return new filter_widget_denoise_temporal_s(arguments);
-        case filter_type_enum_e::denoise_nonlocal_means: return new filter_widget_denoise_nonlocal_means_s(arguments);
-        case filter_type_enum_e::sharpen:                return new filter_widget_sharpen_s(arguments);
-        case filter_type_enum_e::unsharp_mask:           return new filter_widget_unsharp_mask_s(arguments);
-        case filter_type_enum_e::decimate:               return new filter_widget_decimate_s(arguments);
-        case filter_type_enum_e::delta_histogram:        return new filter_widget_delta_histogram_s(arguments);
-        case filter_type_enum_e::unique_count:           return new filter_widget_unique_count_s(arguments);
-
-        case filter_type_enum_e::input_gate:             return new filter_widget_input_gate_s(arguments);
-        case filter_type_enum_e::output_gate:            return new filter_widget_output_gate_s(arguments);
+        case filter_type_enum_e::blur:                   return new filter_widget_blur_s(paramArray);
+        case filter_type_enum_e::rotate:                 return new filter_widget_rotate_s(paramArray);
+        case filter_type_enum_e::crop:                   return new filter_widget_crop_s(paramArray);
+        case filter_type_enum_e::flip:                   return new filter_widget_flip_s(paramArray);
+        case filter_type_enum_e::median:                 return new filter_widget_median_s(paramArray);
+        case filter_type_enum_e::denoise_temporal:       return new filter_widget_denoise_temporal_s(paramArray);
+        case filter_type_enum_e::denoise_nonlocal_means: return new filter_widget_denoise_nonlocal_means_s(paramArray);
+        case filter_type_enum_e::sharpen:                return new filter_widget_sharpen_s(paramArray);
+        case filter_type_enum_e::unsharp_mask:           return new filter_widget_unsharp_mask_s(paramArray);
+        case filter_type_enum_e::decimate:               return new filter_widget_decimate_s(paramArray);
+        case filter_type_enum_e::delta_histogram:        return new filter_widget_delta_histogram_s(paramArray);
+        case filter_type_enum_e::unique_count:           return new filter_widget_unique_count_s(paramArray);
+
+        case filter_type_enum_e::input_gate:             return new filter_widget_input_gate_s(paramArray);
+        case filter_type_enum_e::output_gate:            return new filter_widget_output_gate_s(paramArray);
 
         default: k_assert(0, "No GUI widget is yet available for the given filter type.");
     }
 
-    #undef arguments
+    return nullptr;
 }
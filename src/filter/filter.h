@@ -23,10 +23,11 @@
  * 
  * The @ref filter_c class is the basic building block of VCS's pixel
  * manipulation capabilities. Each instance of @ref filter_c holds
- * end-user-customizable parameters (like radius for a blur filter) and a GUI
- * widget with which the user can customize those parameters, as well as
- * providing a function with which the filter can be applied to an image's
- * pixels.
+ * end-user-customizable parameters (like radius for a blur filter) and
+ * provides a function with which the filter can be applied to an image's
+ * pixels. A filter's GUI widget, with which the user can customize its
+ * parameters, is only created if and when the GUI asks for it, so filters can
+ * also be created and applied without a GUI.
  * 
  * Instances of @ref filter_c are organized into filter chains, which are
  * end-user-defined collections of one or more filters that together are to be
@@ -39,6 +40,12 @@
  * VCS to  a resolution matching the the output conditions's will have the
  * chain's filters applied to them.
  * 
+ * The end-user defines filter chains in a filter graph, whose nodes are filter
+ * instances and whose edges connect the output of one node to the input of
+ * another. Given a GUI-independent description of such a graph - a list of
+ * @ref filter_graph_node_s - kf_recalculate_filter_chains() derives from it
+ * the corresponding filter chains.
+ * 
  * For each captured frame, before it's been scaled by the scaler subsystem
  * (@ref src/scaler/scaler.h), VCS will pass the frame's pixel data to
  * @ref kf_apply_filter_chain() of the filter subsystem. This function is
@@ -59,7 +66,8 @@
  * 2. Create one or more filters with kf_create_new_filter_instance().
  * 
  * 3. Create filter chains out of the filter instances and pass the chains to
- *    kf_add_filter_chain().
+ *    kf_add_filter_chain(); or pass a filter graph of the instances to
+ *    kf_recalculate_filter_chains().
  * 
  * 4. Pass captured frames to kf_apply_filter_chain() to have the relevant
  *    filter chain's filters be applied to the frames' pixels.
@@ -71,6 +79,7 @@
 #define FILTER_H_
 
 #include <functional>
+#include <vector>
 #include "common/memory/memory_interface.h"
 #include "display/display.h"
 #include "common/globals.h"
@@ -163,6 +172,37 @@ public:
          * e.g. its size.
          */
         std::function<void(FILTER_FUNC_PARAMS)> apply;
+
+        /*!
+         * Whether the filter can be applied to an image after it's been
+         * downscaled, rather than before, when that's cheaper; i.e. whether
+         * the filter works much the same on an image regardless of its
+         * resolution.
+         * 
+         * @note
+         * Filter parameters measured in pixels, like a blur's radius, act on
+         * the resolution at which the filter is applied. Filters whose
+         * parameters refer to specific pixels of the captured image - e.g.
+         * crop - that analyze the captured frames as such, or that keep state
+         * from one frame to the next (e.g. temporal denoising, which compares
+         * each pixel against the previous frame's) shouldn't be reorderable.
+         * 
+         * @see
+         * kf_set_filter_reordering_enabled()
+         */
+        bool isReorderable;
+
+        /*!
+         * A reference to the filter's halo function in the filter functions
+         * interface, @ref src/filter/filter_funcs.h, which returns how many
+         * rows of neighboring pixels the filter reads above and below each row
+         * it produces; or null if the filter can only be applied to a frame as
+         * a whole.
+         * 
+         * @see
+         * kf_apply_filter_chain_to_band()
+         */
+        std::function<int(FILTER_HALO_PARAMS)> bandHalo;
     };
 
     /*!
@@ -182,19 +222,65 @@ public:
     heap_bytes_s<u8> parameterData;
 
     /*!
-     * The filter's GUI widget, which provides the end-user with controls
-     * for adjusting the filter's parameters.
+     * Returns the filter's GUI widget, which provides the end-user with
+     * controls for adjusting the filter's parameters.
+     * 
+     * The widget is created on the first call to this function. Filters that
+     * are never displayed in the GUI - e.g. when VCS is running headless -
+     * thus never have a widget.
      */
-    filter_widget_s *const guiWidget;
+    filter_widget_s* gui_widget(void) const;
 
 private:
+    /*!
+     * Fills @ref parameterData with the filter's default parameter values.
+     */
+    void reset_parameter_data(void);
+
     /*!
      * Creates and returns an instance of a GUI widget for this filter.
      * 
      * The base implementations of filters' GUI widgets can be found in
      * @ref src/display/qt/widgets/filter_widgets.cpp.
      */
-    filter_widget_s* create_gui_widget(const u8 *const initialParameterValues = nullptr);
+    filter_widget_s* create_gui_widget(void) const;
+
+    /*!
+     * The filter's GUI widget, if it has been created; @a nullptr otherwise.
+     * 
+     * @see
+     * gui_widget()
+     */
+    mutable filter_widget_s *guiWidget = nullptr;
+};
+
+/*!
+ * @brief
+ * A node in a filter graph.
+ * 
+ * Pairs an instance of @ref filter_c with the connections from the node's
+ * output to the inputs of other nodes in the graph. A list of these nodes
+ * describes a filter graph independently of how - or whether - the GUI
+ * displays it.
+ * 
+ * @see
+ * kf_recalculate_filter_chains()
+ */
+struct filter_graph_node_s
+{
+    const filter_c *filter;
+
+    /*!
+     * A disabled node passes frames through without applying its filter to
+     * them.
+     */
+    bool isEnabled;
+
+    /*!
+     * The nodes to whose input this node's output is connected, as indices
+     * into the list of nodes that make up the graph.
+     */
+    std::vector<unsigned> outputConnections;
 };
 
 /*!
@@ -240,6 +326,23 @@ void kf_add_filter_chain(std::vector<const filter_c*> newChain);
  */
 void kf_remove_all_filter_chains(void);
 
+/*!
+ * Asks the filter subsystem to replace its list of known filter chains with the
+ * chains formed by the given filter graph.
+ * 
+ * Each path in the graph that leads from an input gate through zero or more
+ * filters into an output gate forms a filter chain; the chain's filters being
+ * those of the enabled nodes along the path. Chains are added in the order in
+ * which their input gates appear in @p graphNodes.
+ * 
+ * Paths that loop back onto themselves are rejected, and the end-user is
+ * notified of them.
+ * 
+ * @see
+ * kf_add_filter_chain(), kf_remove_all_filter_chains()
+ */
+void kf_recalculate_filter_chains(const std::vector<filter_graph_node_s> &graphNodes);
+
 /*!
  * Returns the GUI-displayable name string associated with the given filter
  * type.
@@ -275,17 +378,130 @@ std::string kf_filter_id_for_type(const filter_type_enum_e type);
 filter_type_enum_e kf_filter_type_for_id(const std::string id);
 
 /*!
- * Applies to the @p pixels of an image whose resolution is @p r the first
- * known filter chain whose input condition matches @p r and whose output
- * condition matches VCS's current output resolution as given from
- * ks_output_resolution().
+ * @brief
+ * Which filter chain applies to an image, and which of the chain's filters
+ * are applied to it before and which after it's been scaled.
+ * 
+ * Decided once per image, by kf_filter_chain_split() or
+ * kf_apply_filter_chain(), and passed on to the functions that apply the rest
+ * of the chain; so that the filters are split between them consistently even
+ * if the filter chains or the reordering setting change meanwhile.
+ */
+struct filter_chain_split_s
+{
+    /*! The index of the chain in the list of filter chains; or -1 if no chain
+     *  matched the image. */
+    int chainIdx = -1;
+
+    /*! Which version of the list of filter chains @ref chainIdx refers to. */
+    u64 chainsGeneration = 0;
+
+    /*! The index in the chain of the first filter to be applied after scaling;
+     *  or of the chain's output gate, if none is. */
+    unsigned postScalingIdx = 0;
+
+    /*! The index in the chain of the chain's output gate. */
+    unsigned outputGateIdx = 0;
+
+    bool has_post_scaling_filters(void) const { return ((this->chainIdx >= 0) && (this->postScalingIdx < this->outputGateIdx)); }
+};
+
+/*!
+ * Returns the filter chain that applies to an image of resolution @p r headed
+ * for @p outputRes (normally, that of ks_output_resolution()), and how its
+ * filters are split around the image's scaling: the first known filter chain
+ * whose input condition matches @p r and whose output condition matches
+ * @p outputRes; with, if filter reordering is enabled, the filters at the end
+ * of the chain that are cheaper to apply after scaling left for after it.
+ * 
+ * Can be called from any thread.
+ * 
+ * @see
+ * kf_add_filter_chain(), kf_set_filter_reordering_enabled()
+ */
+filter_chain_split_s kf_filter_chain_split(const resolution_s &r, const resolution_s &outputRes);
+
+/*!
+ * Applies to the @p pixels of an image whose resolution is @p r the filters,
+ * up to the scaling, of the filter chain given by kf_filter_chain_split() for
+ * @p r and @p outputRes; and returns that split, to be passed on to
+ * kf_apply_post_scaling_filters() along with the scaled image.
  * 
  * If no matching filter chain is found, no filter will be applied.
  * 
+ * Can be called from any thread. The filters are applied from copies made at
+ * the start of the call, so the filter chains may be modified meanwhile.
+ */
+filter_chain_split_s kf_apply_filter_chain(u8 *const pixels, const resolution_s &r, const resolution_s &outputRes);
+
+/*!
+ * Applies to the @p pixels of an image whose resolution is @p r the filters
+ * that the given @p split applies before scaling.
+ * 
+ * If the filter chains have been modified since the split was made, does
+ * nothing, as the chain it refers to no longer exists.
+ * 
+ * Can be called from any thread; and, for splits for which
+ * kf_is_filter_chain_stateless() returns true, from several threads at once.
+ */
+void kf_apply_pre_scaling_filters(u8 *const pixels,
+                                  const resolution_s &r,
+                                  const filter_chain_split_s &split);
+
+/*!
+ * Returns true if none of the filters that the given @p split applies before
+ * scaling carry state from one image to the next (as e.g. the temporal
+ * denoiser does), so that successive images can be run through them in any
+ * order, or concurrently. Returns false if the filter chains have been
+ * modified since the split was made.
+ */
+bool kf_is_filter_chain_stateless(const filter_chain_split_s &split);
+
+/*!
+ * Applies to the @p pixels of an image that's been scaled to @p scaledRes
+ * the filters that the given @p split leaves for after scaling.
+ * 
+ * If the filter chains have been modified since the split was made, does
+ * nothing, as the chain it refers to no longer exists.
+ * 
+ * Can be called from any thread.
+ */
+void kf_apply_post_scaling_filters(u8 *const pixels,
+                                   const resolution_s &scaledRes,
+                                   const filter_chain_split_s &split);
+
+/*!
+ * Returns the number of rows of pixels that the filters the given @p split
+ * applies before scaling read, in total, above and below each row they
+ * produce; or -1 if one or more of those filters can only be applied to the
+ * image as a whole, or the filter chains have been modified since the split
+ * was made.
+ * 
  * @see
- * kf_add_filter_chain()
+ * kf_apply_filter_chain_to_band()
+ */
+int kf_filter_chain_band_halo(const filter_chain_split_s &split);
+
+/*!
+ * Returns true if kf_apply_filter_chain() or kf_apply_post_scaling_filters()
+ * would apply any filters to an image of resolution @p r headed for
+ * @p outputRes; false if the image would come out of them unchanged.
  */
-void kf_apply_filter_chain(u8 *const pixels, const resolution_s &r);
+bool kf_is_filter_chain_active(const resolution_s &r, const resolution_s &outputRes);
+
+/*!
+ * Like kf_apply_filter_chain(), but applies the filters that the given
+ * @p split applies before scaling to the @p pixels of a horizontal band, of
+ * resolution @p bandRes, of an image.
+ * 
+ * The band is expected to extend beyond the rows for which results are wanted
+ * by the number of rows given by kf_filter_chain_band_halo(), except where it
+ * meets the image's edge. The filters' results for the extra rows are only
+ * partial and are to be discarded.
+ */
+void kf_apply_filter_chain_to_band(u8 *const pixels,
+                                   const resolution_s &bandRes,
+                                   const filter_chain_split_s &split);
 
 /*!
  * Returns a list of the filter types that're available in the filter
@@ -384,6 +600,28 @@ void kf_set_filtering_enabled(const bool enabled);
  */
 bool kf_is_filtering_enabled(void);
 
+/*!
+ * Sets whether filters that only analyze frames rather than alter their image
+ * - e.g. the delta histogram and frame rate estimate - are to be left out when
+ * applying filter chains; e.g. to save time while VCS is under heavy load.
+ */
+void kf_set_analysis_filters_skipped(const bool skipped);
+
+/*!
+ * Sets whether filters that allow it (see @ref filter_c::filter_metadata_s::isReorderable)
+ * may be applied after rather than before scaling a frame, when that's
+ * estimated to be cheaper; i.e. when the frame is being downscaled.
+ * 
+ * Only an unbroken run of reorderable filters at the end of a filter chain
+ * gets moved, so that the filters' order relative to each other is kept.
+ * 
+ * @see
+ * kf_apply_post_scaling_filters()
+ */
+void kf_set_filter_reordering_enabled(const bool enabled);
+
+bool kf_is_filter_reordering_enabled(void);
+
 /*!
  * @warning
  * This function is scheduled for removal and should not be used.
@@ -6,6 +6,7 @@
  */
 
 #include <ctime>
+#include <cmath>
 #include "common/globals.h"
 #include "display/qt/widgets/filter_widgets.h"
 #include "filter/filter_funcs.h"
@@ -218,14 +219,17 @@ void filter_func_unsharp_mask(FILTER_FUNC_PARAMS)
     VALIDATE_FILTER_INPUT
 
 #ifdef USE_OPENCV
-    static heap_bytes_s<u8> TMP_BUF(MAX_FRAME_SIZE, "Unsharp mask buffer");
+    // Allocated per call, as frames may be filtered on several threads at once.
+    heap_bytes_s<u8> tmpBuf((r->w * r->h * 4), "Unsharp mask buffer");
     const real str = params[filter_widget_unsharp_mask_s::OFFS_STRENGTH] / 100.0;
     const real rad = params[filter_widget_unsharp_mask_s::OFFS_RADIUS] / 10.0;
 
-    cv::Mat tmp = cv::Mat(r->h, r->w, CV_8UC4, TMP_BUF.ptr());
+    cv::Mat tmp = cv::Mat(r->h, r->w, CV_8UC4, tmpBuf.ptr());
     cv::Mat output = cv::Mat(r->h, r->w, CV_8UC4, pixels);
     cv::GaussianBlur(output, tmp, cv::Size(0, 0), rad);
     cv::addWeighted(output, 1 + str, tmp, -str, 0, output);
+
+    tmpBuf.release_memory();
 #endif
 
     return;
@@ -361,17 +365,19 @@ void filter_func_flip(FILTER_FUNC_PARAMS)
 {
     VALIDATE_FILTER_INPUT
 
-    static heap_bytes_s<u8> scratch(MAX_FRAME_SIZE, "Flip filter scratch buffer");
-
     // 0 = vertical, 1 = horizontal, -1 = both.
     const uint axis = ((params[filter_widget_flip_s::OFFS_AXIS] == 2)? -1 : params[filter_widget_flip_s::OFFS_AXIS]);
 
     #ifdef USE_OPENCV
+        heap_bytes_s<u8> scratch((r->w * r->h * 4), "Flip filter scratch buffer");
+
         cv::Mat output = cv::Mat(r->h, r->w, CV_8UC4, pixels);
         cv::Mat temp = cv::Mat(r->h, r->w, CV_8UC4, scratch.ptr());
 
         cv::flip(output, temp, axis);
         temp.copyTo(output);
+
+        scratch.release_memory();
     #else
         (void)axis;
     #endif
@@ -383,18 +389,20 @@ void filter_func_rotate(FILTER_FUNC_PARAMS)
 {
     VALIDATE_FILTER_INPUT
 
-    static heap_bytes_s<u8> scratch(MAX_FRAME_SIZE, "Rotate filter scratch buffer");
-
     const double angle = (*(i16*)&(params[filter_widget_rotate_s::OFFS_ROT]) / 10.0);
     const double scale = (*(i16*)&(params[filter_widget_rotate_s::OFFS_SCALE]) / 100.0);
 
     #ifdef USE_OPENCV
+        heap_bytes_s<u8> scratch((r->w * r->h * 4), "Rotate filter scratch buffer");
+
         cv::Mat output = cv::Mat(r->h, r->w, CV_8UC4, pixels);
         cv::Mat temp = cv::Mat(r->h, r->w, CV_8UC4, scratch.ptr());
 
         cv::Mat transf = cv::getRotationMatrix2D(cv::Point2d((r->w / 2), (r->h / 2)), -angle, scale);
         cv::warpAffine(output, temp, transf, cv::Size(r->w, r->h));
         temp.copyTo(output);
+
+        scratch.release_memory();
     #else
         (void)angle;
         (void)scale;
@@ -439,3 +447,47 @@ void filter_func_blur(FILTER_FUNC_PARAMS)
 
     return;
 }
+
+// The radius, in pixels, of the kernel that OpenCV's GaussianBlur() derives from
+// the given sigma for 8-bit images.
+static int gaussian_kernel_radius(const real sigma)
+{
+    return ((int(std::round(sigma * 3 * 2 + 1)) | 1) / 2);
+}
+
+int filter_halo_blur(FILTER_HALO_PARAMS)
+{
+    const real kernelS = (params[filter_widget_blur_s::OFFS_KERNEL_SIZE] / 10.0);
+
+    if (params[filter_widget_blur_s::OFFS_TYPE] == filter_widget_blur_s::FILTER_TYPE_GAUSSIAN)
+    {
+        return gaussian_kernel_radius(kernelS);
+    }
+    else
+    {
+        return int(kernelS);
+    }
+}
+
+int filter_halo_unsharp_mask(FILTER_HALO_PARAMS)
+{
+    return gaussian_kernel_radius(params[filter_widget_unsharp_mask_s::OFFS_RADIUS] / 10.0);
+}
+
+int filter_halo_sharpen(FILTER_HALO_PARAMS)
+{
+    (void)params;
+
+    return 1;
+}
+
+int filter_halo_median(FILTER_HALO_PARAMS)
+{
+    return (params[filter_widget_median_s::OFFS_KERNEL_SIZE] / 2);
+}
+
+int filter_halo_denoise_nonlocal_means(FILTER_HALO_PARAMS)
+{
+    return ((params[filter_widget_denoise_nonlocal_means_s::OFFS_TEMPLATE_WINDOW_SIZE] / 2) +
+            (params[filter_widget_denoise_nonlocal_means_s::OFFS_SEARCH_WINDOW_SIZE] / 2));
+}
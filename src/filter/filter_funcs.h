@@ -26,4 +26,18 @@ void filter_func_crop(FILTER_FUNC_PARAMS);
 void filter_func_flip(FILTER_FUNC_PARAMS);
 void filter_func_rotate(FILTER_FUNC_PARAMS);
 
+// The parameters that each filter halo function must accept.
+#define FILTER_HALO_PARAMS const u8 *const params/*filter parameters, like a blur's radius*/
+
+// Filter halo functions return the number of rows of pixels above and below a
+// given row that the corresponding filter, with the given parameters, reads
+// to produce that row; so that the filter can be applied to a horizontal band
+// of a frame padded with that many rows of the frame on either side. Filters
+// that need the whole frame have no halo function.
+int filter_halo_blur(FILTER_HALO_PARAMS);
+int filter_halo_unsharp_mask(FILTER_HALO_PARAMS);
+int filter_halo_sharpen(FILTER_HALO_PARAMS);
+int filter_halo_median(FILTER_HALO_PARAMS);
+int filter_halo_denoise_nonlocal_means(FILTER_HALO_PARAMS);
+
 #endif
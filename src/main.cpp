@@ -7,7 +7,6 @@
 #include <chrono>
 #include <thread>
 #include <mutex>
-#include "display/qt/windows/output_window.h"
 #include "common/command_line/command_line.h"
 #include "filter/anti_tear.h"
 #include "common/propagate/app_events.h"
@@ -17,9 +16,14 @@
 #include "common/globals.h"
 #include "capture/alias.h"
 #include "record/record.h"
+#include "record/batch.h"
+#include "record/shm_output.h"
+#include "scaler/quality_governor.h"
+#include "scaler/pipeline.h"
 #include "scaler/scaler.h"
 #include "filter/filter.h"
 #include "capture/video_presets.h"
+#include "common/telemetry/telemetry.h"
 #include "common/memory/memory.h"
 #include "common/disk/disk.h"
 
@@ -32,6 +36,8 @@ static void cleanup_all(void)
     DEBUG(("Received orders to exit. Initiating cleanup."));
 
     kd_release_output_window();
+    kpipeline_release();
+    kshm_release();
     ks_release_scaler();
     kc_release_capture();
     kat_release_anti_tear();
@@ -39,11 +45,18 @@ static void cleanup_all(void)
     kvideopreset_release();
 
     if (krecord_is_recording()) krecord_stop_recording();
+    if (krecord_is_replay_buffer_active()) krecord_stop_replay_buffer();
+
+    ktelemetry_release();
 
     // Call this last.
     kmem_deallocate_memory_cache();
 
     INFO(("Ready to exit."));
+
+    // Call this very last, so that everything above gets logged.
+    klog_release();
+
     return;
 }
 
@@ -77,10 +90,13 @@ static bool initialize_all(void)
     });
 
     if (!PROGRAM_EXIT_REQUESTED) ka_initialize_aliases();
+    if (!PROGRAM_EXIT_REQUESTED) kbatch_initialize(); // Before the recorder, so it can start recording on the first frame.
     if (!PROGRAM_EXIT_REQUESTED) krecord_initialize();
+    if (!PROGRAM_EXIT_REQUESTED) kshm_initialize();
     if (!PROGRAM_EXIT_REQUESTED) klog_initialize();
     if (!PROGRAM_EXIT_REQUESTED) kvideopreset_initialize();
     if (!PROGRAM_EXIT_REQUESTED) ks_initialize_scaler();
+    if (!PROGRAM_EXIT_REQUESTED) kpipeline_initialize();
     if (!PROGRAM_EXIT_REQUESTED) kc_initialize_capture();
     if (!PROGRAM_EXIT_REQUESTED) kat_initialize_anti_tear();
     if (!PROGRAM_EXIT_REQUESTED) kf_initialize_filters();
@@ -127,6 +143,11 @@ static capture_event_e process_next_capture_event(void)
             ke_events().capture.invalidSignal->fire();
             break;
         }
+        case capture_event_e::end_of_input:
+        {
+            ke_events().capture.endOfInput->fire();
+            break;
+        }
         case capture_event_e::sleep:
         {
             std::this_thread::sleep_for(std::chrono::milliseconds(4)); /// TODO. Is 4 the best wait-time?
@@ -153,9 +174,20 @@ static capture_event_e process_next_capture_event(void)
 static void load_user_data(void)
 {
     kdisk_load_video_presets(kcom_params_file_name());
-    kdisk_load_filter_graph(kcom_filters_file_name());
     kdisk_load_aliases(kcom_alias_file_name());
 
+    const auto filterGraph = kdisk_load_filter_graph(kcom_filters_file_name());
+
+    // Without a GUI, there's no other way for the user to turn filtering on.
+    #ifdef VCS_HEADLESS
+        if (!filterGraph.first.empty())
+        {
+            kf_set_filtering_enabled(true);
+        }
+    #else
+        (void)filterGraph;
+    #endif
+
     return;
 }
 
@@ -163,6 +195,8 @@ int main(int argc, char *argv[])
 {
     printf("VCS %s\n---------+\n", PROGRAM_VERSION_STRING);
 
+    ktelemetry_set_thread_name("Main");
+
     // We want to be sure that the capture hardware is released in a controlled
     // manner, if possible, in the event of a runtime failure. (Not releasing the
     // hardware on program termination may cause a degradation in its subsequent
@@ -205,7 +239,12 @@ int main(int argc, char *argv[])
     while (!PROGRAM_EXIT_REQUESTED)
     {
         process_next_capture_event();
+        ke_main_thread_event_queue().process();
+        kpipeline_update();
+        kgovernor_update();
         kd_spin_event_loop();
+        klog_update_gui();
+        ktelemetry_update();
     }
 
     cleanup_all();
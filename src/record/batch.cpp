@@ -0,0 +1,159 @@
+/*
+ * 2020 Tarpeeksi Hyvae Soft
+ *
+ * Software: VCS
+ *
+ */
+
+#include <chrono>
+#include "common/command_line/command_line.h"
+#include "common/propagate/app_events.h"
+#include "capture/capture_api.h"
+#include "capture/capture.h"
+#include "common/globals.h"
+#include "scaler/pipeline.h"
+#include "scaler/scaler.h"
+#include "record/record.h"
+#include "record/batch.h"
+
+static std::string INPUT_FILE_NAME = "";
+
+static u64 NUM_FRAMES_PROCESSED = 0;
+
+// When the first frame came out of the pipeline.
+static std::chrono::steady_clock::time_point START_TIME;
+
+// For reporting the progress once in a while.
+static std::chrono::steady_clock::time_point LATEST_REPORT_TIME;
+static u64 NUM_FRAMES_AT_LATEST_REPORT = 0;
+
+static double frames_per_second(const u64 numFrames, const std::chrono::steady_clock::duration &duration)
+{
+    const double secs = std::chrono::duration<double>(duration).count();
+
+    return ((secs > 0)? (numFrames / secs) : 0);
+}
+
+static void start_recording(void)
+{
+    if (kcom_record_file_name().empty())
+    {
+        return;
+    }
+
+    const resolution_s videoRes = (kcom_record_resolution().w? kcom_record_resolution() : ks_output_resolution());
+    const unsigned inputFrameRate = kc_capture_api().get_refresh_rate().value<unsigned>();
+
+    // Every frame goes into the video, regardless of how fast it was processed.
+    if (!krecord_start_recording(kcom_record_file_name().c_str(),
+                                 videoRes.w, videoRes.h,
+                                 (inputFrameRate? inputFrameRate : kcom_record_frame_rate()),
+                                 false))
+    {
+        NBENE(("Failed to start recording into '%s'. Exiting.", kcom_record_file_name().c_str()));
+        PROGRAM_EXIT_REQUESTED = true;
+    }
+
+    return;
+}
+
+// Once the frames still in the pipeline have come out of it, finishes the batch.
+static void finish_when_pipeline_empty(void)
+{
+    if (!kpipeline_is_empty())
+    {
+        ke_main_thread_event_queue().push(finish_when_pipeline_empty);
+
+        return;
+    }
+
+    // Exiting also has the recorder finish writing the video file before it
+    // returns, rather than in the background.
+    PROGRAM_EXIT_REQUESTED = true;
+
+    if (krecord_is_recording())
+    {
+        krecord_stop_recording();
+    }
+
+    INFO(("Batch: processed %llu frames in %.2f seconds (%.1f FPS).",
+          (unsigned long long)NUM_FRAMES_PROCESSED,
+          std::chrono::duration<double>(std::chrono::steady_clock::now() - START_TIME).count(),
+          frames_per_second(NUM_FRAMES_PROCESSED, (std::chrono::steady_clock::now() - START_TIME))));
+
+    return;
+}
+
+void kbatch_set_input_file_name(const std::string &filename)
+{
+    INPUT_FILE_NAME = filename;
+
+    return;
+}
+
+bool kbatch_is_enabled(void)
+{
+    return !INPUT_FILE_NAME.empty();
+}
+
+const std::string& kbatch_input_file_name(void)
+{
+    return INPUT_FILE_NAME;
+}
+
+void kbatch_initialize(void)
+{
+    if (!kbatch_is_enabled())
+    {
+        return;
+    }
+
+    INFO(("Batch processing '%s'.", INPUT_FILE_NAME.c_str()));
+
+    // Run decoding, the pipeline's stages, and encoding in parallel; and, where
+    // the filters allow, several frames at once through the filters.
+    if (!kpipeline_is_threaded())
+    {
+        kpipeline_set_threaded(true, 0);
+    }
+    kpipeline_set_frame_parallel_filtering(true);
+    kpipeline_set_lossless(true);
+
+    // Recording starts with the first frame out of the scaler, so have the
+    // scaler produce that frame at the video's resolution, too.
+    if (!kcom_record_file_name().empty() &&
+        kcom_record_resolution().w)
+    {
+        ks_set_extra_output_resolution(scaler_output_e::recording, {kcom_record_resolution().w, kcom_record_resolution().h, 24});
+    }
+
+    ke_events().scaler.newFrame->subscribe([](const std::shared_ptr<const scaled_frame_s>&)
+    {
+        const auto now = std::chrono::steady_clock::now();
+
+        if (!NUM_FRAMES_PROCESSED++)
+        {
+            START_TIME = now;
+            LATEST_REPORT_TIME = now;
+
+            start_recording();
+        }
+
+        if ((now - LATEST_REPORT_TIME) >= std::chrono::seconds(5))
+        {
+            INFO(("Batch: %llu frames processed (%.1f FPS).",
+                  (unsigned long long)NUM_FRAMES_PROCESSED,
+                  frames_per_second((NUM_FRAMES_PROCESSED - NUM_FRAMES_AT_LATEST_REPORT), (now - LATEST_REPORT_TIME))));
+
+            LATEST_REPORT_TIME = now;
+            NUM_FRAMES_AT_LATEST_REPORT = NUM_FRAMES_PROCESSED;
+        }
+    });
+
+    ke_events().capture.endOfInput->subscribe([]
+    {
+        finish_when_pipeline_empty();
+    });
+
+    return;
+}
@@ -0,0 +1,35 @@
+/*
+ * 2020 Tarpeeksi Hyvae Soft
+ *
+ * Software: VCS
+ *
+ * Batch processing: runs the frames of a video file, rather than of a capture
+ * device, through VCS's anti-tearing, filters, and scaler as fast as they can
+ * go; encoding the results into the video file given with -o, if any, and
+ * reporting the rate at which the frames were processed. VCS exits once all of
+ * the frames have been processed.
+ *
+ * The frames are read via the video file capture API (cf. capture_api_video_file.h).
+ * The frame pipeline (see pipeline.h) is made threaded, so that decoding, the
+ * pipeline's stages, and encoding all run in parallel, with frames filtered
+ * several at a time where the filters allow it; and lossless, so that no
+ * frames get dropped along the way.
+ *
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+
+// Asks for VCS to run in batch mode, processing the frames of the given video
+// file. To be called before kbatch_initialize() and kc_initialize_capture().
+void kbatch_set_input_file_name(const std::string &filename);
+
+bool kbatch_is_enabled(void);
+
+const std::string& kbatch_input_file_name(void);
+
+void kbatch_initialize(void);
+
+#endif
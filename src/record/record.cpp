@@ -10,23 +10,34 @@
  */
 
 #include <QtConcurrent/QtConcurrent>
+#include <condition_variable>
 #include <QFutureWatcher>
 #include <QElapsedTimer>
 #include <QFileInfo>
 #include <QFuture>
+#include <QFile>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <deque>
+#include <mutex>
 #include "common/propagate/app_events.h"
 #include "display/display.h"
 #include "common/globals.h"
 #include "scaler/scaler.h"
 #include "common/memory/memory.h"
+#include "common/telemetry/telemetry.h"
 #include "record/record.h"
 
 #ifdef USE_OPENCV
     #include <opencv2/core/core.hpp>
     #include <opencv2/imgproc/imgproc.hpp>
     #include <opencv2/videoio/videoio.hpp>
+    #include <opencv2/imgcodecs/imgcodecs.hpp>
 
-    static cv::VideoWriter VIDEO_WRITER;
+    // The writer of the video file currently being recorded into; or nullptr if
+    // recording is inactive.
+    static cv::VideoWriter *VIDEO_WRITER = nullptr;
 #endif
 
 // The maximum number of frames that can fit into a frame buffer.
@@ -203,21 +214,623 @@ static struct recording_s
         // Milliseconds passed since the recording was started.
         QElapsedTimer recordingTimer;
     } meta;
+
+    // Live metrics on the encoder's performance. Written to by the encoder
+    // thread and read by the main thread.
+    struct encoder_stats_s
+    {
+        std::atomic<double> encodeTimePerFrame;
+        std::atomic<double> encodeFramerate;
+
+        // How many frames of the frame buffer being encoded have yet to be
+        // encoded.
+        std::atomic<uint> numFramesInEncoder;
+
+        std::atomic<uint> numDroppedFrames;
+        std::atomic<uint> numDuplicatedFrames;
+
+        std::atomic<u64> numBytesWritten;
+        std::atomic<double> diskThroughput;
+
+        // Times the interval between successive samples of the output file's
+        // size, for estimating disk throughput.
+        QElapsedTimer diskTimer;
+
+        // The size of the current segment's file on disk.
+        std::atomic<u64> numSegmentBytes;
+
+        void reset(void)
+        {
+            this->numSegmentBytes = 0;
+            this->encodeTimePerFrame = 0;
+            this->encodeFramerate = 0;
+            this->numFramesInEncoder = 0;
+            this->numDroppedFrames = 0;
+            this->numDuplicatedFrames = 0;
+            this->numBytesWritten = 0;
+            this->diskThroughput = 0;
+            this->diskTimer.start();
+
+            return;
+        }
+    } stats;
+
+    // Automatic splitting of the recording into several files, or segments,
+    // once a time or size limit is reached. The next segment's file and
+    // encoder are opened in the background ahead of time, and recording switches
+    // over to them between frame buffers, so that no frames are lost and the
+    // main thread isn't stalled by the encoder's setup or teardown.
+    struct segmentation_s
+    {
+        // The limits at which to roll over into a new segment. A value of 0
+        // disables the corresponding limit.
+        uint maxMinutes = 0;
+        uint maxMegabytes = 0;
+
+        // The filename from which the segments' filenames are derived.
+        std::string baseFilename;
+
+        // The 1-based index of the segment currently being recorded into.
+        uint segmentIdx = 1;
+
+        QElapsedTimer segmentTimer;
+
+        // The combined size of the segments completed so far.
+        u64 numPrevSegmentsBytes = 0;
+
+    #ifdef USE_OPENCV
+        // The encoder for the next segment, being prepared in the background.
+        QFuture<cv::VideoWriter*> nextWriter;
+    #endif
+        std::string nextFilename;
+        bool isNextWriterPending = false;
+
+        // Finished segments' encoders are released in a separate thread.
+        QFuture<void> releaseThread;
+
+        bool is_enabled(void) const
+        {
+            return (this->maxMinutes || this->maxMegabytes);
+        }
+    } segment;
 } RECORDING;
 
+// The number of frames the replay buffer lets wait for its compressor thread. If
+// this many are already waiting when a new frame arrives, that frame will be
+// skipped rather than stalling the caller.
+static const uint REPLAY_STAGING_CAPACITY = 4;
+
+// The JPEG quality (0-100) with which frames are compressed into the replay
+// buffer.
+static const int REPLAY_COMPRESSION_QUALITY = 90;
+
+// A background buffer that holds the most recent output frames, compressed, so
+// that the last N seconds of output can be saved to video on demand without
+// recording having been active.
+//
+// Frames arrive on the main thread as references to the scaler's output frames,
+// so no pixels are copied there; they're then converted to BGR and compressed
+// on the replay buffer's own thread into a ring of
+// packets whose total duration and byte size are kept within the user's
+// limits. Saving a replay snapshots the ring and encodes it into a video file
+// in a separate thread, so neither the capture nor the ring is interrupted.
+static struct replay_buffer_s
+{
+    // A single compressed frame in the ring.
+    struct packet_s
+    {
+        // Nanoseconds since the replay buffer was started.
+        i64 timestamp;
+
+        std::shared_ptr<const std::vector<u8>> data;
+    };
+
+    bool isActive = false;
+
+    // The packet ring. Accessed by both the main thread and the compressor
+    // thread, so guard with the mutex.
+    std::deque<packet_s> packets;
+    u64 packetBytes = 0;
+
+#ifdef USE_OPENCV
+    // Output frames waiting to be compressed, with their timestamps.
+    std::deque<std::pair<i64, std::shared_ptr<const scaled_frame_s>>> pendingFrames;
+#endif
+
+    std::mutex mutex;
+    std::condition_variable newFrameAvailable;
+    bool stopRequested = false;
+    std::thread compressorThread;
+
+    // We'll run the encoding of saved replays in a separate thread.
+    QFuture<void> writerThread;
+
+    // The resolution of the frames currently in the ring. Frames of a
+    // different resolution can't be mixed into the same video, so the ring
+    // will be emptied if the output resolution changes.
+    resolution_s resolution = {0, 0, 0};
+
+    // The limits within which to keep the ring.
+    i64 maxDuration = 0; // Nanoseconds.
+    u64 maxBytes = 0;
+
+    uint playbackFrameRate = 60;
+
+    // How many incoming frames we've had to skip for lack of staging slots.
+    uint numFramesSkipped = 0;
+
+    QElapsedTimer timer;
+
+    // Drops packets from the front of the ring until it's within its duration
+    // and memory limits. Expects the caller to have locked the mutex.
+    void enforce_limits(void)
+    {
+        while (!this->packets.empty() &&
+               ((this->packetBytes > this->maxBytes) ||
+                ((this->packets.back().timestamp - this->packets.front().timestamp) > this->maxDuration)))
+        {
+            this->packetBytes -= this->packets.front().data->size();
+            this->packets.pop_front();
+        }
+
+        return;
+    }
+} REPLAY;
+
 void krecord_initialize(void)
 {
-    ke_events().scaler.newFrame->subscribe([]
+    ke_events().scaler.newFrame->subscribe([](const std::shared_ptr<const scaled_frame_s> &frame)
     {
         if (krecord_is_recording())
         {
-            krecord_record_new_frame();
+            TELEMETRY_TIME_SCOPE("Record enqueue");
+
+            krecord_record_new_frame(frame);
+        }
+
+        if (krecord_is_replay_buffer_active())
+        {
+            TELEMETRY_TIME_SCOPE("Replay buffer enqueue");
+
+            krecord_replay_buffer_new_frame(frame);
         }
     });
 
     return;
 }
 
+#ifdef USE_OPENCV
+// Returns the fourcc code of the video encoder we record with on this platform.
+static int platform_video_encoder(void)
+{
+    #if _WIN32
+        // Encoder: x264vfw. Container: AVI.
+        return cv::VideoWriter::fourcc('X','2','6','4');
+    #elif __linux__
+        // Encoder: x264. Container: MP4.
+        return cv::VideoWriter::fourcc('a','v','c','1');
+    #else
+        #error "Unknown platform."
+    #endif
+}
+
+// Returns the given filename with this platform's video container suffix
+// appended, unless the filename already has it.
+static std::string with_platform_container_suffix(const std::string &filename)
+{
+    #if _WIN32
+        const QString suffix = "avi";
+    #elif __linux__
+        const QString suffix = "mp4";
+    #else
+        #error "Unknown platform."
+    #endif
+
+    if (QFileInfo(QString::fromStdString(filename)).suffix() != suffix)
+    {
+        return (filename + "." + suffix.toStdString());
+    }
+
+    return filename;
+}
+
+// Returns the filename of the recording's segment of the given index.
+static std::string segment_filename(const uint segmentIdx)
+{
+    const QFileInfo baseFile(QString::fromStdString(RECORDING.segment.baseFilename));
+
+    return QString("%1/%2_%3.%4").arg(baseFile.path())
+                                 .arg(baseFile.completeBaseName())
+                                 .arg(segmentIdx, 3, 10, QChar('0'))
+                                 .arg(baseFile.suffix()).toStdString();
+}
+
+// Opens and returns a new video writer for the current recording's format into
+// the given file; or nullptr on failure.
+static cv::VideoWriter* open_video_writer(const std::string &filename)
+{
+    cv::VideoWriter *const writer = new cv::VideoWriter(filename,
+                                                        platform_video_encoder(),
+                                                        RECORDING.meta.playbackFrameRate,
+                                                        cv::Size(RECORDING.meta.resolution.w, RECORDING.meta.resolution.h));
+
+    if (!writer->isOpened())
+    {
+        delete writer;
+        return nullptr;
+    }
+
+    return writer;
+}
+
+// Prepares the recording's next segment as it nears its size or time limit, and
+// switches over to it once the limit has been reached. Should be called between
+// frame buffers, while the encoder thread is idle.
+static void update_recording_segment(void)
+{
+    if (!RECORDING.segment.is_enabled())
+    {
+        return;
+    }
+
+    const double minutesElapsed = (RECORDING.segment.segmentTimer.elapsed() / 60000.0);
+    const double megabytesWritten = (RECORDING.stats.numSegmentBytes / (1024.0 * 1024.0));
+
+    const auto is_past_limit = [=](const double fraction)
+    {
+        return ((RECORDING.segment.maxMinutes && (minutesElapsed >= (RECORDING.segment.maxMinutes * fraction))) ||
+                (RECORDING.segment.maxMegabytes && (megabytesWritten >= (RECORDING.segment.maxMegabytes * fraction))));
+    };
+
+    // Open the next segment's file in the background in good time before we
+    // need it.
+    if (!RECORDING.segment.isNextWriterPending && is_past_limit(0.9))
+    {
+        const std::string filename = segment_filename(RECORDING.segment.segmentIdx + 1);
+
+        RECORDING.segment.nextFilename = filename;
+        RECORDING.segment.nextWriter = QtConcurrent::run([=]{return open_video_writer(filename);});
+        RECORDING.segment.isNextWriterPending = true;
+    }
+
+    // Roll over to the next segment. If its encoder isn't ready yet, we'll keep
+    // recording into the current segment and try again after the next frame
+    // buffer.
+    if (RECORDING.segment.isNextWriterPending &&
+        RECORDING.segment.nextWriter.isFinished() &&
+        is_past_limit(1))
+    {
+        RECORDING.segment.isNextWriterPending = false;
+
+        cv::VideoWriter *const nextWriter = RECORDING.segment.nextWriter.result();
+        if (!nextWriter)
+        {
+            NBENE(("Failed to open '%s' for the next recording segment. Will retry.", RECORDING.segment.nextFilename.c_str()));
+            return;
+        }
+
+        cv::VideoWriter *const prevWriter = VIDEO_WRITER;
+        VIDEO_WRITER = nextWriter;
+
+        RECORDING.segment.releaseThread.waitForFinished();
+        RECORDING.segment.releaseThread = QtConcurrent::run([=]{prevWriter->release(); delete prevWriter;});
+
+        RECORDING.segment.numPrevSegmentsBytes += RECORDING.stats.numSegmentBytes;
+        RECORDING.stats.numSegmentBytes = 0;
+        RECORDING.segment.segmentIdx++;
+        RECORDING.segment.segmentTimer.restart();
+        RECORDING.meta.filename = RECORDING.segment.nextFilename;
+
+        INFO(("Recording rolled over into '%s'.", RECORDING.meta.filename.c_str()));
+    }
+
+    return;
+}
+
+// Runs in its own thread for as long as the replay buffer is active, compressing
+// staged frames into the replay buffer's ring.
+static void replay_compressor_function(void)
+{
+    const std::vector<int> encodeParams = {cv::IMWRITE_JPEG_QUALITY, REPLAY_COMPRESSION_QUALITY};
+    cv::Mat bgrFrame;
+
+    while (true)
+    {
+        std::pair<i64, std::shared_ptr<const scaled_frame_s>> frame;
+
+        {
+            std::unique_lock<std::mutex> lock(REPLAY.mutex);
+
+            REPLAY.newFrameAvailable.wait(lock, []{ return (REPLAY.stopRequested || !REPLAY.pendingFrames.empty()); });
+
+            if (REPLAY.stopRequested)
+            {
+                break;
+            }
+
+            frame = REPLAY.pendingFrames.front();
+            REPLAY.pendingFrames.pop_front();
+        }
+
+        const resolution_s resolution = frame.second->resolution;
+        const cv::Mat originalFrame(resolution.h, resolution.w, CV_8UC4, (u8*)frame.second->pixels.ptr());
+        cv::cvtColor(originalFrame, bgrFrame, CV_BGRA2BGR);
+
+        // Let the output frame return to the scaler's pool.
+        frame.second.reset();
+
+        std::vector<u8> *const data = new std::vector<u8>;
+        cv::imencode(".jpg", bgrFrame, *data, encodeParams);
+
+        {
+            std::lock_guard<std::mutex> lock(REPLAY.mutex);
+
+            // If the output resolution changed while the frame was being
+            // compressed, the ring will have been emptied for frames of the new
+            // resolution, which this frame mustn't be mixed in with.
+            if ((resolution.w != REPLAY.resolution.w) ||
+                (resolution.h != REPLAY.resolution.h))
+            {
+                delete data;
+                continue;
+            }
+
+            REPLAY.packets.push_back({frame.first, std::shared_ptr<const std::vector<u8>>(data)});
+            REPLAY.packetBytes += data->size();
+            REPLAY.enforce_limits();
+        }
+    }
+
+    return;
+}
+
+// Encodes the given snapshot of replay buffer packets into a video file. Runs
+// in a separate thread.
+static void write_replay_to_disk(const std::string filename,
+                                 const std::vector<replay_buffer_s::packet_s> packets,
+                                 const resolution_s resolution,
+                                 const uint playbackFrameRate)
+{
+    cv::VideoWriter writer(filename,
+                           platform_video_encoder(),
+                           playbackFrameRate,
+                           cv::Size(resolution.w, resolution.h));
+
+    if (!writer.isOpened())
+    {
+        NBENE(("Failed to open '%s' for saving the replay buffer.", filename.c_str()));
+        return;
+    }
+
+    // Insert the frames in linear time, as per the video's playback rate.
+    const i64 stampDelta = ((1000.0 / playbackFrameRate) * 1000000);
+    const i64 firstStamp = packets.front().timestamp;
+    uint numFramesWritten = 0;
+    size_t i = 0;
+    cv::Mat frame;
+
+    for (i64 stamp = firstStamp; stamp <= packets.back().timestamp; stamp += stampDelta)
+    {
+        const size_t prevIdx = i;
+
+        while ((i < (packets.size() - 1)) &&
+               (packets[i].timestamp < stamp))
+        {
+            i++;
+        }
+
+        // Only decode when we've moved on to a new packet; otherwise, we're
+        // duplicating the previous frame.
+        if (frame.empty() || (i != prevIdx))
+        {
+            frame = cv::imdecode(*packets[i].data, cv::IMREAD_COLOR);
+        }
+
+        writer << frame;
+        numFramesWritten++;
+    }
+
+    writer.release();
+
+    INFO(("Saved %u frames from the replay buffer into '%s'.", numFramesWritten, filename.c_str()));
+
+    return;
+}
+#endif
+
+bool krecord_start_replay_buffer(const uint seconds,
+                                 const uint memoryBudgetMB,
+                                 const uint frameRate)
+{
+#ifndef USE_OPENCV
+    kd_show_headless_info_message("VCS can't start the replay buffer",
+                                  "OpenCV is needed for the replay buffer, but has been disabled on this build of VCS.");
+
+    (void)seconds;
+    (void)memoryBudgetMB;
+    (void)frameRate;
+
+    return false;
+#else
+    k_assert(!REPLAY.isActive,
+             "Attempting to start a replay buffer that's already active.");
+
+    if (!seconds || !memoryBudgetMB || !frameRate)
+    {
+        NBENE(("Refusing to start a replay buffer with a zero duration, memory budget, or frame rate."));
+        return false;
+    }
+
+    REPLAY.maxDuration = (i64(seconds) * 1000000000);
+    REPLAY.maxBytes = (u64(memoryBudgetMB) * 1024 * 1024);
+    REPLAY.playbackFrameRate = frameRate;
+    REPLAY.numFramesSkipped = 0;
+    REPLAY.resolution = {0, 0, 0};
+    REPLAY.packets.clear();
+    REPLAY.packetBytes = 0;
+    REPLAY.pendingFrames.clear();
+    REPLAY.stopRequested = false;
+    REPLAY.timer.start();
+
+    REPLAY.compressorThread = std::thread(replay_compressor_function);
+    REPLAY.isActive = true;
+
+    INFO(("Started a replay buffer of %u seconds (max. %u MB).", seconds, memoryBudgetMB));
+
+    return true;
+#endif
+}
+
+void krecord_stop_replay_buffer(void)
+{
+#ifdef USE_OPENCV
+    if (!REPLAY.isActive)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(REPLAY.mutex);
+        REPLAY.stopRequested = true;
+    }
+
+    REPLAY.newFrameAvailable.notify_all();
+    REPLAY.compressorThread.join();
+    REPLAY.writerThread.waitForFinished();
+
+    REPLAY.packets.clear();
+    REPLAY.packetBytes = 0;
+    REPLAY.pendingFrames.clear();
+    REPLAY.isActive = false;
+
+    INFO(("Stopped the replay buffer."));
+
+    return;
+#endif
+}
+
+bool krecord_is_replay_buffer_active(void)
+{
+    return REPLAY.isActive;
+}
+
+bool krecord_is_saving_replay(void)
+{
+    return !REPLAY.writerThread.isFinished();
+}
+
+i64 krecord_replay_buffer_duration(void)
+{
+    std::lock_guard<std::mutex> lock(REPLAY.mutex);
+
+    if (REPLAY.packets.empty())
+    {
+        return 0;
+    }
+
+    return ((REPLAY.packets.back().timestamp - REPLAY.packets.front().timestamp) / 1000000);
+}
+
+// Stages the given output frame for compression into the replay buffer.
+void krecord_replay_buffer_new_frame(const std::shared_ptr<const scaled_frame_s> &frame)
+{
+#ifndef USE_OPENCV
+    (void)frame;
+#else
+    k_assert(REPLAY.isActive,
+             "Attempted to add a frame to the replay buffer while it was inactive.");
+
+    if (!frame) return;
+
+    const resolution_s &resolution = frame->resolution;
+
+    std::lock_guard<std::mutex> lock(REPLAY.mutex);
+
+    // A video can't change its resolution midway, so start over if the
+    // output resolution has changed.
+    if ((resolution.w != REPLAY.resolution.w) ||
+        (resolution.h != REPLAY.resolution.h))
+    {
+        REPLAY.packets.clear();
+        REPLAY.packetBytes = 0;
+        REPLAY.pendingFrames.clear();
+        REPLAY.resolution = {resolution.w, resolution.h, 24};
+    }
+
+    if (REPLAY.pendingFrames.size() >= REPLAY_STAGING_CAPACITY)
+    {
+        REPLAY.numFramesSkipped++;
+        return;
+    }
+
+    REPLAY.pendingFrames.push_back({REPLAY.timer.nsecsElapsed(), frame});
+    REPLAY.newFrameAvailable.notify_one();
+
+    return;
+#endif
+}
+
+// Saves the contents of the replay buffer into a video file with the given
+// name. The saving happens asynchronously; the replay buffer keeps accepting
+// new frames meanwhile. Returns true if the saving was started; false otherwise.
+bool krecord_save_replay_buffer(const char *const filename)
+{
+#ifndef USE_OPENCV
+    (void)filename;
+
+    return false;
+#else
+    if (!REPLAY.isActive)
+    {
+        NBENE(("Was asked to save the replay buffer while it was inactive. Ignoring the request."));
+        return false;
+    }
+
+    if (krecord_is_saving_replay())
+    {
+        NBENE(("Was asked to save the replay buffer while a previous save was still in progress. Ignoring the request."));
+        return false;
+    }
+
+    if (!filename || !strlen(filename))
+    {
+        NBENE(("Was asked to save the replay buffer into an unnamed file. Ignoring the request."));
+        return false;
+    }
+
+    std::vector<replay_buffer_s::packet_s> snapshot;
+    resolution_s resolution;
+    {
+        std::lock_guard<std::mutex> lock(REPLAY.mutex);
+
+        snapshot.assign(REPLAY.packets.begin(), REPLAY.packets.end());
+        resolution = REPLAY.resolution;
+    }
+
+    if (snapshot.empty())
+    {
+        NBENE(("The replay buffer has no frames to save."));
+        return false;
+    }
+
+    if ((resolution.w % 2 != 0) || (resolution.h % 2 != 0))
+    {
+        NBENE(("The replay buffer's resolution must be divisible by two to be saved into video."));
+        return false;
+    }
+
+    const std::string outFilename = with_platform_container_suffix(filename);
+    const uint frameRate = REPLAY.playbackFrameRate;
+
+    INFO(("Saving %.1f seconds of replay into '%s'.",
+          ((snapshot.back().timestamp - snapshot.front().timestamp) / 1000000000.0), outFilename.c_str()));
+
+    REPLAY.writerThread = QtConcurrent::run([=]{write_replay_to_disk(outFilename, snapshot, resolution, frameRate);});
+
+    return true;
+#endif
+}
+
 // Prepare the OpenCV video writer for recording frames into a video.
 // Returns true if successful, false otherwise.
 //
@@ -238,7 +851,7 @@ bool krecord_start_recording(const char *const filename,
 
     return false;
 #else
-    k_assert(!VIDEO_WRITER.isOpened(),
+    k_assert(!VIDEO_WRITER,
              "Attempting to intialize a recording that has already been initialized.");
 
     if ((width % 2 != 0) || (height % 2 != 0))
@@ -262,6 +875,7 @@ bool krecord_start_recording(const char *const filename,
     RECORDING.linearFrameInsertion = linearFrameInsertion;
     RECORDING.meta.numFrames = 0;
     RECORDING.meta.recordingTimer.start();
+    RECORDING.stats.reset();
     FRAMERATE_ESTIMATE.initialize(0);
 
     // Allocate memory.
@@ -279,26 +893,28 @@ bool krecord_start_recording(const char *const filename,
     }
     RECORDING.activeFrameBuffer = &RECORDING.backBuffers[0];
 
-    #if _WIN32
-        // Encoder: x264vfw. Container: AVI.
-        if (QFileInfo(filename).suffix() != "avi") RECORDING.meta.filename += ".avi";
-        const auto encoder = cv::VideoWriter::fourcc('X','2','6','4');
-    #elif __linux__
-        // Encoder: x264. Container: MP4.
-        if (QFileInfo(filename).suffix() != "mp4") RECORDING.meta.filename += ".mp4";
-        const auto encoder = cv::VideoWriter::fourcc('a','v','c','1');
-    #else
-        #error "Unknown platform."
-    #endif
+    RECORDING.meta.filename = with_platform_container_suffix(filename);
+
+    // If the recording is to be split into segments, we'll number each segment's
+    // file, starting with the first.
+    RECORDING.segment.baseFilename = RECORDING.meta.filename;
+    RECORDING.segment.segmentIdx = 1;
+    RECORDING.segment.numPrevSegmentsBytes = 0;
+    RECORDING.segment.isNextWriterPending = false;
+    RECORDING.segment.segmentTimer.start();
+    if (RECORDING.segment.is_enabled())
+    {
+        RECORDING.meta.filename = segment_filename(RECORDING.segment.segmentIdx);
+    }
 
     DEBUG(("Starting recording into file '%s'.", RECORDING.meta.filename.c_str()));
 
-    VIDEO_WRITER.open(RECORDING.meta.filename,
-                      encoder,
-                      RECORDING.meta.playbackFrameRate,
-                      cv::Size(RECORDING.meta.resolution.w, RECORDING.meta.resolution.h));
+    // Make sure a previous recording has finished releasing its files.
+    RECORDING.segment.releaseThread.waitForFinished();
+
+    VIDEO_WRITER = open_video_writer(RECORDING.meta.filename);
 
-    if (!VIDEO_WRITER.isOpened())
+    if (!VIDEO_WRITER)
     {
         kd_show_headless_error_message("VCS can't start recording",
                                        "An error was encountred while attempting to start recording. "
@@ -306,6 +922,11 @@ bool krecord_start_recording(const char *const filename,
         return false;
     }
 
+    // Have the scaler produce frames at the video's resolution, whatever the
+    // resolution of the displayed frames; and in the encoder's BGR where it can
+    // do so cheaply.
+    ks_set_extra_output_resolution(scaler_output_e::recording, {width, height, 24});
+
     ke_events().recorder.recordingStarted->fire();
 
     return true;
@@ -315,7 +936,7 @@ bool krecord_start_recording(const char *const filename,
 bool krecord_is_recording(void)
 {
 #ifdef USE_OPENCV
-    return VIDEO_WRITER.isOpened();
+    return bool(VIDEO_WRITER);
 #else
     return false;
 #endif
@@ -356,6 +977,27 @@ resolution_s krecord_video_resolution(void)
 void encode_frame_buffer(frame_buffer_s *const frameBuffer)
 {
 #ifdef USE_OPENCV
+    ktelemetry_set_thread_name("Encoder");
+    TELEMETRY_TIME_SCOPE("Encode frame buffer");
+
+    QElapsedTimer encodeTimer;
+    encodeTimer.start();
+
+    uint numFramesEncoded = 0;
+
+    RECORDING.stats.numFramesInEncoder = frameBuffer->frame_count();
+
+    const auto encode_frame = [&](const uint frameIdx)
+    {
+        TELEMETRY_TIME_SCOPE("Encode frame");
+
+        (*VIDEO_WRITER) << cv::Mat(frameBuffer->resolution().h, frameBuffer->resolution().w, CV_8UC3, frameBuffer->frame(frameIdx));
+        RECORDING.meta.numFrames++;
+        numFramesEncoded++;
+
+        return;
+    };
+
     if (RECORDING.linearFrameInsertion)
     {
         const auto &frameTimestamps = frameBuffer->frame_timestamps();
@@ -363,6 +1005,12 @@ void encode_frame_buffer(frame_buffer_s *const frameBuffer)
         // Nanoseconds between each frame at the recording's playback rate.
         const i64 stampDelta = ((1000.0 / RECORDING.meta.playbackFrameRate) * 1000000);
 
+        // The number of the buffer's frames we've inserted into the video at
+        // least once; used to figure out how many of them had to be dropped or
+        // duplicated to keep the video's frame rate linear.
+        uint numUniqueFrames = 0;
+        int prevFrameIdx = -1;
+
         // Add frames at even intervals as per the recording's playback rate.
         i64 stamp = (RECORDING.meta.numFrames * stampDelta);
         uint i = 0;
@@ -372,24 +1020,58 @@ void encode_frame_buffer(frame_buffer_s *const frameBuffer)
             {
                 if (frameTimestamps[i] >= stamp)
                 {
-                    VIDEO_WRITER << cv::Mat(frameBuffer->resolution().h, frameBuffer->resolution().w, CV_8UC3, frameBuffer->frame(i));
-                    RECORDING.meta.numFrames++;
+                    encode_frame(i);
+
+                    if (int(i) != prevFrameIdx)
+                    {
+                        numUniqueFrames++;
+                        prevFrameIdx = i;
+                        RECORDING.stats.numFramesInEncoder = (frameBuffer->frame_count() - i - 1);
+                    }
+
                     break;
                 }
             }
 
             stamp += stampDelta;
         }
+
+        RECORDING.stats.numDroppedFrames += (frameBuffer->frame_count() - numUniqueFrames);
+        RECORDING.stats.numDuplicatedFrames += (numFramesEncoded - numUniqueFrames);
     }
     else
     {
         for (uint i = 0; i < frameBuffer->frame_count(); i++)
         {
-            VIDEO_WRITER << cv::Mat(frameBuffer->resolution().h, frameBuffer->resolution().w, CV_8UC3, frameBuffer->frame(i));
-            RECORDING.meta.numFrames++;
+            encode_frame(i);
+            RECORDING.stats.numFramesInEncoder = (frameBuffer->frame_count() - i - 1);
         }
     }
 
+    // Update the encoder's performance metrics.
+    {
+        const double secsElapsed = (encodeTimer.nsecsElapsed() / 1000000000.0);
+
+        if (numFramesEncoded && (secsElapsed > 0))
+        {
+            RECORDING.stats.encodeTimePerFrame = ((secsElapsed * 1000) / numFramesEncoded);
+            RECORDING.stats.encodeFramerate = (numFramesEncoded / secsElapsed);
+        }
+
+        const u64 segmentSize = QFileInfo(QString::fromStdString(RECORDING.meta.filename)).size();
+        const u64 totalSize = (RECORDING.segment.numPrevSegmentsBytes + segmentSize);
+        const double diskSecsElapsed = (RECORDING.stats.diskTimer.restart() / 1000.0);
+
+        if ((totalSize >= RECORDING.stats.numBytesWritten) && (diskSecsElapsed > 0))
+        {
+            RECORDING.stats.diskThroughput = ((totalSize - RECORDING.stats.numBytesWritten) / diskSecsElapsed);
+        }
+
+        RECORDING.stats.numBytesWritten = totalSize;
+        RECORDING.stats.numSegmentBytes = segmentSize;
+        RECORDING.stats.numFramesInEncoder = 0;
+    }
+
     frameBuffer->reset();
 
     return;
@@ -398,26 +1080,84 @@ void encode_frame_buffer(frame_buffer_s *const frameBuffer)
 #endif
 }
 
-// Encode VCS's most recent output frame into the video.
+// Sets the time and/or size limits after which recordings will roll over into a
+// new file. A value of 0 disables the corresponding limit. Takes effect on the
+// next recording.
+void krecord_set_segment_limits(const uint minutes, const uint megabytes)
+{
+    RECORDING.segment.maxMinutes = minutes;
+    RECORDING.segment.maxMegabytes = megabytes;
+
+    return;
+}
+
+uint krecord_segment_index(void)
+{
+    return RECORDING.segment.segmentIdx;
+}
+
+recording_stats_s krecord_recording_stats(void)
+{
+    recording_stats_s stats;
+
+    stats.encodeTimePerFrame = RECORDING.stats.encodeTimePerFrame;
+    stats.encodeFramerate = RECORDING.stats.encodeFramerate;
+    stats.numDroppedFrames = RECORDING.stats.numDroppedFrames;
+    stats.numDuplicatedFrames = RECORDING.stats.numDuplicatedFrames;
+    stats.numBytesWritten = RECORDING.stats.numBytesWritten;
+    stats.diskThroughput = RECORDING.stats.diskThroughput;
+    stats.numPendingFrames = RECORDING.stats.numFramesInEncoder;
+
+    if (krecord_is_recording())
+    {
+        stats.numPendingFrames += RECORDING.activeFrameBuffer->frame_count();
+    }
+
+    return stats;
+}
+
+// Encode the given output frame into the video.
 //
-void krecord_record_new_frame(void)
+void krecord_record_new_frame(const std::shared_ptr<const scaled_frame_s> &outputFrame)
 {
-#ifdef USE_OPENCV
-    k_assert(VIDEO_WRITER.isOpened(),
+#ifndef USE_OPENCV
+    (void)outputFrame;
+#else
+    k_assert(VIDEO_WRITER,
              "Attempted to record a video frame before video recording had been initialized.");
 
-    // Get the current output frame.
-    const resolution_s resolution = ks_output_resolution();
-    const u8 *const frameData = ks_scaler_output_as_raw_ptr();
-    if (frameData == nullptr) return;
+    if (!outputFrame) return;
+
+    // The scaler outputs a frame of its own for recording, unless the displayed
+    // frame is already at the video's resolution.
+    const auto &recordingFrame = outputFrame->extraOutputs[static_cast<int>(scaler_output_e::recording)];
+    const scaled_frame_s &videoFrame = (recordingFrame? *recordingFrame : *outputFrame);
+    const resolution_s &resolution = videoFrame.resolution;
+
+    // Frames that were already on their way through the scaler when recording
+    // started won't have been scaled for the video.
+    if ((resolution.w != RECORDING.meta.resolution.w) ||
+        (resolution.h != RECORDING.meta.resolution.h))
+    {
+        DEBUG(("Skipping a frame not scaled for recording (%lu x %lu).", resolution.w, resolution.h));
+
+        return;
+    }
 
-    k_assert((resolution.w == RECORDING.meta.resolution.w &&
-              resolution.h == RECORDING.meta.resolution.h), "Incompatible frame for recording: mismatched resolution.");
+    // Save the frame into the frame buffer, converting it to BGR unless the
+    // scaler already did.
+    u8 *const slot = RECORDING.activeFrameBuffer->next_slot(RECORDING.meta.recordingTimer.nsecsElapsed());
 
-    // Convert the frame to BRG, and save it into the frame buffer.
-    cv::Mat originalFrame(resolution.h, resolution.w, CV_8UC4, (u8*)frameData);
-    cv::Mat frame = cv::Mat(resolution.h, resolution.w, CV_8UC3, RECORDING.activeFrameBuffer->next_slot(RECORDING.meta.recordingTimer.nsecsElapsed()));
-    cv::cvtColor(originalFrame, frame, CV_BGRA2BGR);
+    if (resolution.bpp == 24)
+    {
+        memcpy(slot, videoFrame.pixels.ptr(), (resolution.w * resolution.h * 3));
+    }
+    else
+    {
+        cv::Mat originalFrame(resolution.h, resolution.w, CV_8UC4, (u8*)videoFrame.pixels.ptr());
+        cv::Mat frame = cv::Mat(resolution.h, resolution.w, CV_8UC3, slot);
+        cv::cvtColor(originalFrame, frame, CV_BGRA2BGR);
+    }
 
     // Once we've accumulated enough frames to fill the frame buffer, encode
     // its contents into the video file.
@@ -425,6 +1165,8 @@ void krecord_record_new_frame(void)
     {
         RECORDING.encoderThread.waitForFinished();
 
+        update_recording_segment();
+
         FRAMERATE_ESTIMATE.update(RECORDING.meta.numFrames);
         kd_update_video_recording_metainfo();
 
@@ -445,8 +1187,58 @@ void krecord_stop_recording(void)
 #ifdef USE_OPENCV
     DEBUG(("Stopping recording into file '%s'.", RECORDING.meta.filename.c_str()));
 
+    ks_set_extra_output_resolution(scaler_output_e::recording, {0, 0, 0});
+
     RECORDING.encoderThread.waitForFinished();
-    VIDEO_WRITER.release();
+
+    // Encode the frames that were still waiting for the frame buffer to fill up.
+    if (RECORDING.activeFrameBuffer->frame_count())
+    {
+        const auto frameBuffer = RECORDING.activeFrameBuffer;
+        RECORDING.encoderThread = QtConcurrent::run([=]{encode_frame_buffer(frameBuffer);});
+        RECORDING.encoderThread.waitForFinished();
+    }
+
+    // Release the video writer in the background, along with the next segment's
+    // writer if one had been prepared; its file won't have been recorded into,
+    // so we'll remove it.
+    {
+        cv::VideoWriter *const writer = VIDEO_WRITER;
+        VIDEO_WRITER = nullptr;
+
+        const bool isNextWriterPending = RECORDING.segment.isNextWriterPending;
+        const QFuture<cv::VideoWriter*> nextWriter = RECORDING.segment.nextWriter;
+        const std::string nextFilename = RECORDING.segment.nextFilename;
+        RECORDING.segment.isNextWriterPending = false;
+
+        RECORDING.segment.releaseThread.waitForFinished();
+        RECORDING.segment.releaseThread = QtConcurrent::run([=]
+        {
+            if (writer)
+            {
+                writer->release();
+                delete writer;
+            }
+
+            if (isNextWriterPending)
+            {
+                cv::VideoWriter *const unusedWriter = nextWriter.result();
+
+                if (unusedWriter)
+                {
+                    unusedWriter->release();
+                    delete unusedWriter;
+                    QFile::remove(QString::fromStdString(nextFilename));
+                }
+            }
+        });
+
+        // Don't leave the file unfinished if we're about to exit.
+        if (PROGRAM_EXIT_REQUESTED)
+        {
+            RECORDING.segment.releaseThread.waitForFinished();
+        }
+    }
 
     ke_events().recorder.recordingEnded->fire();
 
@@ -8,9 +8,38 @@
 #define RECORD_H
 
 #include <string>
+#include <memory>
 #include "common/globals.h"
 #include "common/types.h"
 
+struct scaled_frame_s;
+
+// Live metrics on the performance of the video encoder during recording.
+struct recording_stats_s
+{
+    // The average time, in milliseconds, it took to encode a frame during the
+    // most recent batch of frames.
+    double encodeTimePerFrame;
+
+    // The rate, in frames per second, at which the encoder processed the most
+    // recent batch of frames. If this falls below the recording's playback
+    // rate, the encoder is falling behind.
+    double encodeFramerate;
+
+    // How many frames have been captured for the video but not yet encoded.
+    uint numPendingFrames;
+
+    // How many captured frames linear frame insertion has had to drop or
+    // duplicate to keep the video's frame rate constant.
+    uint numDroppedFrames;
+    uint numDuplicatedFrames;
+
+    // The size of the video file on disk, and the rate, in bytes per second, at
+    // which it has most recently grown.
+    u64 numBytesWritten;
+    double diskThroughput;
+};
+
 bool krecord_start_recording(const char *const filename, const uint width, const uint height, const uint frameRate, const bool linearFrameInsertion = true);
 
 resolution_s krecord_video_resolution(void);
@@ -23,14 +52,34 @@ i64 krecord_recording_time(void);
 
 double krecord_recording_framerate(void);
 
+recording_stats_s krecord_recording_stats(void);
+
+void krecord_set_segment_limits(const uint minutes, const uint megabytes);
+
+uint krecord_segment_index(void);
+
 std::string krecord_video_filename(void);
 
 bool krecord_is_recording(void);
 
-void krecord_record_new_frame(void);
+void krecord_record_new_frame(const std::shared_ptr<const scaled_frame_s> &frame);
 
 void krecord_stop_recording(void);
 
 void krecord_initialize(void);
 
+bool krecord_start_replay_buffer(const uint seconds, const uint memoryBudgetMB, const uint frameRate);
+
+void krecord_stop_replay_buffer(void);
+
+bool krecord_is_replay_buffer_active(void);
+
+void krecord_replay_buffer_new_frame(const std::shared_ptr<const scaled_frame_s> &frame);
+
+bool krecord_save_replay_buffer(const char *const filename);
+
+bool krecord_is_saving_replay(void);
+
+i64 krecord_replay_buffer_duration(void);
+
 #endif
@@ -0,0 +1,256 @@
+/*
+ * 2020 Tarpeeksi Hyvae Soft
+ *
+ * Software: VCS
+ *
+ */
+
+#include <cstring>
+#include <climits>
+#include <atomic>
+#include "common/propagate/app_events.h"
+#include "common/telemetry/telemetry.h"
+#include "capture/capture_api.h"
+#include "capture/capture.h"
+#include "common/globals.h"
+#include "record/shm_output.h"
+#include "scaler/scaler.h"
+
+#ifdef __linux__
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #include <fcntl.h>
+#endif
+
+static bool IS_ENABLED = false;
+static bool IS_CAPTURE_INCLUDED = false;
+static std::string SHM_NAME = "/vcs";
+
+// How many frames each ring holds.
+static const u32 NUM_RING_SLOTS = 3;
+
+#ifdef __linux__
+// A ring of frame slots in a shared memory object; see shm_output.h for the
+// layout.
+class shm_frame_ring_c
+{
+public:
+    // Creates the shared memory object of the given name, replacing any earlier
+    // one. Returns false on failure.
+    bool open(const std::string &name)
+    {
+        this->name = name;
+
+        const int fd = shm_open(name.c_str(), (O_CREAT | O_TRUNC | O_RDWR), 0600);
+        if (fd < 0)
+        {
+            NBENE(("Failed to create the shared memory object '%s': %s.", name.c_str(), strerror(errno)));
+            return false;
+        }
+
+        // Slots are sized for the largest possible frame. Pages that are never
+        // written into don't take up memory.
+        const u32 headerSize = 4096;
+        const u32 pixelsOffset = 64;
+        const u32 slotSize = (((pixelsOffset + MAX_FRAME_SIZE) + 4095) & ~4095u);
+
+        this->size = (headerSize + (u64(NUM_RING_SLOTS) * slotSize));
+
+        if (ftruncate(fd, this->size) != 0)
+        {
+            NBENE(("Failed to size the shared memory object '%s': %s.", name.c_str(), strerror(errno)));
+            ::close(fd);
+            shm_unlink(name.c_str());
+            return false;
+        }
+
+        void *const mem = mmap(nullptr, this->size, (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
+        ::close(fd);
+
+        if (mem == MAP_FAILED)
+        {
+            NBENE(("Failed to map the shared memory object '%s': %s.", name.c_str(), strerror(errno)));
+            shm_unlink(name.c_str());
+            return false;
+        }
+
+        this->base = (u8*)mem;
+        this->header = (shm_frame_ring_header_s*)mem;
+        this->header->magic = SHM_FRAME_RING_MAGIC;
+        this->header->headerSize = headerSize;
+        this->header->numSlots = NUM_RING_SLOTS;
+        this->header->slotSize = slotSize;
+        this->header->pixelsOffset = pixelsOffset;
+        this->header->futexWord = 0;
+        this->header->latestSequence = 0;
+
+        // Consumers check the version last, once the rest of the header is in place.
+        __atomic_store_n(&this->header->version, SHM_FRAME_RING_VERSION, __ATOMIC_RELEASE);
+
+        INFO(("Publishing frames into the shared memory object '%s'.", name.c_str()));
+
+        return true;
+    }
+
+    void close(void)
+    {
+        if (this->base)
+        {
+            munmap(this->base, this->size);
+            shm_unlink(this->name.c_str());
+
+            this->base = nullptr;
+            this->header = nullptr;
+        }
+
+        return;
+    }
+
+    // Copies the given frame into the next slot, and lets any waiting consumers
+    // know of it.
+    void publish(const u8 *const pixels,
+                 const resolution_s &r,
+                 const shm_pixel_format_e pixelFormat,
+                 const std::chrono::steady_clock::time_point &timestamp)
+    {
+        const u32 bytesPerRow = (r.w * (r.bpp / 8));
+        const u32 numBytes = (bytesPerRow * r.h);
+
+        if (!this->base ||
+            (numBytes > (this->header->slotSize - this->header->pixelsOffset)))
+        {
+            return;
+        }
+
+        const u64 sequence = ++this->numFramesPublished;
+        u8 *const slot = (this->base + this->header->headerSize + ((sequence % this->header->numSlots) * this->header->slotSize));
+        shm_frame_slot_header_s *const slotHeader = (shm_frame_slot_header_s*)slot;
+
+        // Mark the slot as being written into before touching its contents.
+        __atomic_store_n(&slotHeader->sequence, u64(0), __ATOMIC_RELAXED);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slotHeader->timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp.time_since_epoch()).count();
+        slotHeader->width = r.w;
+        slotHeader->height = r.h;
+        slotHeader->bytesPerRow = bytesPerRow;
+        slotHeader->pixelFormat = pixelFormat;
+        memcpy((slot + this->header->pixelsOffset), pixels, numBytes);
+
+        __atomic_store_n(&slotHeader->sequence, sequence, __ATOMIC_RELEASE);
+        __atomic_store_n(&this->header->latestSequence, sequence, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&this->header->futexWord, 1, __ATOMIC_RELEASE);
+
+        syscall(SYS_futex, &this->header->futexWord, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+
+        return;
+    }
+
+private:
+    std::string name;
+    u8 *base = nullptr;
+    u64 size = 0;
+    shm_frame_ring_header_s *header = nullptr;
+    u64 numFramesPublished = 0;
+};
+
+static shm_frame_ring_c OUTPUT_RING;
+static shm_frame_ring_c CAPTURE_RING;
+
+// Output frames are published on a thread of their own, so that copying them
+// into shared memory doesn't hold up the main thread. If publishing falls
+// behind, frames are dropped rather than queued up.
+static vcs_event_queue_c OUTPUT_QUEUE("Shared memory output", 2);
+
+static shm_pixel_format_e shm_pixel_format(const capture_pixel_format_e format)
+{
+    switch (format)
+    {
+        case capture_pixel_format_e::rgb_555: return SHM_PIXEL_FORMAT_RGB_555;
+        case capture_pixel_format_e::rgb_565: return SHM_PIXEL_FORMAT_RGB_565;
+        case capture_pixel_format_e::rgb_888: return SHM_PIXEL_FORMAT_BGRA_8888;
+        default: k_assert(0, "Unknown capture pixel format."); return SHM_PIXEL_FORMAT_BGRA_8888;
+    }
+}
+#endif
+
+void kshm_set_enabled(const bool state, const std::string &name, const bool isCaptureIncluded)
+{
+    IS_ENABLED = state;
+    SHM_NAME = ((name.empty() || (name[0] == '/'))? name : ("/" + name));
+    IS_CAPTURE_INCLUDED = isCaptureIncluded;
+
+    return;
+}
+
+bool kshm_is_enabled(void)
+{
+    return IS_ENABLED;
+}
+
+void kshm_initialize(void)
+{
+    if (!IS_ENABLED)
+    {
+        return;
+    }
+
+    #ifdef __linux__
+        if (!OUTPUT_RING.open(SHM_NAME) ||
+            (IS_CAPTURE_INCLUDED && !CAPTURE_RING.open(SHM_NAME + "-capture")))
+        {
+            NBENE(("Failed to set up shared memory output. Frames won't be published into shared memory."));
+
+            kshm_release();
+
+            return;
+        }
+
+        OUTPUT_QUEUE.start_worker_thread();
+
+        ke_events().scaler.newFrame->subscribe([](const std::shared_ptr<const scaled_frame_s> &frame)
+        {
+            TELEMETRY_TIME_SCOPE("Shared memory output");
+
+            OUTPUT_RING.publish(frame->pixels.ptr(), frame->resolution, SHM_PIXEL_FORMAT_BGRA_8888, frame->timestamp);
+        }, OUTPUT_QUEUE);
+
+        if (IS_CAPTURE_INCLUDED)
+        {
+            // The capture buffer stays intact for as long as the event fires.
+            ke_events().capture.newFrame->subscribe([]
+            {
+                TELEMETRY_TIME_SCOPE("Shared memory capture output");
+
+                const captured_frame_s &frame = kc_capture_api().get_frame_buffer();
+
+                CAPTURE_RING.publish(frame.pixels.ptr(), frame.r, shm_pixel_format(frame.pixelFormat), std::chrono::steady_clock::now());
+            });
+        }
+    #else
+        NBENE(("Shared memory output is only available on Linux."));
+        IS_ENABLED = false;
+    #endif
+
+    return;
+}
+
+void kshm_release(void)
+{
+    #ifdef __linux__
+        OUTPUT_QUEUE.stop_worker_thread();
+
+        if (OUTPUT_QUEUE.num_dropped_calls())
+        {
+            INFO(("%u output frames weren't published into shared memory, as publishing fell behind.", OUTPUT_QUEUE.num_dropped_calls()));
+        }
+
+        OUTPUT_RING.close();
+        CAPTURE_RING.close();
+    #endif
+
+    return;
+}
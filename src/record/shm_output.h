@@ -0,0 +1,116 @@
+/*
+ * 2020 Tarpeeksi Hyvae Soft
+ *
+ * Software: VCS
+ *
+ * Publishes frames into POSIX shared memory, for other local processes (e.g.
+ * streaming or analysis tools) to read at full rate without going through the
+ * output window.
+ *
+ * Each stream of frames - the scaler's output, and optionally the captured
+ * frames as they arrive from the capture device - is published into a shared
+ * memory object of its own (see shm_open()), laid out as a ring of frame slots:
+ *
+ *   [shm_frame_ring_header_s][slot 0][slot 1]...[slot numSlots-1]
+ *
+ * where slot i begins at byte offset (headerSize + (i * slotSize)), and consists
+ * of a shm_frame_slot_header_s followed, at offset pixelsOffset into the slot,
+ * by the frame's pixels. All values are in the host's byte order.
+ *
+ * Frame n (counting from 1) is written into slot (n % numSlots). To read the
+ * newest frame, a consumer:
+ *
+ *   1. Reads the ring header's latestSequence; if it's 0, no frame has been
+ *      published yet.
+ *   2. Reads the sequence field of slot (latestSequence % numSlots), with
+ *      acquire semantics. If it differs from latestSequence, VCS has moved on;
+ *      start over.
+ *   3. Reads the slot's pixels in place (or copies them out).
+ *   4. Reads the slot's sequence field again. If it's unchanged, the pixels
+ *      read in step 3 were intact; otherwise VCS began overwriting the slot in
+ *      the meantime and they should be discarded.
+ *
+ * VCS zeroes a slot's sequence field before writing into the slot, and sets it
+ * to the frame's sequence number once done. A consumer keeping up with the
+ * frame rate has (numSlots - 1) frame intervals to read a frame in place.
+ *
+ * To wait for new frames, a consumer can futex-wait (FUTEX_WAIT, not private)
+ * on the ring header's futexWord, which VCS increments and FUTEX_WAKEs after
+ * publishing each frame.
+ *
+ * Shared memory output is only available on Linux.
+ *
+ */
+
+#ifndef SHM_OUTPUT_H
+#define SHM_OUTPUT_H
+
+#include <string>
+#include "common/types.h"
+
+// Identifies a shared memory object as a VCS frame ring ("VCSF").
+#define SHM_FRAME_RING_MAGIC 0x46534356u
+
+// Incremented whenever the layout of the structs below changes incompatibly.
+#define SHM_FRAME_RING_VERSION 1u
+
+// The pixel formats of frames in a frame ring.
+enum shm_pixel_format_e
+{
+    SHM_PIXEL_FORMAT_BGRA_8888 = 1, // 32 bits per pixel: blue, green, red, unused.
+    SHM_PIXEL_FORMAT_RGB_565   = 2, // 16 bits per pixel.
+    SHM_PIXEL_FORMAT_RGB_555   = 3, // 16 bits per pixel; the topmost bit unused.
+};
+
+// The header at the start of a frame ring's shared memory object.
+struct shm_frame_ring_header_s
+{
+    u32 magic;          // SHM_FRAME_RING_MAGIC.
+    u32 version;        // SHM_FRAME_RING_VERSION.
+    u32 headerSize;     // Bytes from the start of the object to slot 0.
+    u32 numSlots;
+    u32 slotSize;       // Bytes from the start of one slot to the next.
+    u32 pixelsOffset;   // Bytes from the start of a slot to its pixels.
+
+    // Incremented each time a frame is published. A futex word.
+    u32 futexWord;
+
+    u32 reserved;
+
+    // The sequence number of the most recently published frame; or 0 if none
+    // has been published yet.
+    u64 latestSequence;
+};
+
+// The header at the start of each slot in a frame ring.
+struct shm_frame_slot_header_s
+{
+    // The sequence number of the frame in the slot; or 0 while the slot is being
+    // written into.
+    u64 sequence;
+
+    // When the frame was captured or output, in nanoseconds of CLOCK_MONOTONIC.
+    u64 timestampNs;
+
+    u32 width;
+    u32 height;
+    u32 bytesPerRow;
+    u32 pixelFormat;    // One of shm_pixel_format_e.
+};
+
+static_assert((sizeof(shm_frame_ring_header_s) == 40), "Unexpected frame ring header size.");
+static_assert((sizeof(shm_frame_slot_header_s) == 32), "Unexpected frame slot header size.");
+
+// Asks for the scaler's output frames to be published into a shared memory
+// object of the given name (e.g. "/vcs"); and, if so asked, the captured frames
+// into one whose name has "-capture" appended. To be called before
+// kshm_initialize().
+void kshm_set_enabled(const bool state, const std::string &name, const bool isCaptureIncluded);
+
+bool kshm_is_enabled(void);
+
+void kshm_initialize(void);
+
+void kshm_release(void);
+
+#endif
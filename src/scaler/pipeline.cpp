@@ -0,0 +1,823 @@
+/*
+ * 2020 Tarpeeksi Hyvae Soft
+ *
+ * Software: VCS
+ *
+ * When threaded, the pipeline runs as follows:
+ *
+ *   main thread:   capture -> color conversion -> [queue]
+ *   stage thread:  [queue] -> anti-tear -> [queue]
+ *   stage thread:  [queue] -> filters -> [queue]
+ *   stage thread:  [queue] -> scaling (-> post-scaling filters) -> [queue]
+ *   main thread:   [queue] -> present (display, recorder)
+ *
+ * Color conversion stays on the main thread since it doubles as the copy that
+ * gets the frame out of the capture buffer, which the capture thread needs
+ * back before it can capture the next frame.
+ *
+ * Optionally, the filter stage hands frames whose filters carry no state from
+ * one frame to the next (cf. kf_is_filter_chain_stateless()) to a pool of
+ * worker threads, so that several frames get filtered at once; and passes the
+ * frames on in the order it received them once they're done. Frames needing
+ * stateful filters, e.g. the temporal denoiser, are filtered by the stage
+ * itself, one at a time, once the workers' frames have been passed on.
+ *
+ * Frames travel between the stages in buffers drawn from a fixed-size pool; if
+ * the pool runs dry, i.e. the stages have fallen behind the capture rate, new
+ * captured frames are dropped until buffers free up again.
+ *
+ * In lossless mode - e.g. for batch processing, where the input waits on VCS
+ * rather than the other way around - no frames are dropped: a stage waits for
+ * room in the next stage's queue, and the main thread waits for room for a
+ * captured frame, leaving the frame in the capture buffer in the meantime.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <cstring>
+#include <mutex>
+#include "common/propagate/app_events.h"
+#include "common/telemetry/telemetry.h"
+#include "common/memory/memory.h"
+#include "common/spsc_queue.h"
+#include "capture/capture_api.h"
+#include "capture/capture.h"
+#include "filter/anti_tear.h"
+#include "filter/filter.h"
+#include "scaler/quality_governor.h"
+#include "scaler/pipeline.h"
+#include "scaler/scaler.h"
+
+// A frame on its way through the pipeline.
+struct pipeline_frame_s
+{
+    // The frame's BGRA pixels, which each stage modifies in place.
+    heap_bytes_s<u8> pixels;
+
+    resolution_s resolution;
+
+    // The output resolution in effect when the frame was captured, and whether
+    // its upscaling was to be deferred to the renderer. Decided at capture so
+    // that the stages needn't consult the rest of VCS's state.
+    resolution_s outputResolution;
+    bool isUpscalingDeferred;
+
+    // Which of the filters the filter stage applied to the frame, leaving the
+    // rest for after scaling.
+    filter_chain_split_s filterSplit;
+
+    // Whether a filter worker has finished filtering the frame. Guarded by
+    // FILTER_JOBS_MUTEX.
+    bool isFiltered;
+
+    // When the frame was taken in from the capture buffer.
+    std::chrono::steady_clock::time_point captureTime;
+
+    // The longest time any single stage has so far spent on the frame. Since
+    // the stages run in parallel, it's the slowest of them that limits how
+    // many frames the pipeline can get through.
+    std::chrono::nanoseconds slowestStageTime;
+
+    // The scaled frame, once the scaling stage has produced it.
+    std::shared_ptr<scaled_frame_s> output;
+};
+
+struct pipeline_stage_s
+{
+    const char *const name;
+
+    // The stage's work on a frame. Returns false if the frame isn't to be
+    // passed on to the next stage.
+    bool (*const process)(pipeline_frame_s *const frame);
+
+    spsc_queue_c<pipeline_frame_s*> queue;
+
+    std::thread *thread;
+
+    std::atomic<u64> numFramesDropped;
+
+    // The deepest the queue has been during the current stats window; and
+    // during the previous one.
+    std::atomic<unsigned> windowPeakQueueDepth;
+    std::atomic<unsigned> peakQueueDepth;
+};
+
+// How many frames each stage's input queue can hold.
+static const unsigned STAGE_QUEUE_CAPACITY = 2;
+
+// How many frames can be in the pipeline at once. Enough to fill the queues and
+// to have one frame in each stage, plus one on its way out; and, when frames are
+// filtered in parallel, one more for each filter worker.
+static unsigned MAX_NUM_FRAMES_IN_FLIGHT = 9;
+
+static bool IS_THREADED = false;
+
+static bool IS_LOSSLESS = false;
+
+// Set while the pipeline is being released, so that stages waiting for room in
+// the next queue give up.
+static std::atomic<bool> IS_RELEASING{false};
+
+// Frames whose age exceeds this when they reach a stage will be dropped. A
+// value of 0 disables the check.
+static std::chrono::milliseconds LATENCY_BUDGET(0);
+
+static std::vector<pipeline_frame_s*> FRAME_POOL;
+static std::mutex FRAME_POOL_MUTEX;
+static unsigned NUM_FRAMES_ALLOCATED = 0;
+
+// Signaled whenever the pipeline makes progress that a lossless wait may be
+// waiting on: a frame leaves a queue, returns to the pool, or arrives for
+// presentation.
+static std::condition_variable PROGRESS;
+static std::mutex PROGRESS_MUTEX;
+
+static bool IS_FILTERING_FRAME_PARALLEL = false;
+
+// The threads, if any, that filter frames in parallel for the filter stage; and
+// the frames waiting for them, in the order they're to be taken up.
+static std::vector<std::thread*> FILTER_WORKERS;
+static std::deque<pipeline_frame_s*> FILTER_JOBS;
+static std::mutex FILTER_JOBS_MUTEX;
+static std::condition_variable FILTER_JOB_AVAILABLE;
+static std::condition_variable FILTER_JOB_DONE;
+static bool ARE_FILTER_WORKERS_STOPPING = false;
+
+static bool process_anti_tear(pipeline_frame_s *const frame);
+static bool process_filters(pipeline_frame_s *const frame);
+static bool process_scaling(pipeline_frame_s *const frame);
+
+// The stages run on threads of their own, in processing order, followed by the
+// one run on the main thread by kpipeline_update(), which has no processing
+// function.
+static pipeline_stage_s STAGES[] =
+{
+    {"Anti-tear", process_anti_tear, {STAGE_QUEUE_CAPACITY}, nullptr, {0}, {0}, {0}},
+    {"Filters",   process_filters,   {STAGE_QUEUE_CAPACITY}, nullptr, {0}, {0}, {0}},
+    {"Scaling",   process_scaling,   {STAGE_QUEUE_CAPACITY}, nullptr, {0}, {0}, {0}},
+    {"Present",   nullptr,           {STAGE_QUEUE_CAPACITY}, nullptr, {0}, {0}, {0}},
+};
+
+static pipeline_stage_s &PRESENT_STAGE = STAGES[NUM_ELEMENTS(STAGES) - 1];
+
+// When the current window of queue depth stats began.
+static std::chrono::steady_clock::time_point STATS_WINDOW_START;
+
+static bool process_anti_tear(pipeline_frame_s *const frame)
+{
+    TELEMETRY_TIME_SCOPE("Anti-tear");
+
+    return kat_anti_tear_in_place(frame->pixels.ptr(), frame->resolution);
+}
+
+static bool process_filters(pipeline_frame_s *const frame)
+{
+    frame->filterSplit = kf_apply_filter_chain(frame->pixels.ptr(), frame->resolution, frame->outputResolution);
+
+    return true;
+}
+
+static bool process_scaling(pipeline_frame_s *const frame)
+{
+    frame->output = ks_scale_pixels(frame->pixels.ptr(),
+                                    frame->resolution,
+                                    frame->outputResolution,
+                                    frame->isUpscalingDeferred,
+                                    frame->filterSplit);
+
+    kf_apply_post_scaling_filters(frame->output->pixels.ptr(),
+                                  frame->output->resolution,
+                                  frame->filterSplit);
+
+    return true;
+}
+
+// Returns a frame from the pool, or nullptr if the pipeline already has its
+// maximum number of frames in flight.
+static pipeline_frame_s* acquire_frame(void)
+{
+    std::lock_guard<std::mutex> lock(FRAME_POOL_MUTEX);
+
+    if (!FRAME_POOL.empty())
+    {
+        pipeline_frame_s *const frame = FRAME_POOL.back();
+        FRAME_POOL.pop_back();
+
+        return frame;
+    }
+
+    if (NUM_FRAMES_ALLOCATED >= MAX_NUM_FRAMES_IN_FLIGHT)
+    {
+        return nullptr;
+    }
+
+    const resolution_s maxres = kc_capture_api().get_maximum_resolution();
+
+    pipeline_frame_s *const frame = new pipeline_frame_s;
+    frame->pixels.alloc((maxres.w * maxres.h * 4), "Frame pipeline buffers");
+
+    NUM_FRAMES_ALLOCATED++;
+
+    return frame;
+}
+
+static void signal_progress(void)
+{
+    // Taking the lock ensures that a waiter is either already waiting for the
+    // notification or has yet to check its condition.
+    {
+        std::lock_guard<std::mutex> lock(PROGRESS_MUTEX);
+    }
+    PROGRESS.notify_all();
+
+    return;
+}
+
+// Returns true if acquire_frame() would return a frame. Since the main thread
+// is the only one to acquire frames, a frame found here stays available to it.
+static bool is_frame_available(void)
+{
+    std::lock_guard<std::mutex> lock(FRAME_POOL_MUTEX);
+
+    return (!FRAME_POOL.empty() || (NUM_FRAMES_ALLOCATED < MAX_NUM_FRAMES_IN_FLIGHT));
+}
+
+// Returns the given frame into the pool. Can be called from any thread.
+static void release_frame(pipeline_frame_s *const frame)
+{
+    frame->output.reset();
+
+    {
+        std::lock_guard<std::mutex> lock(FRAME_POOL_MUTEX);
+        FRAME_POOL.push_back(frame);
+    }
+
+    signal_progress();
+
+    return;
+}
+
+static bool is_frame_over_budget(const pipeline_frame_s *const frame)
+{
+    return (!IS_LOSSLESS &&
+            (LATENCY_BUDGET.count() > 0) &&
+            ((std::chrono::steady_clock::now() - frame->captureTime) > LATENCY_BUDGET));
+}
+
+// Places the given frame into the given stage's queue; or, if the queue is full,
+// drops the frame - unless the pipeline is lossless, in which case waits for room.
+static void pass_to_stage(pipeline_stage_s &stage, pipeline_frame_s *const frame)
+{
+    // The caller is the queue's only producer, so room found here stays.
+    if (IS_LOSSLESS)
+    {
+        std::unique_lock<std::mutex> lock(PROGRESS_MUTEX);
+
+        PROGRESS.wait(lock, [&stage]
+        {
+            return (IS_RELEASING || (stage.queue.size() < stage.queue.capacity()));
+        });
+    }
+
+    if (!stage.queue.push(frame))
+    {
+        stage.numFramesDropped++;
+        release_frame(frame);
+
+        return;
+    }
+
+    // The main thread may be waiting for frames to present; cf. wait_for_room_to_ingest().
+    if (&stage == &PRESENT_STAGE)
+    {
+        signal_progress();
+    }
+
+    const unsigned depth = stage.queue.size();
+    unsigned peak = stage.windowPeakQueueDepth.load();
+    while ((depth > peak) &&
+           !stage.windowPeakQueueDepth.compare_exchange_weak(peak, depth))
+    {
+        ;
+    }
+
+    return;
+}
+
+static void filter_worker_function(void)
+{
+    ktelemetry_set_thread_name("Filter worker");
+
+    while (true)
+    {
+        pipeline_frame_s *frame = nullptr;
+
+        {
+            std::unique_lock<std::mutex> lock(FILTER_JOBS_MUTEX);
+
+            FILTER_JOB_AVAILABLE.wait(lock, []{ return (ARE_FILTER_WORKERS_STOPPING || !FILTER_JOBS.empty()); });
+
+            if (ARE_FILTER_WORKERS_STOPPING)
+            {
+                break;
+            }
+
+            frame = FILTER_JOBS.front();
+            FILTER_JOBS.pop_front();
+        }
+
+        const auto startTime = std::chrono::steady_clock::now();
+
+        kf_apply_pre_scaling_filters(frame->pixels.ptr(), frame->resolution, frame->filterSplit);
+
+        // With the frames filtered in parallel, it's the workers' combined rate
+        // that limits how many frames the stage gets through.
+        const std::chrono::nanoseconds stageTime = ((std::chrono::steady_clock::now() - startTime) / int(FILTER_WORKERS.size()));
+        frame->slowestStageTime = std::max(frame->slowestStageTime, stageTime);
+
+        {
+            std::lock_guard<std::mutex> lock(FILTER_JOBS_MUTEX);
+            frame->isFiltered = true;
+        }
+        FILTER_JOB_DONE.notify_all();
+    }
+
+    return;
+}
+
+static void stage_thread_function(pipeline_stage_s *const stage, pipeline_stage_s *const nextStage)
+{
+    ktelemetry_set_thread_name(stage->name);
+
+    pipeline_frame_s *frame = nullptr;
+
+    while (stage->queue.wait_pop(frame))
+    {
+        signal_progress();
+
+        if (is_frame_over_budget(frame))
+        {
+            stage->numFramesDropped++;
+            release_frame(frame);
+
+            continue;
+        }
+
+        const auto startTime = std::chrono::steady_clock::now();
+
+        if (!stage->process(frame))
+        {
+            release_frame(frame);
+
+            continue;
+        }
+
+        frame->slowestStageTime = std::max(frame->slowestStageTime, std::chrono::nanoseconds(std::chrono::steady_clock::now() - startTime));
+
+        pass_to_stage(*nextStage, frame);
+    }
+
+    return;
+}
+
+// For the lossless pipeline. Waits until there's room in the pipeline for another
+// captured frame, returning true once there is. Returns false if there's still
+// no room after a short while - so that the main loop's other work doesn't
+// stall - or if frames are waiting to be presented, since only the main thread
+// can present them and they may be what's holding the pipeline up.
+static bool wait_for_room_to_ingest(void)
+{
+    // The main thread is the first stage's only producer, so room found here stays.
+    const auto has_room = []
+    {
+        return ((STAGES[0].queue.size() < STAGES[0].queue.capacity()) && is_frame_available());
+    };
+
+    std::unique_lock<std::mutex> lock(PROGRESS_MUTEX);
+
+    PROGRESS.wait_for(lock, std::chrono::milliseconds(10), [&has_room]
+    {
+        return (has_room() || PRESENT_STAGE.queue.size());
+    });
+
+    return has_room();
+}
+
+// Like stage_thread_function(), but for the filter stage when frames are filtered
+// in parallel by the filter workers.
+static void parallel_filter_stage_thread_function(pipeline_stage_s *const stage, pipeline_stage_s *const nextStage)
+{
+    ktelemetry_set_thread_name(stage->name);
+
+    // The frames handed to the filter workers, in the order they were received.
+    std::deque<pipeline_frame_s*> framesInWorkers;
+
+    // Waits for the workers to finish the earliest of their frames, and passes it on.
+    const auto pass_on_earliest_worker_frame = [&framesInWorkers, nextStage]
+    {
+        pipeline_frame_s *const frame = framesInWorkers.front();
+        framesInWorkers.pop_front();
+
+        {
+            std::unique_lock<std::mutex> lock(FILTER_JOBS_MUTEX);
+            FILTER_JOB_DONE.wait(lock, [frame]{ return frame->isFiltered; });
+        }
+
+        pass_to_stage(*nextStage, frame);
+    };
+
+    while (true)
+    {
+        pipeline_frame_s *frame = nullptr;
+
+        // Pass on the workers' frames while no new ones are coming in.
+        if (!stage->queue.pop(frame))
+        {
+            if (!framesInWorkers.empty())
+            {
+                pass_on_earliest_worker_frame();
+
+                continue;
+            }
+
+            if (!stage->queue.wait_pop(frame))
+            {
+                break;
+            }
+        }
+
+        signal_progress();
+
+        if (is_frame_over_budget(frame))
+        {
+            stage->numFramesDropped++;
+            release_frame(frame);
+
+            continue;
+        }
+
+        frame->filterSplit = kf_filter_chain_split(frame->resolution, frame->outputResolution);
+
+        if (kf_is_filter_chain_stateless(frame->filterSplit))
+        {
+            if (framesInWorkers.size() >= FILTER_WORKERS.size())
+            {
+                pass_on_earliest_worker_frame();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(FILTER_JOBS_MUTEX);
+                frame->isFiltered = false;
+                FILTER_JOBS.push_back(frame);
+            }
+            FILTER_JOB_AVAILABLE.notify_one();
+
+            framesInWorkers.push_back(frame);
+        }
+        else
+        {
+            // Stateful filters need the frames in order.
+            while (!framesInWorkers.empty())
+            {
+                pass_on_earliest_worker_frame();
+            }
+
+            const auto startTime = std::chrono::steady_clock::now();
+
+            kf_apply_pre_scaling_filters(frame->pixels.ptr(), frame->resolution, frame->filterSplit);
+
+            frame->slowestStageTime = std::max(frame->slowestStageTime, std::chrono::nanoseconds(std::chrono::steady_clock::now() - startTime));
+
+            pass_to_stage(*nextStage, frame);
+        }
+    }
+
+    // The workers are still running, so their frames can be finished.
+    while (!framesInWorkers.empty())
+    {
+        pass_on_earliest_worker_frame();
+    }
+
+    return;
+}
+
+// Copies the frame in the capture buffer into the pipeline, converting its color
+// to BGRA along the way. Returns false if the pipeline is lossless and has no
+// room for the frame at the moment, in which case the frame is to be offered
+// again once the main loop has presented the frames ready for it; and true
+// otherwise, whether the frame was taken in or dropped.
+static bool ingest_captured_frame(const captured_frame_s &capturedFrame)
+{
+    if (!ks_is_frame_scalable(capturedFrame))
+    {
+        return true;
+    }
+
+    if (IS_LOSSLESS &&
+        !wait_for_room_to_ingest())
+    {
+        return false;
+    }
+
+    pipeline_frame_s *const frame = acquire_frame();
+
+    if (!frame)
+    {
+        if (IS_LOSSLESS)
+        {
+            return false;
+        }
+
+        STAGES[0].numFramesDropped++;
+
+        return true;
+    }
+
+    frame->captureTime = std::chrono::steady_clock::now();
+    frame->resolution = {capturedFrame.r.w, capturedFrame.r.h, 32};
+    frame->outputResolution = ks_output_resolution();
+    frame->isUpscalingDeferred = ks_is_upscaling_deferrable(frame->resolution, frame->outputResolution);
+
+    if (capturedFrame.r.bpp != 32)
+    {
+        TELEMETRY_TIME_SCOPE("Color conversion");
+
+        ks_convert_frame_to_bgra(capturedFrame, frame->pixels.ptr());
+    }
+    else
+    {
+        memcpy(frame->pixels.ptr(), capturedFrame.pixels.ptr(),
+               frame->pixels.up_to(capturedFrame.r.w * capturedFrame.r.h * 4));
+    }
+
+    frame->slowestStageTime = (std::chrono::steady_clock::now() - frame->captureTime);
+
+    pass_to_stage(STAGES[0], frame);
+
+    return true;
+}
+
+void kpipeline_set_threaded(const bool state, const unsigned latencyBudgetMs)
+{
+    IS_THREADED = state;
+    LATENCY_BUDGET = std::chrono::milliseconds(latencyBudgetMs);
+
+    return;
+}
+
+bool kpipeline_is_threaded(void)
+{
+    return IS_THREADED;
+}
+
+void kpipeline_set_frame_parallel_filtering(const bool state)
+{
+    IS_FILTERING_FRAME_PARALLEL = state;
+
+    return;
+}
+
+void kpipeline_set_lossless(const bool state)
+{
+    IS_LOSSLESS = state;
+
+    return;
+}
+
+bool kpipeline_is_empty(void)
+{
+    if (!IS_THREADED)
+    {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(FRAME_POOL_MUTEX);
+
+    return (FRAME_POOL.size() == NUM_FRAMES_ALLOCATED);
+}
+
+void kpipeline_initialize(void)
+{
+    if (IS_THREADED)
+    {
+        if (IS_FILTERING_FRAME_PARALLEL)
+        {
+            const unsigned numWorkers = std::max(2u, std::thread::hardware_concurrency());
+
+            for (unsigned i = 0; i < numWorkers; i++)
+            {
+                FILTER_WORKERS.push_back(new std::thread(filter_worker_function));
+            }
+
+            MAX_NUM_FRAMES_IN_FLIGHT += numWorkers;
+        }
+
+        INFO(("Running the frame pipeline on %u threads (plus %u filter workers), with a latency budget of %d ms.",
+              unsigned(NUM_ELEMENTS(STAGES) - 1), unsigned(FILTER_WORKERS.size()), int(LATENCY_BUDGET.count())));
+
+        for (unsigned i = 0; i < (NUM_ELEMENTS(STAGES) - 1); i++)
+        {
+            const bool isParallelFilterStage = ((STAGES[i].process == process_filters) && !FILTER_WORKERS.empty());
+
+            STAGES[i].thread = new std::thread((isParallelFilterStage? parallel_filter_stage_thread_function : stage_thread_function),
+                                               &STAGES[i], &STAGES[i + 1]);
+        }
+
+        STATS_WINDOW_START = std::chrono::steady_clock::now();
+    }
+
+    ke_events().capture.newFrame->subscribe([]
+    {
+        if (IS_THREADED)
+        {
+            if (!ingest_captured_frame(kc_capture_api().get_frame_buffer()))
+            {
+                return;
+            }
+        }
+        else if (ks_is_passthrough_frame(kc_capture_api().get_frame_buffer()))
+        {
+            TELEMETRY_TIME_SCOPE(TELEMETRY_STAGE_FRAME_PIPELINE);
+
+            const auto startTime = std::chrono::steady_clock::now();
+
+            // The display draws the frame as the event fires, straight from the
+            // capture buffer. The buffer gets marked as processed once the
+            // frame has been let go of.
+            ke_events().scaler.newFrame->fire([]
+            {
+                ks_pass_frame_through(kc_capture_api().get_frame_buffer());
+                return ks_scaler_output_frame();
+            }());
+
+            kgovernor_add_frame_time(std::chrono::steady_clock::now() - startTime);
+
+            ks_detach_passthrough_frame();
+
+            return;
+        }
+        else
+        {
+            TELEMETRY_TIME_SCOPE(TELEMETRY_STAGE_FRAME_PIPELINE);
+
+            const auto startTime = std::chrono::steady_clock::now();
+
+            ks_scale_frame(kc_capture_api().get_frame_buffer());
+
+            const auto frame = ks_scaler_output_frame();
+            if (frame)
+            {
+                ke_events().scaler.newFrame->fire(frame);
+            }
+
+            kgovernor_add_frame_time(std::chrono::steady_clock::now() - startTime);
+        }
+
+        kc_capture_api().mark_frame_buffer_as_processed();
+    });
+
+    return;
+}
+
+void kpipeline_update(void)
+{
+    if (!IS_THREADED)
+    {
+        return;
+    }
+
+    static telemetry_stage_s *const pipelineTelemetryStage = ktelemetry_stage(TELEMETRY_STAGE_FRAME_PIPELINE);
+
+    pipeline_frame_s *frame = nullptr;
+
+    while (PRESENT_STAGE.queue.pop(frame))
+    {
+        signal_progress();
+
+        if (is_frame_over_budget(frame))
+        {
+            PRESENT_STAGE.numFramesDropped++;
+        }
+        else
+        {
+            ks_present_frame(frame->output);
+            ke_events().scaler.newFrame->fire(ks_scaler_output_frame());
+
+            kgovernor_add_frame_time(frame->slowestStageTime);
+
+            if (ktelemetry_is_enabled())
+            {
+                ktelemetry_add_sample(pipelineTelemetryStage, frame->captureTime, std::chrono::steady_clock::now());
+            }
+        }
+
+        release_frame(frame);
+    }
+
+    // Roll over the queue depth stats once per second.
+    const auto now = std::chrono::steady_clock::now();
+    if ((now - STATS_WINDOW_START) >= std::chrono::seconds(1))
+    {
+        for (auto &stage: STAGES)
+        {
+            stage.peakQueueDepth = stage.windowPeakQueueDepth.exchange(stage.queue.size());
+        }
+
+        STATS_WINDOW_START = now;
+    }
+
+    return;
+}
+
+void kpipeline_release(void)
+{
+    if (!IS_THREADED)
+    {
+        return;
+    }
+
+    DEBUG(("Releasing the frame pipeline."));
+
+    IS_RELEASING = true;
+    signal_progress();
+
+    for (auto &stage: STAGES)
+    {
+        stage.queue.interrupt();
+
+        if (stage.thread)
+        {
+            stage.thread->join();
+            delete stage.thread;
+            stage.thread = nullptr;
+        }
+    }
+
+    // Only now that the filter stage has collected its frames from the workers.
+    {
+        std::lock_guard<std::mutex> lock(FILTER_JOBS_MUTEX);
+        ARE_FILTER_WORKERS_STOPPING = true;
+    }
+    FILTER_JOB_AVAILABLE.notify_all();
+
+    for (auto *const worker: FILTER_WORKERS)
+    {
+        worker->join();
+        delete worker;
+    }
+
+    FILTER_WORKERS.clear();
+
+    for (auto &stage: STAGES)
+    {
+        pipeline_frame_s *frame = nullptr;
+
+        while (stage.queue.pop(frame))
+        {
+            release_frame(frame);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(FRAME_POOL_MUTEX);
+
+    for (auto *const frame: FRAME_POOL)
+    {
+        frame->pixels.release_memory();
+        delete frame;
+    }
+
+    FRAME_POOL.clear();
+    NUM_FRAMES_ALLOCATED = 0;
+
+    return;
+}
+
+std::vector<pipeline_stage_stats_s> kpipeline_stage_stats(void)
+{
+    std::vector<pipeline_stage_stats_s> stats;
+
+    if (!IS_THREADED)
+    {
+        return stats;
+    }
+
+    for (const auto &stage: STAGES)
+    {
+        pipeline_stage_stats_s s;
+
+        s.stageName = stage.name;
+        s.queueDepth = stage.queue.size();
+        s.peakQueueDepth = stage.peakQueueDepth;
+        s.queueCapacity = stage.queue.capacity();
+        s.numFramesDropped = stage.numFramesDropped;
+
+        stats.push_back(s);
+    }
+
+    return stats;
+}
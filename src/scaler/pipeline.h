@@ -0,0 +1,79 @@
+/*
+ * 2020 Tarpeeksi Hyvae Soft
+ *
+ * Software: VCS
+ *
+ * Carries captured frames through the scaler's steps - color conversion,
+ * anti-tearing, filtering, scaling - and hands the results to the display and
+ * the recorder.
+ *
+ * By default, each captured frame is run through all of the steps on the main
+ * thread before the next one is accepted. Optionally, the pipeline can instead
+ * run anti-tearing, filtering, and scaling as stages on threads of their own,
+ * connected by short queues; so that the processing of successive frames
+ * overlaps and a frame's cost is no longer bounded by the sum of its stages.
+ * In that mode, frames that have fallen behind a given latency budget are
+ * dropped rather than processed further.
+ *
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <string>
+#include <vector>
+#include "common/types.h"
+
+// The state of the queue leading into one of the pipeline's stages.
+struct pipeline_stage_stats_s
+{
+    std::string stageName;
+
+    // How many frames are waiting in the queue; and the most that were during
+    // the past second.
+    unsigned queueDepth = 0;
+    unsigned peakQueueDepth = 0;
+
+    unsigned queueCapacity = 0;
+
+    // How many frames were dropped on their way into, or while waiting for,
+    // the stage; either because the queue was full or because the frame had
+    // exceeded the latency budget.
+    u64 numFramesDropped = 0;
+};
+
+// Asks for the pipeline's stages to be run on threads of their own, dropping
+// any frame older than the given number of milliseconds (0 for no limit) when
+// it reaches a stage. To be called before kpipeline_initialize().
+void kpipeline_set_threaded(const bool state, const unsigned latencyBudgetMs);
+
+bool kpipeline_is_threaded(void);
+
+// Asks for the threaded pipeline to filter several frames at once, on a pool of
+// worker threads, whenever the filters carry no state from one frame to the
+// next. To be called before kpipeline_initialize().
+void kpipeline_set_frame_parallel_filtering(const bool state);
+
+// Asks for the pipeline to never drop frames, but to instead leave captured
+// frames in the capture buffer until it has room for them; e.g. for batch
+// processing, where there's no capture rate to keep up with.
+void kpipeline_set_lossless(const bool state);
+
+// Returns true if no frames are on their way through the pipeline; i.e. all the
+// frames taken in so far have been presented (or dropped).
+bool kpipeline_is_empty(void);
+
+void kpipeline_initialize(void);
+
+// Hands over to the display and the recorder the frames that have made it
+// through the pipeline since the previous call. Expected to be called from the
+// main thread, e.g. once per iteration of the main loop.
+void kpipeline_update(void);
+
+void kpipeline_release(void);
+
+// Returns the stats of each of the pipeline's stages, in processing order. If
+// the pipeline isn't threaded, the list is empty.
+std::vector<pipeline_stage_stats_s> kpipeline_stage_stats(void);
+
+#endif
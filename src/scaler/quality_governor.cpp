@@ -0,0 +1,308 @@
+/*
+ * 2020 Tarpeeksi Hyvae Soft
+ *
+ * Software: VCS
+ *
+ */
+
+#include <algorithm>
+#include "capture/capture_api.h"
+#include "capture/capture.h"
+#include "common/globals.h"
+#include "filter/filter.h"
+#include "scaler/quality_governor.h"
+#include "scaler/pipeline.h"
+#include "scaler/scaler.h"
+
+static bool IS_ENABLED = false;
+
+// The scaling filters the governor can cap to, from the most to the least costly;
+// ending with the lowest filter the user allows.
+static std::vector<std::string> SCALING_FILTER_STEPS;
+
+static bool IS_ANALYSIS_FILTER_SKIPPING_ALLOWED = false;
+
+// How many steps down from full quality we currently are. Levels 1 to n cap
+// the scaling filters to the corresponding entry in SCALING_FILTER_STEPS (with
+// level 0 being full quality); and, if allowed, level n+1 additionally skips
+// analysis filters.
+static unsigned QUALITY_LEVEL = 0;
+
+// How long to collect frame times before reviewing them.
+static const std::chrono::seconds REVIEW_INTERVAL(1);
+
+// A review window is considered over budget if more than this share of its
+// frames were.
+static const double MAX_OVER_BUDGET_SHARE = 0.05;
+
+// A review window is considered to have room to spare if each of its frames
+// took less than this share of the budget.
+static const double HEADROOM_SHARE = 0.6;
+
+// How many consecutive windows with room to spare it takes to step up a level.
+static const unsigned NUM_WINDOWS_TO_STEP_UP = 3;
+
+// Frame times collected during the current review window, against the budget
+// that was in effect at its start.
+static std::chrono::steady_clock::time_point WINDOW_START;
+static std::chrono::nanoseconds FRAME_TIME_BUDGET(0);
+static unsigned NUM_FRAMES = 0;
+static unsigned NUM_FRAMES_OVER_BUDGET = 0;
+static unsigned NUM_FRAMES_OVER_HEADROOM = 0;
+static bool WERE_FRAMES_DROPPED = false;
+
+static unsigned NUM_WINDOWS_WITH_HEADROOM = 0;
+
+// The most recent counts of frames dropped by the capture device and by the
+// frame pipeline; to tell whether more have been dropped since.
+static unsigned LATEST_NUM_MISSED_FRAMES = 0;
+static u64 LATEST_NUM_PIPELINE_DROPS = 0;
+
+static unsigned num_scaling_filter_cap_levels(void)
+{
+    return ((SCALING_FILTER_STEPS.size() > 1)? (SCALING_FILTER_STEPS.size() - 1) : 0);
+}
+
+static unsigned max_quality_level(void)
+{
+    return (num_scaling_filter_cap_levels() + (IS_ANALYSIS_FILTER_SKIPPING_ALLOWED? 1 : 0));
+}
+
+// Returns the highest level at which capping the scaling filters still has no
+// effect given the filters the user has currently set; i.e. the levels up to
+// and including it can be skipped over.
+static unsigned highest_no_op_level(void)
+{
+    unsigned level = num_scaling_filter_cap_levels();
+
+    for (const std::string &name: {ks_upscaling_filter_name(), ks_downscaling_filter_name()})
+    {
+        const auto entry = std::find(SCALING_FILTER_STEPS.begin(), SCALING_FILTER_STEPS.end(), name);
+
+        if (entry != SCALING_FILTER_STEPS.end())
+        {
+            level = std::min(level, unsigned(entry - SCALING_FILTER_STEPS.begin()));
+        }
+    }
+
+    return level;
+}
+
+static void set_quality_level(const unsigned level)
+{
+    QUALITY_LEVEL = level;
+
+    const unsigned numCapLevels = num_scaling_filter_cap_levels();
+
+    ks_set_scaling_filter_cost_cap((level && numCapLevels)? SCALING_FILTER_STEPS.at(std::min(level, numCapLevels)) : "");
+    kf_set_analysis_filters_skipped(level > numCapLevels);
+
+    return;
+}
+
+static bool step_down(void)
+{
+    const unsigned level = std::max((QUALITY_LEVEL + 1), (highest_no_op_level() + 1));
+
+    if (level > max_quality_level())
+    {
+        return false;
+    }
+
+    set_quality_level(level);
+
+    return true;
+}
+
+static bool step_up(void)
+{
+    if (!QUALITY_LEVEL)
+    {
+        return false;
+    }
+
+    const unsigned level = (QUALITY_LEVEL - 1);
+
+    set_quality_level((level <= highest_no_op_level())? 0 : level);
+
+    return true;
+}
+
+static void start_review_window(void)
+{
+    WINDOW_START = std::chrono::steady_clock::now();
+    NUM_FRAMES = 0;
+    NUM_FRAMES_OVER_BUDGET = 0;
+    NUM_FRAMES_OVER_HEADROOM = 0;
+    WERE_FRAMES_DROPPED = false;
+
+    const double refreshRate = kc_capture_api().get_refresh_rate().value<double>();
+    FRAME_TIME_BUDGET = std::chrono::nanoseconds((refreshRate > 0)? i64(1000000000 / refreshRate) : 0);
+
+    return;
+}
+
+static void review_window(void)
+{
+    // No frames, or no known refresh rate to derive a budget from.
+    if (!NUM_FRAMES ||
+        !FRAME_TIME_BUDGET.count())
+    {
+        NUM_WINDOWS_WITH_HEADROOM = 0;
+
+        return;
+    }
+
+    const double budgetMs = (FRAME_TIME_BUDGET.count() / 1000000.0);
+
+    if (WERE_FRAMES_DROPPED ||
+        (NUM_FRAMES_OVER_BUDGET > (NUM_FRAMES * MAX_OVER_BUDGET_SHARE)))
+    {
+        NUM_WINDOWS_WITH_HEADROOM = 0;
+
+        if (step_down())
+        {
+            INFO(("Quality governor: %u of %u frames exceeded the %.1f ms budget%s. Reducing quality (%s).",
+                  NUM_FRAMES_OVER_BUDGET, NUM_FRAMES, budgetMs, (WERE_FRAMES_DROPPED? ", and frames were dropped" : ""),
+                  kgovernor_status().c_str()));
+        }
+    }
+    else if (!NUM_FRAMES_OVER_HEADROOM)
+    {
+        if (QUALITY_LEVEL &&
+            (++NUM_WINDOWS_WITH_HEADROOM >= NUM_WINDOWS_TO_STEP_UP))
+        {
+            NUM_WINDOWS_WITH_HEADROOM = 0;
+
+            step_up();
+
+            INFO(("Quality governor: frames have stayed well within the %.1f ms budget. Restoring quality (%s).",
+                  budgetMs, kgovernor_status().c_str()));
+        }
+    }
+    else
+    {
+        NUM_WINDOWS_WITH_HEADROOM = 0;
+    }
+
+    return;
+}
+
+void kgovernor_set_enabled(const bool state,
+                           const std::string &lowestScalingFilter,
+                           const bool isAnalysisFilterSkippingAllowed)
+{
+    IS_ENABLED = state;
+    SCALING_FILTER_STEPS.clear();
+    IS_ANALYSIS_FILTER_SKIPPING_ALLOWED = isAnalysisFilterSkippingAllowed;
+
+    if (IS_ENABLED)
+    {
+        for (const auto &name: ks_scaling_filter_cost_order())
+        {
+            SCALING_FILTER_STEPS.push_back(name);
+
+            if (name == lowestScalingFilter)
+            {
+                break;
+            }
+        }
+
+        if (SCALING_FILTER_STEPS.empty() ||
+            (SCALING_FILTER_STEPS.back() != lowestScalingFilter))
+        {
+            NBENE(("The quality governor doesn't recognize the scaling filter '%s'. Allowing it to use any filter.",
+                   lowestScalingFilter.c_str()));
+        }
+
+        // The budget will be set once capture is under way, at the start of the
+        // next review window.
+        NUM_WINDOWS_WITH_HEADROOM = 0;
+        WINDOW_START = std::chrono::steady_clock::now();
+        FRAME_TIME_BUDGET = std::chrono::nanoseconds(0);
+    }
+
+    set_quality_level(0);
+
+    return;
+}
+
+bool kgovernor_is_enabled(void)
+{
+    return IS_ENABLED;
+}
+
+void kgovernor_add_frame_time(const std::chrono::nanoseconds &processingTime)
+{
+    if (!IS_ENABLED)
+    {
+        return;
+    }
+
+    NUM_FRAMES++;
+
+    if (processingTime > FRAME_TIME_BUDGET)
+    {
+        NUM_FRAMES_OVER_BUDGET++;
+    }
+
+    if (processingTime > (FRAME_TIME_BUDGET * HEADROOM_SHARE))
+    {
+        NUM_FRAMES_OVER_HEADROOM++;
+    }
+
+    return;
+}
+
+void kgovernor_update(void)
+{
+    if (!IS_ENABLED)
+    {
+        return;
+    }
+
+    // Note whether frames have been dropped since the previous call. The counts
+    // may get reset elsewhere in the meantime.
+    {
+        const unsigned numMissedFrames = kc_capture_api().get_missed_frames_count();
+        if (numMissedFrames < LATEST_NUM_MISSED_FRAMES) LATEST_NUM_MISSED_FRAMES = 0;
+        WERE_FRAMES_DROPPED |= (numMissedFrames > LATEST_NUM_MISSED_FRAMES);
+        LATEST_NUM_MISSED_FRAMES = numMissedFrames;
+
+        u64 numPipelineDrops = 0;
+        for (const auto &stage: kpipeline_stage_stats()) numPipelineDrops += stage.numFramesDropped;
+        WERE_FRAMES_DROPPED |= (numPipelineDrops > LATEST_NUM_PIPELINE_DROPS);
+        LATEST_NUM_PIPELINE_DROPS = numPipelineDrops;
+    }
+
+    if ((std::chrono::steady_clock::now() - WINDOW_START) >= REVIEW_INTERVAL)
+    {
+        review_window();
+        start_review_window();
+    }
+
+    return;
+}
+
+std::string kgovernor_status(void)
+{
+    if (!QUALITY_LEVEL)
+    {
+        return "Full quality";
+    }
+
+    const unsigned numCapLevels = num_scaling_filter_cap_levels();
+    std::string status;
+
+    if (numCapLevels)
+    {
+        status += ("Scaling: " + SCALING_FILTER_STEPS.at(std::min(QUALITY_LEVEL, numCapLevels)));
+    }
+
+    if (QUALITY_LEVEL > numCapLevels)
+    {
+        status += (status.empty()? "Analysis filters skipped" : ", analysis filters skipped");
+    }
+
+    return status;
+}
@@ -0,0 +1,55 @@
+/*
+ * 2020 Tarpeeksi Hyvae Soft
+ *
+ * Software: VCS
+ *
+ * Trades output quality for speed while VCS is failing to process frames as fast
+ * as they're being captured, and trades it back once there's room to spare.
+ *
+ * Once per second, the governor compares the time taken to process each frame
+ * against the time available per frame at the capture's refresh rate. If too
+ * many frames went over, or frames were dropped, it takes a step down in quality;
+ * if all frames were well within the budget for a few seconds running, it takes
+ * a step back up. The steps are, in order:
+ *
+ *   1. Substituting progressively cheaper scaling filters for costlier ones
+ *      (e.g. Lanczos -> Cubic -> Linear), down to a user-set lowest filter.
+ *
+ *   2. If the user allows it, skipping filters that only analyze frames, like
+ *      the delta histogram.
+ *
+ * The user's own settings are left unchanged; the steps only override them
+ * while in effect.
+ *
+ */
+
+#ifndef QUALITY_GOVERNOR_H
+#define QUALITY_GOVERNOR_H
+
+#include <string>
+#include <chrono>
+
+// Enables the governor, letting it step the scaling filters down to, at the
+// lowest, the one of the given name; and, if so allowed, skip analysis filters.
+// Disabling the governor restores full quality.
+void kgovernor_set_enabled(const bool state,
+                           const std::string &lowestScalingFilter = "Linear",
+                           const bool isAnalysisFilterSkippingAllowed = false);
+
+bool kgovernor_is_enabled(void);
+
+// Tells the governor how long it took to process a frame; for a frame pipeline
+// whose stages run in parallel, the time of the slowest stage. Expected to be
+// called from the main thread.
+void kgovernor_add_frame_time(const std::chrono::nanoseconds &processingTime);
+
+// Reviews the frame times received since the previous review, if a second has
+// passed since then, and steps the quality up or down as needed. Expected to be
+// called from the main thread, e.g. once per iteration of the main loop.
+void kgovernor_update(void);
+
+// Returns a description of the quality reductions currently in effect; e.g.
+// "Scaling: Linear".
+std::string kgovernor_status(void);
+
+#endif
@@ -10,6 +10,7 @@
 #include <cstring>
 #include <vector>
 #include <cmath>
+#include <mutex>
 #include "filter/anti_tear.h"
 #include "common/propagate/app_events.h"
 #include "capture/capture_api.h"
@@ -17,7 +18,9 @@
 #include "display/display.h"
 #include "common/globals.h"
 #include "common/memory/memory.h"
+#include "common/telemetry/telemetry.h"
 #include "filter/filter.h"
+#include "record/shm_output.h"
 #include "record/record.h"
 #include "scaler/scaler.h"
 
@@ -45,8 +48,36 @@ static const std::vector<scaling_filter_s> SCALING_FILTERS =    // User-facing s
                 {{"Nearest", &s_scaler_nearest}};
 #endif
 
-// The pixel buffer where scaled frames are to be placed.
-static heap_bytes_s<u8> OUTPUT_BUFFER;
+// The names of the scaling filters whose cost can be capped (cf. FILTER_COST_CAP),
+// from the most to the least costly.
+static const std::vector<std::string> FILTER_COST_ORDER = {"Lanczos", "Cubic", "Linear", "Nearest"};
+
+// If not null, any upscaling or downscaling filter costlier than this one will be
+// substituted with it when scaling; e.g. while VCS is struggling to keep up with
+// the capture rate.
+static const scaling_filter_s *FILTER_COST_CAP = nullptr;
+
+// Output frames no longer referenced by anyone, ready for reuse. Frames may be
+// released from any thread, so guard with the mutex.
+static std::vector<scaled_frame_s*> FRAME_POOL;
+static std::mutex FRAME_POOL_MUTEX;
+
+// Frames released while the pool already holds this many get deallocated.
+static const unsigned MAX_NUM_POOLED_FRAMES = 4;
+
+// Set when the scaler is released, after which frames get deallocated rather
+// than pooled on their release.
+static bool IS_FRAME_POOL_CLOSED = false;
+
+// The most recent frame output by the scaler.
+static std::shared_ptr<const scaled_frame_s> LATEST_FRAME;
+
+static u64 NUM_FRAMES_OUTPUT = 0;
+
+// Guards the settings that affect scaling (aspect mode, scaling filters) while
+// a frame is being scaled, since frames may be scaled on a thread of their own;
+// cf. ks_scale_pixels().
+static std::mutex SCALER_MUTEX;
 
 // Scratch buffers.
 static heap_bytes_s<u8> COLORCONV_BUFFER;
@@ -66,8 +97,41 @@ static bool FORCE_BASE_RESOLUTION = false;          // If false, the base resolu
 static real OUTPUT_SCALING = 1;
 static bool FORCE_SCALING = false;
 
+// If true, frames that would be upscaled with a filter the renderer can
+// reproduce (nearest or linear) are left at their native resolution, and the
+// renderer scales them to the output size as it draws them. This saves the CPU
+// from doing the upscaling.
+static bool DEFER_UPSCALING = false;
+
+// If true, frames are color-converted, filtered, and scaled in horizontal bands
+// small enough to stay in the CPU's cache through all of those steps, rather
+// than each step in turn sweeping through the whole frame; cf. s_scale_frame_in_bands().
+static bool BAND_PROCESSING_ENABLED = false;
+
+// If true, captured frames that the scaler would leave unchanged are handed to
+// the display as they are, without being copied into an output frame first;
+// cf. ks_pass_frame_through().
+static bool PASSTHROUGH_ENABLED = false;
+
+// Whether the most recent captured frame was passed through; to log changes.
+static bool IS_PASSING_THROUGH = false;
+
+// The resolutions of the scaler's extra outputs, indexed by scaler_output_e; 0 x 0
+// where an output is disabled. Guarded by SCALER_MUTEX.
+static resolution_s EXTRA_OUTPUT_RESOLUTIONS[static_cast<int>(scaler_output_e::num_enumerators)] = {};
+
+// Roughly how many bytes of color-converted pixels, halos included, to process
+// per band. About the size of a typical per-core L2 cache.
+static const unsigned BAND_SIZE_BYTES = (512 * 1024);
+
+// How many rows of source pixels beyond a band the scaling filters may read to
+// produce the band's scaled rows; enough for the widest kernel (Lanczos).
+static const unsigned SCALER_BAND_HALO = 4;
+
 void ks_set_aspect_mode(const aspect_mode_e mode)
 {
+    std::lock_guard<std::mutex> lock(SCALER_MUTEX);
+
     ASPECT_MODE = mode;
 
     return;
@@ -99,14 +163,6 @@ resolution_s ks_output_base_resolution(void)
 //
 resolution_s ks_output_resolution(void)
 {
-    // While recording video, the output resolution is required to stay locked
-    // to the video resolution.
-    if (krecord_is_recording())
-    {
-        const auto r = krecord_video_resolution();
-        return {r.w, r.h, OUTPUT_BIT_DEPTH};
-    }
-
     resolution_s inRes = kc_capture_api().get_resolution();
     resolution_s outRes = inRes;
 
@@ -154,12 +210,11 @@ bool ks_is_forced_aspect_enabled(void)
     return FORCE_ASPECT;
 }
 
-#if USE_OPENCV
 // Returns a resolution corresponding to sourceRes scaled up to targetRes but
 // maintaining sourceRes's aspect ratio according to the scaler's current aspect
 // mode.
 //
-static resolution_s padded_resolution(const resolution_s &sourceRes, const resolution_s &targetRes)
+resolution_s ks_padded_resolution(const resolution_s &sourceRes, const resolution_s &targetRes)
 {
     const resolution_s aspect = [sourceRes]()->resolution_s
     {
@@ -196,6 +251,7 @@ static resolution_s padded_resolution(const resolution_s &sourceRes, const resol
     return {w, h, OUTPUT_BIT_DEPTH};
 }
 
+#if USE_OPENCV
 // Returns border padding sizes for cv::copyMakeBorder()
 //
 static cv::Vec4i border_padding(const resolution_s &paddedRes, const resolution_s &targetRes)
@@ -232,7 +288,7 @@ void opencv_scale(u8 *const pixelData,
 
     if (ks_is_forced_aspect_enabled())
     {
-        const resolution_s paddedRes = padded_resolution(sourceRes, targetRes);
+        const resolution_s paddedRes = ks_padded_resolution(sourceRes, targetRes);
         cv::Mat tmp = cv::Mat(paddedRes.h, paddedRes.w, CV_8UC4, TMP_BUFFER.ptr());
 
         if ((paddedRes.h == targetRes.h) &&
@@ -267,7 +323,7 @@ void s_scaler_nearest(SCALER_FUNC_PARAMS)
     }
 
     #if USE_OPENCV
-        opencv_scale(pixelData, OUTPUT_BUFFER.ptr(), sourceRes, targetRes, cv::INTER_NEAREST);
+        opencv_scale(pixelData, outputData, sourceRes, targetRes, cv::INTER_NEAREST);
     #else
         /// TODO. Implement a non-OpenCV nearest scaler so there's a basic fallback.
         k_assert(0, "Attempted to use a scaling filter that hasn't been implemented for non-OpenCV builds.");
@@ -286,7 +342,7 @@ void s_scaler_linear(SCALER_FUNC_PARAMS)
     }
 
     #if USE_OPENCV
-        opencv_scale(pixelData, OUTPUT_BUFFER.ptr(), sourceRes, targetRes, cv::INTER_LINEAR);
+        opencv_scale(pixelData, outputData, sourceRes, targetRes, cv::INTER_LINEAR);
     #else
         k_assert(0, "Attempted to use a scaling filter that hasn't been implemented for non-OpenCV builds.");
     #endif
@@ -304,7 +360,7 @@ void s_scaler_area(SCALER_FUNC_PARAMS)
     }
 
     #if USE_OPENCV
-        opencv_scale(pixelData, OUTPUT_BUFFER.ptr(), sourceRes, targetRes, cv::INTER_AREA);
+        opencv_scale(pixelData, outputData, sourceRes, targetRes, cv::INTER_AREA);
     #else
         k_assert(0, "Attempted to use a scaling filter that hasn't been implemented for non-OpenCV builds.");
     #endif
@@ -322,7 +378,7 @@ void s_scaler_cubic(SCALER_FUNC_PARAMS)
     }
 
     #if USE_OPENCV
-        opencv_scale(pixelData, OUTPUT_BUFFER.ptr(), sourceRes, targetRes, cv::INTER_CUBIC);
+        opencv_scale(pixelData, outputData, sourceRes, targetRes, cv::INTER_CUBIC);
     #else
         k_assert(0, "Attempted to use a scaling filter that hasn't been implemented for non-OpenCV builds.");
     #endif
@@ -340,7 +396,7 @@ void s_scaler_lanczos(SCALER_FUNC_PARAMS)
     }
 
     #if USE_OPENCV
-        opencv_scale(pixelData, OUTPUT_BUFFER.ptr(), sourceRes, targetRes, cv::INTER_LANCZOS4);
+        opencv_scale(pixelData, outputData, sourceRes, targetRes, cv::INTER_LANCZOS4);
     #else
         k_assert(0, "Attempted to use a scaling filter that hasn't been implemented for non-OpenCV builds.");
     #endif
@@ -371,6 +427,78 @@ int cv_error_handler(int status, const char* func_name,
     return 1;
 }
 
+// Returns an output frame from the pool, or a new one if the pool is empty. The
+// frame returns into the pool once it's no longer referenced.
+static std::shared_ptr<scaled_frame_s> s_acquire_frame(void)
+{
+    scaled_frame_s *frame = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(FRAME_POOL_MUTEX);
+
+        if (!FRAME_POOL.empty())
+        {
+            frame = FRAME_POOL.back();
+            FRAME_POOL.pop_back();
+        }
+    }
+
+    if (!frame)
+    {
+        frame = new scaled_frame_s;
+        frame->pixels.alloc(MAX_FRAME_SIZE, "Scaler output frame");
+    }
+
+    return std::shared_ptr<scaled_frame_s>(frame, [](scaled_frame_s *const frame)
+    {
+        for (auto &extraOutput: frame->extraOutputs)
+        {
+            extraOutput.reset();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(FRAME_POOL_MUTEX);
+
+            if (!IS_FRAME_POOL_CLOSED &&
+                (FRAME_POOL.size() < MAX_NUM_POOLED_FRAMES))
+            {
+                FRAME_POOL.push_back(frame);
+                return;
+            }
+        }
+
+        frame->pixels.release_memory();
+        delete frame;
+    });
+}
+
+void ks_present_frame(const std::shared_ptr<scaled_frame_s> &frame)
+{
+    frame->frameNumber = NUM_FRAMES_OUTPUT++;
+    frame->timestamp = std::chrono::steady_clock::now();
+
+    for (const auto &extraOutput: frame->extraOutputs)
+    {
+        if (extraOutput)
+        {
+            extraOutput->frameNumber = frame->frameNumber;
+            extraOutput->timestamp = frame->timestamp;
+        }
+    }
+
+    LATEST_FRAME = frame;
+
+    if ((LATEST_OUTPUT_SIZE.w != frame->resolution.w) ||
+        (LATEST_OUTPUT_SIZE.h != frame->resolution.h))
+    {
+        LATEST_OUTPUT_SIZE = frame->resolution;
+
+        ke_events().scaler.newFrameResolution->fire(frame->resolution);
+    }
+
+    return;
+}
+
 void ks_initialize_scaler(void)
 {
     INFO(("Initializing the scaler."));
@@ -379,22 +507,12 @@ void ks_initialize_scaler(void)
         cv::redirectError(cv_error_handler);
     #endif
 
-    OUTPUT_BUFFER.alloc(MAX_FRAME_SIZE, "Scaler output buffer");
     COLORCONV_BUFFER.alloc(MAX_FRAME_SIZE, "Scaler color convertion buffer");
     TMP_BUFFER.alloc(MAX_FRAME_SIZE, "Scaler scratch buffer");
 
     ks_set_upscaling_filter(SCALING_FILTERS.at(0).name);
     ks_set_downscaling_filter(SCALING_FILTERS.at(0).name);
 
-    ke_events().capture.newFrame->subscribe([]
-    {
-        ks_scale_frame(kc_capture_api().get_frame_buffer());
-
-        ke_events().scaler.newFrame->fire();
-
-        kc_capture_api().mark_frame_buffer_as_processed();
-    });
-
     ke_events().capture.newVideoMode->subscribe([]
     {
         const auto currentInputRes = kc_capture_api().get_resolution();
@@ -421,14 +539,29 @@ void ks_release_scaler(void)
     DEBUG(("Releasing the scaler."));
 
     COLORCONV_BUFFER.release_memory();
-    OUTPUT_BUFFER.release_memory();
     TMP_BUFFER.release_memory();
 
+    LATEST_FRAME.reset();
+
+    // Frames still held by the scaler's consumers will be deallocated as they're
+    // released.
+    {
+        std::lock_guard<std::mutex> lock(FRAME_POOL_MUTEX);
+
+        for (auto *const frame: FRAME_POOL)
+        {
+            frame->pixels.release_memory();
+            delete frame;
+        }
+
+        FRAME_POOL.clear();
+        IS_FRAME_POOL_CLOSED = true;
+    }
+
     return;
 }
 
-// Converts the given non-BGRA frame into the BGRA format.
-void s_convert_frame_to_bgra(const captured_frame_s &frame)
+void ks_convert_frame_to_bgra(const captured_frame_s &frame, u8 *const dst)
 {
     // RGB888 frames are already stored in BGRA format.
     if (frame.pixelFormat == capture_pixel_format_e::rgb_888)
@@ -441,9 +574,9 @@ void s_convert_frame_to_bgra(const captured_frame_s &frame)
         const u32 numColorChan = (frame.r.bpp / 8);
 
         cv::Mat input = cv::Mat(frame.r.h, frame.r.w, CV_MAKETYPE(CV_8U,numColorChan), frame.pixels.ptr());
-        cv::Mat colorConv = cv::Mat(frame.r.h, frame.r.w, CV_8UC4, COLORCONV_BUFFER.ptr());
+        cv::Mat colorConv = cv::Mat(frame.r.h, frame.r.w, CV_8UC4, dst);
 
-        k_assert(!COLORCONV_BUFFER.is_null(),
+        k_assert(dst,
                  "Was asked to convert a frame's color depth, but the color conversion buffer "
                  "was null.");
 
@@ -477,22 +610,37 @@ void s_convert_frame_to_bgra(const captured_frame_s &frame)
         cv::cvtColor(input, colorConv, conversionType);
     #else
         (void)frame;
+        (void)dst;
         k_assert(0, "Was asked to convert the frame to BGRA, but OpenCV had been disabled in the build. Can't do it.");
     #endif
 
     return;
 }
 
-// Takes the given image and scales it according to the scaler's current internal
-// resolution settings. The scaled image is placed in the scaler's internal buffer,
-// not in the source buffer.
-//
-void ks_scale_frame(const captured_frame_s &frame)
+// Returns true if the upscaling of a frame of the given resolution to the given
+// output resolution can be left for the renderer to do.
+bool ks_is_upscaling_deferrable(const resolution_s &frameRes, const resolution_s &outputRes)
 {
-    u8 *pixelData = frame.pixels.ptr();
-    resolution_s frameRes = frame.r; /// Temp hack. May want to modify the .bpp value.
-    resolution_s outputRes = ks_output_resolution();
+    // The frames going into the replay buffer must be at the video's full
+    // resolution. (Recording gets frames of its own; cf. scaler_output_e.)
+    if (krecord_is_replay_buffer_active())
+    {
+        return false;
+    }
+
+    return (DEFER_UPSCALING &&
+            UPSCALE_FILTER &&
+            ((UPSCALE_FILTER->name == "Nearest") || (UPSCALE_FILTER->name == "Linear")) &&
+            (frameRes.w <= outputRes.w) &&
+            (frameRes.h <= outputRes.h) &&
+            ((frameRes.w < outputRes.w) || (frameRes.h < outputRes.h)));
+}
 
+// Returns true if the given captured frame is one the scaler can process.
+//
+bool ks_is_frame_scalable(const captured_frame_s &frame)
+{
+    const resolution_s outputRes = ks_output_resolution();
     const resolution_s minres = kc_capture_api().get_minimum_resolution();
     const resolution_s maxres = kc_capture_api().get_maximum_resolution();
 
@@ -502,123 +650,568 @@ void ks_scale_frame(const captured_frame_s &frame)
         {
             NBENE(("Was asked to scale a frame with an incompatible bit depth (%u). Ignoring it.",
                     frame.r.bpp));
-            goto done;
+            return false;
         }
         else if (outputRes.w > MAX_OUTPUT_WIDTH ||
                  outputRes.h > MAX_OUTPUT_HEIGHT)
         {
             NBENE(("Was asked to scale a frame with an output size (%u x %u) larger than the maximum allowed (%u x %u). Ignoring it.",
                     outputRes.w, outputRes.h, MAX_OUTPUT_WIDTH, MAX_OUTPUT_HEIGHT));
-            goto done;
+            return false;
         }
-        else if (pixelData == nullptr)
+        else if (frame.pixels.is_null())
         {
             NBENE(("Was asked to scale a null frame. Ignoring it."));
-            goto done;
+            return false;
         }
         else if (frame.pixelFormat != kc_capture_api().get_pixel_format())
         {
             NBENE(("Was asked to scale a frame whose pixel format differed from the expected. Ignoring it."));
-            goto done;
+            return false;
         }
         else if (frame.r.bpp > MAX_OUTPUT_BPP)
         {
             NBENE(("Was asked to scale a frame with a color depth (%u bits) higher than that allowed (%u bits). Ignoring it.",
                    frame.r.bpp, MAX_OUTPUT_BPP));
-            goto done;
+            return false;
         }
         else if (frame.r.w < minres.w ||
                  frame.r.h < minres.h)
         {
             NBENE(("Was asked to scale a frame with an input size (%u x %u) smaller than the minimum allowed (%u x %u). Ignoring it.",
                    frame.r.w, frame.r.h, minres.w, minres.h));
-            goto done;
+            return false;
         }
         else if (frame.r.w > maxres.w ||
                  frame.r.h > maxres.h)
         {
             NBENE(("Was asked to scale a frame with an input size (%u x %u) larger than the maximum allowed (%u x %u). Ignoring it.",
                    frame.r.w, frame.r.h, maxres.w, maxres.h));
-            goto done;
-        }
-        else if (OUTPUT_BUFFER.is_null())
-        {
-            goto done;
+            return false;
         }
     }
 
-    // If needed, convert the color data to BGRA, which is what the scaling filters
-    // expect to receive. Note that this will only happen if the frame's bit depth
-    // doesn't match with the expected value - a frame with the same bit depth but
-    // different arrangement of the color channels would not get converted to the
-    // proper order.
-    if (frame.r.bpp != OUTPUT_BIT_DEPTH)
-    {
-        s_convert_frame_to_bgra(frame);
-        frameRes.bpp = 32;
+    return true;
+}
 
-        pixelData = COLORCONV_BUFFER.ptr();
-    }
+// Returns the given filter's position in FILTER_COST_ORDER, or -1 if it's not
+// listed.
+static int s_filter_cost_rank(const scaling_filter_s *const filter)
+{
+    const auto entry = std::find(FILTER_COST_ORDER.begin(), FILTER_COST_ORDER.end(), filter->name);
 
-    // Perform anti-tearing on the (color-converted) frame. If the user has turned
-    // anti-tearing off, this will just return without doing anything.
-    pixelData = kat_anti_tear(pixelData, frameRes);
-    if (pixelData == nullptr)
+    return ((entry == FILTER_COST_ORDER.end())? -1 : int(entry - FILTER_COST_ORDER.begin()));
+}
+
+// Returns the filter to be used in place of the given one, given the current cap
+// on filters' cost.
+static const scaling_filter_s* s_cost_capped(const scaling_filter_s *const filter)
+{
+    if (!filter || !FILTER_COST_CAP)
     {
-        goto done;
+        return filter;
     }
 
-    // Apply filtering, and scale the frame.
+    const int rank = s_filter_cost_rank(filter);
+
+    return (((rank >= 0) && (rank < s_filter_cost_rank(FILTER_COST_CAP)))? FILTER_COST_CAP : filter);
+}
+
+#if USE_OPENCV
+// Returns the OpenCV interpolation that the given scaling filter uses.
+static cv::InterpolationFlags s_cv_interpolation(const scaling_filter_s *const filter)
+{
+    if (filter->name == "Nearest") return cv::INTER_NEAREST;
+    if (filter->name == "Linear")  return cv::INTER_LINEAR;
+    if (filter->name == "Area")    return cv::INTER_AREA;
+    if (filter->name == "Cubic")   return cv::INTER_CUBIC;
+    if (filter->name == "Lanczos") return cv::INTER_LANCZOS4;
+
+    k_assert(0, "Unknown scaling filter.");
+
+    return cv::INTER_NEAREST;
+}
+#endif
+
+// Scales the given BGRA pixels into the given output frame, at the frame's
+// resolution. Expects SCALER_MUTEX to be held.
+static void s_scale_into(u8 *const pixelData,
+                         const resolution_s &frameRes,
+                         scaled_frame_s *const frame,
+                         const bool isUpscalingDeferred)
+{
+    // If no need to scale, just copy the data over.
+    if ((!FORCE_ASPECT || ASPECT_MODE == aspect_mode_e::native || isUpscalingDeferred) &&
+        frameRes.w == frame->resolution.w &&
+        frameRes.h == frame->resolution.h)
+    {
+        memcpy(frame->pixels.ptr(), pixelData, frame->pixels.up_to(frameRes.w * frameRes.h * (frameRes.bpp / 8)));
+    }
+    else
     {
-        kf_apply_filter_chain(pixelData, frameRes);
+        const scaling_filter_s *scaler;
+
+        if ((frameRes.w < frame->resolution.w) ||
+            (frameRes.h < frame->resolution.h))
+        {
+            scaler = UPSCALE_FILTER;
+        }
+        else
+        {
+            scaler = DOWNSCALE_FILTER;
+        }
+
+        scaler = s_cost_capped(scaler);
 
-        // If no need to scale, just copy the data over.
-        if ((!FORCE_ASPECT || ASPECT_MODE == aspect_mode_e::native) &&
-            frameRes.w == outputRes.w &&
-            frameRes.h == outputRes.h)
+        if (!scaler)
         {
-            memcpy(OUTPUT_BUFFER.ptr(), pixelData, OUTPUT_BUFFER.up_to(frameRes.w * frameRes.h * (frameRes.bpp / 8)));
+            NBENE(("Upscale or downscale filter is null. Refusing to scale."));
+
+            frame->resolution = frameRes;
+            memcpy(frame->pixels.ptr(), pixelData, frame->pixels.up_to(frameRes.w * frameRes.h * (frameRes.bpp / 8)));
         }
         else
         {
-            const scaling_filter_s *scaler;
+            scaler->scale(pixelData, frame->pixels.ptr(), frameRes, frame->resolution);
+        }
+    }
+
+    return;
+}
+
+// Scales the given BGRA pixels into the given output frame as BGR, converting
+// their color before the scaling; so that the conversion runs over the fewer
+// pixels, and the scaling writes out the pixels in the format they're wanted in.
+// Returns false, leaving the frame untouched, if the scaling doesn't add pixels,
+// or needs steps that only work on BGRA (post-scaling filters, aspect ratio
+// padding). Expects SCALER_MUTEX to be held.
+static bool s_scale_into_bgr(u8 *const pixelData,
+                             const resolution_s &frameRes,
+                             scaled_frame_s *const frame,
+                             const filter_chain_split_s &filterSplit)
+{
+    #if USE_OPENCV
+        const resolution_s &targetRes = frame->resolution;
+
+        if (((u64(targetRes.w) * targetRes.h) <= (u64(frameRes.w) * frameRes.h)) ||
+            filterSplit.has_post_scaling_filters())
+        {
+            return false;
+        }
+
+        if (FORCE_ASPECT)
+        {
+            const resolution_s paddedRes = ks_padded_resolution(frameRes, targetRes);
 
-            if ((frameRes.w < outputRes.w) ||
-                (frameRes.h < outputRes.h))
+            if ((paddedRes.w != targetRes.w) ||
+                (paddedRes.h != targetRes.h))
             {
-                scaler = UPSCALE_FILTER;
+                return false;
             }
-            else
+        }
+
+        const scaling_filter_s *const scaler = s_cost_capped(UPSCALE_FILTER);
+
+        if (!scaler)
+        {
+            return false;
+        }
+
+        cv::Mat src = cv::Mat(frameRes.h, frameRes.w, CV_8UC4, pixelData);
+        cv::Mat bgr = cv::Mat(frameRes.h, frameRes.w, CV_8UC3, TMP_BUFFER.ptr());
+        cv::Mat output = cv::Mat(targetRes.h, targetRes.w, CV_8UC3, frame->pixels.ptr());
+
+        cv::cvtColor(src, bgr, CV_BGRA2BGR);
+        cv::resize(bgr, output, output.size(), 0, 0, s_cv_interpolation(scaler));
+
+        return true;
+    #else
+        (void)pixelData;
+        (void)frameRes;
+        (void)frame;
+        (void)filterSplit;
+
+        return false;
+    #endif
+}
+
+// Scales the given BGRA pixels also to the resolution of each of the scaler's
+// extra outputs, attaching the results to the given output frame. Expects
+// SCALER_MUTEX to be held.
+static void s_scale_extra_outputs(scaled_frame_s *const frame,
+                                  u8 *const pixelData,
+                                  const resolution_s &frameRes,
+                                  const filter_chain_split_s &filterSplit)
+{
+    for (int i = 0; i < static_cast<int>(scaler_output_e::num_enumerators); i++)
+    {
+        const resolution_s &extraRes = EXTRA_OUTPUT_RESOLUTIONS[i];
+
+        frame->extraOutputs[i].reset();
+
+        // Consumers of an extra output whose resolution matches the main
+        // output's can use the main output as it is.
+        if (!extraRes.w ||
+            !extraRes.h ||
+            ((extraRes.w == frame->resolution.w) && (extraRes.h == frame->resolution.h)))
+        {
+            continue;
+        }
+
+        TELEMETRY_TIME_SCOPE("Extra output scaling");
+
+        const auto extraOutput = s_acquire_frame();
+        extraOutput->resolution = extraRes;
+
+        // Where the output is wanted in BGR but that can't be had cheaply, it's
+        // left in BGRA for the consumer to convert.
+        if ((extraRes.bpp != 24) ||
+            !s_scale_into_bgr(pixelData, frameRes, extraOutput.get(), filterSplit))
+        {
+            extraOutput->resolution.bpp = OUTPUT_BIT_DEPTH;
+
+            s_scale_into(pixelData, frameRes, extraOutput.get(), false);
+
+            kf_apply_post_scaling_filters(extraOutput->pixels.ptr(), extraOutput->resolution, filterSplit);
+        }
+
+        frame->extraOutputs[i] = extraOutput;
+    }
+
+    return;
+}
+
+std::shared_ptr<scaled_frame_s> ks_scale_pixels(u8 *const pixelData,
+                                                const resolution_s &frameRes,
+                                                const resolution_s &outputRes,
+                                                const bool isUpscalingDeferred,
+                                                const filter_chain_split_s &filterSplit)
+{
+    TELEMETRY_TIME_SCOPE("Scaling");
+
+    std::lock_guard<std::mutex> lock(SCALER_MUTEX);
+
+    const auto frame = s_acquire_frame();
+
+    // If the renderer is to do the upscaling, pass the frame through at its
+    // native resolution. The renderer will also take care of any padding
+    // for aspect ratio.
+    frame->resolution = (isUpscalingDeferred? resolution_s{frameRes.w, frameRes.h, OUTPUT_BIT_DEPTH} : outputRes);
+
+    s_scale_into(pixelData, frameRes, frame.get(), isUpscalingDeferred);
+
+    s_scale_extra_outputs(frame.get(), pixelData, frameRes, filterSplit);
+
+    return frame;
+}
+
+// Color-converts, filters, and scales the given captured frame one horizontal
+// band at a time, so that each band's pixels are still in cache as they move
+// from one step to the next. Returns the scaled frame, with any post-scaling
+// filters applied; or null if the frame
+// can't be processed in bands given the current settings, in which case it'll
+// need to be processed whole.
+//
+// Each band is extended above and below by the rows that the filters and the
+// scaler read beyond it (its halo), and is aligned to whole steps of the scaling
+// ratio, so that its scaled rows come out identical to those of a whole frame.
+static std::shared_ptr<scaled_frame_s> s_scale_frame_in_bands(const captured_frame_s &frame,
+                                                              const resolution_s &outputRes)
+{
+    #if USE_OPENCV
+        const resolution_s frameRes = {frame.r.w, frame.r.h, OUTPUT_BIT_DEPTH};
+
+        // Anti-tearing compares whole frames against each other.
+        if (!BAND_PROCESSING_ENABLED ||
+            kat_is_anti_tear_enabled() ||
+            ks_is_upscaling_deferrable(frameRes, outputRes))
+        {
+            return nullptr;
+        }
+
+        // The filters are split around the scaling once for the whole frame, so
+        // that each band gets the same ones.
+        const filter_chain_split_s filterSplit = kf_filter_chain_split(frameRes, outputRes);
+        const int filterHalo = kf_filter_chain_band_halo(filterSplit);
+
+        if (filterHalo < 0)
+        {
+            return nullptr;
+        }
+
+        TELEMETRY_TIME_SCOPE("Band pipeline");
+
+        std::lock_guard<std::mutex> lock(SCALER_MUTEX);
+
+        if (FORCE_ASPECT)
+        {
+            const resolution_s paddedRes = ks_padded_resolution(frameRes, outputRes);
+
+            if ((paddedRes.w != outputRes.w) ||
+                (paddedRes.h != outputRes.h))
             {
-                scaler = DOWNSCALE_FILTER;
+                return nullptr;
             }
+        }
 
-            if (!scaler)
+        // Extra outputs are scaled from the whole frame.
+        for (const auto &extraRes: EXTRA_OUTPUT_RESOLUTIONS)
+        {
+            if (extraRes.w && extraRes.h)
             {
-                NBENE(("Upscale or downscale filter is null. Refusing to scale."));
+                return nullptr;
+            }
+        }
+
+        const scaling_filter_s *const scaler = s_cost_capped(((frameRes.w < outputRes.w) || (frameRes.h < outputRes.h))? UPSCALE_FILTER : DOWNSCALE_FILTER);
+
+        if (!scaler)
+        {
+            return nullptr;
+        }
+
+        const unsigned h = frameRes.h;
+        const unsigned oh = outputRes.h;
+
+        // Source row y maps to output row (y * oh / h), which is a whole row when
+        // y is a multiple of srcStep.
+        const unsigned srcStep = [h, oh]
+        {
+            unsigned a = h, b = oh;
+            while (b) { const unsigned t = (a % b); a = b; b = t; }
+            return (h / a);
+        }();
+        const auto scaled_row = [h, oh](const unsigned y){ return unsigned((u64(y) * oh) / h); };
+
+        // The scaler's halo also covers the rows that a source pixel is averaged
+        // from when downscaling.
+        const unsigned scalerHalo = ((((SCALER_BAND_HALO + ((h + oh - 1) / oh)) + srcStep - 1) / srcStep) * srcStep);
+        const unsigned srcRowSize = (frameRes.w * 4);
+        const unsigned dstRowSize = (outputRes.w * 4);
+        const unsigned budgetRows = (BAND_SIZE_BYTES / srcRowSize);
+        const unsigned haloRows = (2 * (scalerHalo + filterHalo));
+        const unsigned bandRows = std::max(srcStep, ((((budgetRows > haloRows)? (budgetRows - haloRows) : 0) / srcStep) * srcStep));
+
+        // Too few bands for the halos' overhead to pay off.
+        if ((bandRows * 2) > h)
+        {
+            return nullptr;
+        }
 
-                outputRes = frameRes;
-                memcpy(OUTPUT_BUFFER.ptr(), pixelData, OUTPUT_BUFFER.up_to(frameRes.w * frameRes.h * (frameRes.bpp / 8)));
+        const auto output = s_acquire_frame();
+        output->resolution = outputRes;
+
+        for (unsigned y0 = 0; y0 < h; y0 += bandRows)
+        {
+            const unsigned y1 = std::min(h, (y0 + bandRows));
+
+            // The rows to be scaled, and the rows to be filtered for them.
+            const unsigned sy0 = ((y0 > scalerHalo)? (y0 - scalerHalo) : 0);
+            const unsigned sy1 = std::min(h, (y1 + scalerHalo));
+            const unsigned cy0 = ((sy0 > unsigned(filterHalo))? (sy0 - filterHalo) : 0);
+            const unsigned cy1 = std::min(h, (sy1 + filterHalo));
+            const resolution_s bandRes = {frameRes.w, (cy1 - cy0), OUTPUT_BIT_DEPTH};
+
+            // Color conversion.
+            if (frame.r.bpp == OUTPUT_BIT_DEPTH)
+            {
+                memcpy(COLORCONV_BUFFER.ptr(), (frame.pixels.ptr() + (cy0 * srcRowSize)), COLORCONV_BUFFER.up_to(bandRes.h * srcRowSize));
             }
             else
             {
-                scaler->scale(pixelData, frameRes, outputRes);
+                const unsigned bandFrameRowSize = (frame.r.w * (frame.r.bpp / 8));
+
+                captured_frame_s bandFrame;
+                bandFrame.r = {frame.r.w, bandRes.h, frame.r.bpp};
+                bandFrame.pixelFormat = frame.pixelFormat;
+                bandFrame.pixels.point_to((frame.pixels.ptr() + (cy0 * bandFrameRowSize)), (bandRes.h * bandFrameRowSize));
+
+                ks_convert_frame_to_bgra(bandFrame, COLORCONV_BUFFER.ptr());
+            }
+
+            kf_apply_filter_chain_to_band(COLORCONV_BUFFER.ptr(), bandRes, filterSplit);
+
+            // Scaling.
+            {
+                const unsigned dy0 = scaled_row(sy0);
+                const unsigned dy1 = scaled_row(sy1);
+
+                cv::Mat src = cv::Mat((sy1 - sy0), frameRes.w, CV_8UC4, (COLORCONV_BUFFER.ptr() + ((sy0 - cy0) * srcRowSize)));
+                cv::Mat dst = cv::Mat((dy1 - dy0), outputRes.w, CV_8UC4, TMP_BUFFER.ptr());
+
+                cv::resize(src, dst, dst.size(), 0, 0, s_cv_interpolation(scaler));
+
+                // Keep only the rows that came from the band itself; those from
+                // its halo were scaled without all of their neighbors.
+                memcpy((output->pixels.ptr() + (scaled_row(y0) * dstRowSize)),
+                       (TMP_BUFFER.ptr() + ((scaled_row(y0) - dy0) * dstRowSize)),
+                       ((scaled_row(y1) - scaled_row(y0)) * dstRowSize));
             }
         }
+
+        kf_apply_post_scaling_filters(output->pixels.ptr(), output->resolution, filterSplit);
+
+        return output;
+    #else
+        (void)frame;
+        (void)outputRes;
+
+        return nullptr;
+    #endif
+}
+
+// Takes the given image and scales it according to the scaler's current internal
+// resolution settings, making the scaled image the scaler's latest output.
+//
+void ks_scale_frame(const captured_frame_s &frame)
+{
+    u8 *pixelData = frame.pixels.ptr();
+    resolution_s frameRes = frame.r; /// Temp hack. May want to modify the .bpp value.
+    const resolution_s outputRes = ks_output_resolution();
+
+    if (!ks_is_frame_scalable(frame))
+    {
+        return;
     }
 
-    if ((LATEST_OUTPUT_SIZE.w != outputRes.w) ||
-        (LATEST_OUTPUT_SIZE.h != outputRes.h))
+    if (const auto scaledFrame = s_scale_frame_in_bands(frame, outputRes))
     {
-        ke_events().scaler.newFrameResolution->fire();
+        ks_present_frame(scaledFrame);
 
-        LATEST_OUTPUT_SIZE = outputRes;
+        return;
     }
 
-    done:
+    // If needed, convert the color data to BGRA, which is what the scaling filters
+    // expect to receive. Note that this will only happen if the frame's bit depth
+    // doesn't match with the expected value - a frame with the same bit depth but
+    // different arrangement of the color channels would not get converted to the
+    // proper order.
+    if (frame.r.bpp != OUTPUT_BIT_DEPTH)
+    {
+        TELEMETRY_TIME_SCOPE("Color conversion");
+
+        ks_convert_frame_to_bgra(frame, COLORCONV_BUFFER.ptr());
+        frameRes.bpp = 32;
+
+        pixelData = COLORCONV_BUFFER.ptr();
+    }
+
+    // Perform anti-tearing on the (color-converted) frame. If the user has turned
+    // anti-tearing off, this will just return without doing anything.
+    {
+        TELEMETRY_TIME_SCOPE("Anti-tear");
+
+        pixelData = kat_anti_tear(pixelData, frameRes);
+    }
+    if (pixelData == nullptr)
+    {
+        return;
+    }
+
+    // Apply filtering, and scale the frame. Some of the filters may be left to
+    // be applied after the scaling, if that's cheaper.
+    const filter_chain_split_s filterSplit = kf_apply_filter_chain(pixelData, frameRes, outputRes);
+
+    const auto scaledFrame = ks_scale_pixels(pixelData, frameRes, outputRes, ks_is_upscaling_deferrable(frameRes, outputRes), filterSplit);
+
+    kf_apply_post_scaling_filters(scaledFrame->pixels.ptr(), scaledFrame->resolution, filterSplit);
+
+    ks_present_frame(scaledFrame);
+
     return;
 }
 
+bool ks_is_passthrough_frame(const captured_frame_s &frame)
+{
+    const resolution_s frameRes = frame.r;
+    const resolution_s outputRes = ks_output_resolution();
+    const bool isUpscalingDeferred = ks_is_upscaling_deferrable(frameRes, outputRes);
+    const resolution_s targetRes = (isUpscalingDeferred? frameRes : outputRes);
+
+    // Recording and shared memory output hold on to frames past their display -
+    // the latter on a thread of its own, from which the frame couldn't be given
+    // back to the capture device safely - and a passed-through frame keeps the
+    // capture device from delivering new ones for as long as it's held. Other
+    // than 8-bit RGB, the pixels would need their color converted.
+    const bool isPassthrough = (PASSTHROUGH_ENABLED &&
+                                (frame.r.bpp == OUTPUT_BIT_DEPTH) &&
+                                (frame.pixelFormat == capture_pixel_format_e::rgb_888) &&
+                                (frameRes.w == targetRes.w) &&
+                                (frameRes.h == targetRes.h) &&
+                                (!FORCE_ASPECT || (ASPECT_MODE == aspect_mode_e::native) || isUpscalingDeferred) &&
+                                !kat_is_anti_tear_enabled() &&
+                                !kf_is_filter_chain_active(frameRes, outputRes) &&
+                                !krecord_is_recording() &&
+                                !krecord_is_replay_buffer_active() &&
+                                !kshm_is_enabled() &&
+                                ks_is_frame_scalable(frame));
+
+    if (PASSTHROUGH_ENABLED &&
+        (isPassthrough != IS_PASSING_THROUGH))
+    {
+        INFO(("%s passing captured frames through as they are.", (isPassthrough? "Started" : "Stopped")));
+    }
+
+    IS_PASSING_THROUGH = isPassthrough;
+
+    return isPassthrough;
+}
+
+void ks_pass_frame_through(const captured_frame_s &frame)
+{
+    TELEMETRY_TIME_SCOPE("Passthrough");
+
+    scaled_frame_s *const passthroughFrame = new scaled_frame_s;
+    passthroughFrame->pixels.point_to(frame.pixels.ptr(), (frame.r.w * frame.r.h * (frame.r.bpp / 8)));
+    passthroughFrame->resolution = {frame.r.w, frame.r.h, OUTPUT_BIT_DEPTH};
+
+    // The frame's pixels are the capture device's, so it's only once the frame
+    // is no longer referenced that the device can be given them back.
+    ks_present_frame(std::shared_ptr<scaled_frame_s>(passthroughFrame, [](scaled_frame_s *const frame)
+    {
+        kc_capture_api().mark_frame_buffer_as_processed();
+
+        delete frame;
+    }));
+
+    return;
+}
+
+void ks_detach_passthrough_frame(void)
+{
+    if (!LATEST_FRAME ||
+        !IS_PASSING_THROUGH)
+    {
+        return;
+    }
+
+    const auto frame = s_acquire_frame();
+    frame->resolution = LATEST_FRAME->resolution;
+    frame->frameNumber = LATEST_FRAME->frameNumber;
+    frame->timestamp = LATEST_FRAME->timestamp;
+
+    memcpy(frame->pixels.ptr(), LATEST_FRAME->pixels.ptr(), frame->pixels.up_to(frame->resolution.w * frame->resolution.h * (frame->resolution.bpp / 8)));
+
+    LATEST_FRAME = frame;
+
+    return;
+}
+
+void ks_set_passthrough_enabled(const bool state)
+{
+    PASSTHROUGH_ENABLED = state;
+    IS_PASSING_THROUGH = false;
+
+    INFO(("Passthrough of unprocessed frames is %s.", (PASSTHROUGH_ENABLED? "enabled" : "disabled")));
+
+    return;
+}
+
+bool ks_is_passthrough_enabled(void)
+{
+    return PASSTHROUGH_ENABLED;
+}
+
 void ks_set_output_resolution_override_enabled(const bool state)
 {
     FORCE_BASE_RESOLUTION = state;
@@ -629,7 +1222,11 @@ void ks_set_output_resolution_override_enabled(const bool state)
 
 void ks_set_forced_aspect_enabled(const bool state)
 {
-    FORCE_ASPECT = state;
+    {
+        std::lock_guard<std::mutex> lock(SCALER_MUTEX);
+        FORCE_ASPECT = state;
+    }
+
     kd_update_output_window_size();
 
     return;
@@ -688,17 +1285,89 @@ void ks_indicate_invalid_signal(void)
 
 void ks_clear_scaler_output_buffer(void)
 {
-    k_assert(!OUTPUT_BUFFER.is_null(),
-             "Can't access the output buffer: it was unexpectedly null.");
+    const auto frame = s_acquire_frame();
+
+    frame->resolution = ks_scaler_output_resolution();
+    memset(frame->pixels.ptr(), 0, frame->pixels.up_to(frame->resolution.w * frame->resolution.h * (OUTPUT_BIT_DEPTH / 8)));
 
-    memset(OUTPUT_BUFFER.ptr(), 0, OUTPUT_BUFFER.up_to(MAX_FRAME_SIZE));
+    ks_present_frame(frame);
 
     return;
 }
 
 const u8* ks_scaler_output_as_raw_ptr(void)
 {
-    return OUTPUT_BUFFER.ptr();
+    return (LATEST_FRAME? LATEST_FRAME->pixels.ptr() : nullptr);
+}
+
+std::shared_ptr<const scaled_frame_s> ks_scaler_output_frame(void)
+{
+    return LATEST_FRAME;
+}
+
+// Returns the resolution of the frame currently in the scaler's output buffer.
+// This will differ from ks_output_resolution() when the upscaling of the frame
+// has been deferred to the renderer.
+//
+resolution_s ks_scaler_output_resolution(void)
+{
+    if (!LATEST_OUTPUT_SIZE.w || !LATEST_OUTPUT_SIZE.h)
+    {
+        return ks_output_resolution();
+    }
+
+    return LATEST_OUTPUT_SIZE;
+}
+
+void ks_set_extra_output_resolution(const scaler_output_e output, const resolution_s &r)
+{
+    k_assert((output != scaler_output_e::num_enumerators), "Invalid scaler output.");
+
+    k_assert(((r.w <= MAX_OUTPUT_WIDTH) && (r.h <= MAX_OUTPUT_HEIGHT)),
+             "The scaler's extra output resolution exceeds the maximum output resolution.");
+
+    std::lock_guard<std::mutex> lock(SCALER_MUTEX);
+
+    EXTRA_OUTPUT_RESOLUTIONS[static_cast<int>(output)] = {r.w, r.h, ((r.bpp == 24)? 24 : OUTPUT_BIT_DEPTH)};
+
+    return;
+}
+
+resolution_s ks_extra_output_resolution(const scaler_output_e output)
+{
+    k_assert((output != scaler_output_e::num_enumerators), "Invalid scaler output.");
+
+    std::lock_guard<std::mutex> lock(SCALER_MUTEX);
+
+    return EXTRA_OUTPUT_RESOLUTIONS[static_cast<int>(output)];
+}
+
+void ks_set_deferred_upscaling_enabled(const bool state)
+{
+    DEFER_UPSCALING = state;
+
+    INFO(("Upscaling will be done by the %s.", (DEFER_UPSCALING? "renderer" : "scaler")));
+
+    return;
+}
+
+bool ks_is_deferred_upscaling_enabled(void)
+{
+    return DEFER_UPSCALING;
+}
+
+void ks_set_band_processing_enabled(const bool state)
+{
+    BAND_PROCESSING_ENABLED = state;
+
+    INFO(("Band processing of frames is %s.", (BAND_PROCESSING_ENABLED? "enabled" : "disabled")));
+
+    return;
+}
+
+bool ks_is_band_processing_enabled(void)
+{
+    return BAND_PROCESSING_ENABLED;
 }
 
 // Returns a list of GUI-displayable names of the scaling filters that're
@@ -761,6 +1430,8 @@ const std::string& ks_downscaling_filter_name(void)
 
 void ks_set_upscaling_filter(const std::string &name)
 {
+    std::lock_guard<std::mutex> lock(SCALER_MUTEX);
+
     UPSCALE_FILTER = ks_scaler_for_name_string(name);
 
     DEBUG(("Assigned '%s' as the upscaling filter.", UPSCALE_FILTER->name.c_str()));
@@ -768,8 +1439,48 @@ void ks_set_upscaling_filter(const std::string &name)
     return;
 }
 
+void ks_set_scaling_filter_cost_cap(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(SCALER_MUTEX);
+
+    FILTER_COST_CAP = nullptr;
+
+    for (const auto &filter: SCALING_FILTERS)
+    {
+        if (filter.name == name)
+        {
+            FILTER_COST_CAP = &filter;
+            break;
+        }
+    }
+
+    return;
+}
+
+std::vector<std::string> ks_scaling_filter_cost_order(void)
+{
+    std::vector<std::string> names;
+
+    for (const auto &name: FILTER_COST_ORDER)
+    {
+        const auto filter = std::find_if(SCALING_FILTERS.begin(), SCALING_FILTERS.end(), [&name](const scaling_filter_s &f)
+        {
+            return (f.name == name);
+        });
+
+        if (filter != SCALING_FILTERS.end())
+        {
+            names.push_back(name);
+        }
+    }
+
+    return names;
+}
+
 void ks_set_downscaling_filter(const std::string &name)
 {
+    std::lock_guard<std::mutex> lock(SCALER_MUTEX);
+
     DOWNSCALE_FILTER = ks_scaler_for_name_string(name);
 
     DEBUG(("Assigned '%s' as the downscaling filter.", DOWNSCALE_FILTER->name.c_str()));
@@ -7,12 +7,17 @@
 #ifndef SCALER_H
 #define SCALER_H
 
+#include <memory>
+#include <chrono>
+#include "common/memory/memory_interface.h"
 #include "common/globals.h"
 
 struct captured_frame_s;
+struct filter_chain_split_s;
 
-// The parameters accepted by scaling functions.
-#define SCALER_FUNC_PARAMS u8 *const pixelData, const resolution_s &sourceRes, const resolution_s &targetRes
+// The parameters accepted by scaling functions: the pixels to be scaled, and the
+// buffer into which to place the scaled pixels.
+#define SCALER_FUNC_PARAMS u8 *const pixelData, u8 *const outputData, const resolution_s &sourceRes, const resolution_s &targetRes
 
 // IDs for the different up/downscaling filters the scaler can use.
 enum scaling_filter_id_e
@@ -39,6 +44,39 @@ struct scaling_filter_s
     void (*scale)(SCALER_FUNC_PARAMS);  // The function that executes this scaler with the given pixels.
 };
 
+// The outputs that the scaler can produce from each frame in addition to its main
+// output (the one that's displayed), each at a resolution of its own; cf.
+// ks_set_extra_output_resolution().
+enum class scaler_output_e
+{
+    recording,
+
+    num_enumerators
+};
+
+// A frame output by the scaler. Frames are pooled and reference-counted: holding
+// on to one keeps its pixels intact while the scaler moves on to the next, and
+// once no-one references it any longer, it returns into the pool for reuse.
+struct scaled_frame_s
+{
+    // The frame's BGRA pixels; or BGR, if the resolution's bpp is 24, as an
+    // extra output may be (cf. ks_set_extra_output_resolution()).
+    heap_bytes_s<u8> pixels;
+
+    resolution_s resolution;
+
+    // The same frame scaled to the resolutions of the scaler's extra outputs,
+    // indexed by scaler_output_e; null where an extra output is disabled, or
+    // its resolution is the same as this frame's. To be treated as read-only.
+    std::shared_ptr<scaled_frame_s> extraOutputs[static_cast<int>(scaler_output_e::num_enumerators)];
+
+    // Frames are numbered sequentially in the order the scaler outputs them.
+    u64 frameNumber;
+
+    // When the scaler finished with the frame.
+    std::chrono::steady_clock::time_point timestamp;
+};
+
 resolution_s ks_output_base_resolution(void);
 
 resolution_s ks_output_resolution(void);
@@ -51,8 +89,40 @@ void ks_initialize_scaler(void);
 
 void ks_release_scaler(void);
 
+// Scales the given captured frame - converting its color, anti-tearing, and
+// filtering it along the way - and makes the result the scaler's latest output;
+// i.e. runs all the steps below in sequence.
 void ks_scale_frame(const captured_frame_s &frame);
 
+// The steps of scaling a captured frame, for when they're run as separate stages
+// of the frame pipeline, each on a thread of its own. Besides ks_scale_pixels(),
+// they're to be called from the main thread.
+
+// Returns true if the given captured frame is one the scaler can process.
+bool ks_is_frame_scalable(const captured_frame_s &frame);
+
+// Converts the given frame's pixels into BGRA, placing the result into the given
+// buffer.
+void ks_convert_frame_to_bgra(const captured_frame_s &frame, u8 *const dst);
+
+// Returns true if the upscaling of a frame of the given resolution to the given
+// output resolution is to be left for the renderer to do.
+bool ks_is_upscaling_deferrable(const resolution_s &frameRes, const resolution_s &outputRes);
+
+// Returns a new output frame containing the given BGRA pixels scaled to the given
+// output resolution (or left at their own, if upscaling is deferred); along with
+// the pixels scaled to the resolutions of any extra outputs, which have also had
+// applied to them the post-scaling filters of the given filter split, as returned
+// by kf_apply_filter_chain() for the pixels. Can be called from any thread.
+std::shared_ptr<scaled_frame_s> ks_scale_pixels(u8 *const pixelData,
+                                                const resolution_s &frameRes,
+                                                const resolution_s &outputRes,
+                                                const bool isUpscalingDeferred,
+                                                const filter_chain_split_s &filterSplit);
+
+// Makes the given frame the scaler's latest output.
+void ks_present_frame(const std::shared_ptr<scaled_frame_s> &frame);
+
 resolution_s ks_resolution_to_aspect(const resolution_s &r);
 
 void ks_set_aspect_mode(const aspect_mode_e mode);
@@ -73,8 +143,14 @@ void ks_indicate_invalid_signal(void);
 
 void ks_clear_scaler_output_buffer(void);
 
+// Returns the pixels of the scaler's latest output frame. The pointer remains
+// valid only until the scaler outputs its next frame; to hold on to a frame for
+// longer, use ks_scaler_output_frame().
 const u8* ks_scaler_output_as_raw_ptr(void);
 
+// Returns the scaler's latest output frame, or nullptr if there's none yet.
+std::shared_ptr<const scaled_frame_s> ks_scaler_output_frame(void);
+
 const std::string &ks_upscaling_filter_name(void);
 
 const std::string& ks_downscaling_filter_name(void);
@@ -89,8 +165,65 @@ void ks_set_downscaling_filter(const std::string &name);
 
 void ks_set_upscaling_filter(const std::string &name);
 
+// Has the scaler use the scaling filter of the given name in place of any costlier
+// upscaling or downscaling filter, without changing which filters are set. An
+// empty name lifts the cap.
+void ks_set_scaling_filter_cost_cap(const std::string &name);
+
+// Returns the names of the scaling filters that can be capped by cost, from the
+// most to the least costly.
+std::vector<std::string> ks_scaling_filter_cost_order(void);
+
 const scaling_filter_s* ks_scaler_for_name_string(const std::string &name);
 
 resolution_s ks_scaler_output_resolution(void);
 
+resolution_s ks_padded_resolution(const resolution_s &sourceRes, const resolution_s &targetRes);
+
+// Has the scaler also scale each frame to the given resolution, alongside its
+// main output, for the given consumer (e.g. recording video at a resolution other
+// than the displayed one); see scaled_frame_s::extraOutputs. The frame's color
+// conversion, anti-tearing, and filtering are done once and shared by all of
+// the outputs. A resolution of 0 x 0 disables the extra output.
+//
+// If the resolution's bpp is 24, the extra output is produced in BGR wherever
+// the conversion can be folded into the scaling at no extra cost (namely, when
+// upscaling); otherwise, in BGRA.
+void ks_set_extra_output_resolution(const scaler_output_e output, const resolution_s &r);
+
+resolution_s ks_extra_output_resolution(const scaler_output_e output);
+
+void ks_set_deferred_upscaling_enabled(const bool state);
+
+bool ks_is_deferred_upscaling_enabled(void);
+
+// Whether ks_scale_frame() processes frames in cache-sized horizontal bands, when
+// the current settings allow it; e.g. not while anti-tearing is enabled, or while
+// a filter that needs the whole frame is in use.
+void ks_set_band_processing_enabled(const bool state);
+
+bool ks_is_band_processing_enabled(void);
+
+// Whether captured frames that need no processing - no color conversion,
+// anti-tearing, filtering, or scaling - are handed to the display without
+// being copied into an output frame; cf. ks_pass_frame_through().
+void ks_set_passthrough_enabled(const bool state);
+
+bool ks_is_passthrough_enabled(void);
+
+// Returns true if passthrough is enabled and the given captured frame would come
+// out of the scaler unchanged.
+bool ks_is_passthrough_frame(const captured_frame_s &frame);
+
+// Makes the given captured frame, as it is, the scaler's latest output. The
+// output frame refers to the captured frame's pixels, and marks the capture
+// device's frame buffer as processed once it's no longer referenced; so it
+// should be let go of soon, e.g. by calling ks_detach_passthrough_frame() once
+// the frame has been displayed.
+void ks_pass_frame_through(const captured_frame_s &frame);
+
+// If the scaler's latest output frame is a passed-through captured frame, swaps
+// it for a copy, so that the captured frame can be released.
+void ks_detach_passthrough_frame(void);
+
 #endif
@@ -14,8 +14,11 @@ linux {
     INCLUDEPATH += $$(HOME)/sdk/
 
     contains(DEFINES, USE_OPENCV) {
-        LIBS += -lopencv_imgproc -lopencv_videoio -lopencv_highgui -lopencv_core -lopencv_photo
+        LIBS += -lopencv_imgproc -lopencv_videoio -lopencv_imgcodecs -lopencv_highgui -lopencv_core -lopencv_photo
     }
+
+    # For shm_open(), used by the shared memory frame output.
+    LIBS += -lrt
 }
 
 win32 {
@@ -59,8 +62,11 @@ SOURCES += \
     src/display/qt/dialogs/alias_dialog.cpp \
     src/display/qt/dialogs/anti_tear_dialog.cpp \
     src/scaler/scaler.cpp \
+    src/scaler/pipeline.cpp \
+    src/scaler/quality_governor.cpp \
     src/main.cpp \
     src/common/log/log.cpp \
+    src/common/telemetry/telemetry.cpp \
     src/filter/filter.cpp \
     src/common/command_line/command_line.cpp \
     src/capture/capture.cpp \
@@ -68,6 +74,8 @@ SOURCES += \
     src/display/qt/persistent_settings.cpp \
     src/common/memory/memory.cpp \
     src/record/record.cpp \
+    src/record/shm_output.cpp \
+    src/record/batch.cpp \
     src/common/disk/disk.cpp \
     src/capture/alias.cpp \
     src/display/qt/subclasses/QOpenGLWidget_opengl_renderer.cpp \
@@ -86,6 +94,7 @@ SOURCES += \
     src/display/qt/subclasses/QTableWidget_property_table.cpp \
     src/display/qt/dialogs/signal_dialog.cpp \
     src/capture/capture_api_video4linux.cpp \
+    src/capture/capture_api_video_file.cpp \
     src/filter/filter_funcs.cpp \
     src/common/disk/file_writers/file_writer_filter_graph_version_b.cpp \
     src/common/disk/file_reader.cpp \
@@ -109,6 +118,16 @@ SOURCES += \
     src/common/disk/file_readers/file_reader_video_presets_version_a.cpp \
     src/common/propagate/app_events.cpp
 
+# Build with "qmake CONFIG+=headless" for a version of VCS that runs without a
+# GUI, controlled from the command line. The Qt display is swapped out for a
+# no-op implementation of the display interface.
+headless {
+    DEFINES += VCS_HEADLESS
+
+    SOURCES -= src/display/qt/d_main.cpp
+    SOURCES += src/display/headless/d_headless.cpp
+}
+
 HEADERS += \
     src/common/globals.h \
     src/capture/null_rgbeasy.h \
@@ -116,9 +135,13 @@ HEADERS += \
     src/display/qt/windows/output_window.h \
     src/display/qt/dialogs/resolution_dialog.h \
     src/scaler/scaler.h \
+    src/scaler/pipeline.h \
+    src/scaler/quality_governor.h \
+    src/common/spsc_queue.h \
     src/capture/capture.h \
     src/display/display.h \
     src/common/log/log.h \
+    src/common/telemetry/telemetry.h \
     src/display/qt/dialogs/overlay_dialog.h \
     src/display/qt/dialogs/alias_dialog.h \
     src/filter/anti_tear.h \
@@ -131,6 +154,8 @@ HEADERS += \
     src/common/memory/memory.h \
     src/common/memory/memory_interface.h \
     src/record/record.h \
+    src/record/shm_output.h \
+    src/record/batch.h \
     src/common/disk/disk.h \
     src/capture/alias.h \
     src/display/qt/subclasses/QOpenGLWidget_opengl_renderer.h \
@@ -150,6 +175,7 @@ HEADERS += \
     src/display/qt/subclasses/QTableWidget_property_table.h \
     src/display/qt/dialogs/signal_dialog.h \
     src/capture/capture_api_video4linux.h \
+    src/capture/capture_api_video_file.h \
     src/filter/filter_funcs.h \
     src/common/disk/file_writers/file_writer_filter_graph.h \
     src/common/disk/file_readers/file_reader_filter_graph.h \